@@ -119,8 +119,25 @@ void main()
     // Material base color (before shading)
     vec2 uv = vec2(fs_UV[0], fs_UV[1]);
 
+    // A greedy quad covers several blocks and its uv is the corner of
+    // the block's tile, so find where in its block this fragment lies
+    // and repeat the tile once per block
+    if ((int(fs_UV[3]) & 2) != 0) {
+        vec3 inBlock = fract(fs_Pos.xyz);
+        vec2 inTile;
+        if (abs(fs_Nor.x) > 0.5) {
+            inTile = vec2(fs_Nor.x > 0 ? 1 - inBlock.z : inBlock.z, inBlock.y);
+        } else if (abs(fs_Nor.y) > 0.5) {
+            inTile = vec2(inBlock.x, fs_Nor.y > 0 ? 1 - inBlock.z : inBlock.z);
+        } else {
+            inTile = vec2(fs_Nor.z > 0 ? inBlock.x : 1 - inBlock.x, inBlock.y);
+        }
+        // Stay off the tile's far edge, which belongs to the next tile over
+        uv = uv + clamp(inTile, 0.0, 0.999) * 0.0625f;
+    }
+
     // Animation
-    if (fs_UV[3] == 1) {
+    if ((int(fs_UV[3]) & 1) != 0) {
         vec2 offset = vec2((float(u_Time % 100) / 100.f) * 0.0625f, 0);
         uv = uv + offset;
     }
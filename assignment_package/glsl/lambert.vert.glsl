@@ -25,6 +25,11 @@ uniform vec3 u_CameraPos;   // Position of our camera in world space
 uniform vec4 u_Color;       // When drawing the cube instance, we'll set our uniform color to represent different block types.
 uniform int u_Time;
 
+uniform bool u_PackedVertex; // True when drawing a Chunk, whose vertices arrive packed in vs_Packed
+// World (x, z) of the Chunk owning each VertexArena::GRANULE vertices
+// of the VertexArena page being drawn
+uniform isamplerBuffer u_ChunkOrigins;
+
 in vec4 vs_Pos;             // The array of vertex positions passed to the shader
 
 in vec4 vs_Nor;             // The array of vertex normals passed to the shader
@@ -33,6 +38,8 @@ in vec4 vs_Col;             // The array of vertex colors passed to the shader.
 
 in vec4 vs_UV;
 
+in uvec2 vs_Packed;         // A packed terrain Vertex, see Vertex in chunkhelper.h
+
 
 
 out vec4 fs_Pos;
@@ -44,27 +51,50 @@ out float fs_distFromCam;
 
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
+// Indexed by Direction: XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
+const vec4 directionNormals[6] = vec4[6](vec4(1, 0, 0, 0), vec4(-1, 0, 0, 0),
+                                         vec4(0, 1, 0, 0), vec4(0, -1, 0, 0),
+                                         vec4(0, 0, 1, 0), vec4(0, 0, -1, 0));
+
 float random1( vec2 p ) {
     return fract(sin(dot(p,vec2(127.1,311.7)))*43758.5453);
 }
 
 void main()
 {
+    vec4 pos = vs_Pos;
+    vec4 nor = vs_Nor;
     fs_Pos = vs_Pos;
-    fs_Col = u_Color;                         // Pass the vertex colors to the fragment shader for interpolation
     fs_UV = vs_UV;
+    if (u_PackedVertex) {
+        uint a = vs_Packed.x;
+        uint b = vs_Packed.y;
+        vec3 local = vec3(a & 31u, (a >> 5) & 511u, (a >> 14) & 31u);
+        // gl_VertexID counts from the start of the page, base vertex included
+        ivec2 origin = texelFetch(u_ChunkOrigins, gl_VertexID / 64).xy;
+        pos = vec4(vec3(origin.x, 0, origin.y) + local, 1);
+        nor = directionNormals[(a >> 19) & 7u];
+        // The fragment shader only needs the position within a block,
+        // which the Chunk-local position keeps exactly however far out the Chunk is
+        fs_Pos = vec4(local, 1);
+        vec2 tile = vec2(b & 15u, (b >> 4) & 15u);
+        vec2 corner = vec2((b >> 8) & 1u, (b >> 9) & 1u);
+        fs_UV = vec4((tile + corner) * 0.0625, float(a >> 24) / 255.0, float((a >> 22) & 3u));
+    }
+    fs_Col = u_Color;                         // Pass the vertex colors to the fragment shader for interpolation
 
     mat3 invTranspose = mat3(u_ModelInvTr);
-    fs_Nor = vec4(invTranspose * vec3(vs_Nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
+    fs_Nor = vec4(invTranspose * vec3(nor), 0);          // Pass the vertex normals to the fragment shader for interpolation.
                                                             // Transform the geometry's normals by the inverse transpose of the
                                                             // model matrix. This is necessary to ensure the normals remain
                                                             // perpendicular to the surface after the surface is transformed by
                                                             // the model matrix.
 
 
-    vec4 modelposition = u_Model * vs_Pos;   // Temporarily store the transformed vertex positions for use below
+    vec4 modelposition = u_Model * pos;   // Temporarily store the transformed vertex positions for use below
 
-    if (fs_UV[3] == 1) {
+    // uv[3] holds flags: 1 = animated, 2 = texture tiled across a greedy quad
+    if ((int(fs_UV[3]) & 1) != 0) {
         modelposition.y = modelposition.y - abs(0.2*sin((u_Time + modelposition.x) / 50) + 0.6*sin((u_Time * 3 + modelposition.z * 6) / 300) + 0.1*cos((u_Time * 2 + modelposition.x * 2) / 300));
     }
     fs_distFromCam = length(u_CameraPos.xz - modelposition.xz);
@@ -48,6 +48,16 @@ address_sanitizer {
     QMAKE_LFLAGS += -fsanitize=address
 }
 
+# Thread Sanitizer (TSAN) checks for data races between the GUI thread and
+# the chunk workers. It cannot be combined with address_sanitizer. Run
+# `MiniMinecraft --benchmark stress` under it to stream, populate, mesh and
+# edit chunks all at once.
+thread_sanitizer {
+    message("Enabling Thread Sanitizer")
+    QMAKE_CXXFLAGS += -fsanitize=thread
+    QMAKE_LFLAGS += -fsanitize=thread
+}
+
 HEADERS +=
 
 SOURCES +=
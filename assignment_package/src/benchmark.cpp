@@ -0,0 +1,1146 @@
+#include "benchmark.h"
+#include "scene/chunk.h"
+#include "scene/generation.h"
+#include "scene/regionfile.h"
+#include "scene/terrain.h"
+#include "scene/frustum.h"
+#include "scene/sortworker.h"
+#include "scene/blocktypeworker.h"
+#include "scene/populationworker.h"
+#include "scene/vboworker.h"
+#include "scene/completionqueue.h"
+#include "scene/jobsystem.h"
+#include "scene/noise.h"
+#include "scene/zonenoisecache.h"
+#include "smartpointerhelp.h"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+
+namespace Benchmark {
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Terrain generation zones spread far enough apart to land in different biomes
+static const int benchZones[][2] = {
+    {0, 0}, {1024, 0}, {0, 1024}, {-2048, 512}, {512, -3072}, {-1536, -1536}
+};
+
+// Generates every Chunk of the benchmark zones. They are not linked
+// to each other and have no GPU data. Optionally passes out the
+// total time spent in Generation::GenerateChunk.
+static std::vector<uPtr<Chunk>> generateChunks(double *out_seconds = nullptr) {
+    std::vector<uPtr<Chunk>> chunks;
+    double seconds = 0;
+    for (const auto &zone : benchZones) {
+        for (int x = zone[0]; x < zone[0] + 64; x += 16) {
+            for (int z = zone[1]; z < zone[1] + 64; z += 16) {
+                uPtr<Chunk> c = mkU<Chunk>(nullptr, x, z);
+                Clock::time_point start = Clock::now();
+                Generation::GenerateChunk(c.get(), x, z);
+                seconds += secondsSince(start);
+                chunks.push_back(std::move(c));
+            }
+        }
+    }
+    if (out_seconds != nullptr) {
+        *out_seconds = seconds;
+    }
+    return chunks;
+}
+
+// The generated Chunks of a 64 x 64 zone and the ring of Chunks around it,
+// linked to each other so that every Chunk of the zone can be meshed
+struct ZoneGrid {
+    std::vector<uPtr<Chunk>> chunks;
+    std::vector<Chunk*> zone;
+};
+
+static ZoneGrid generateZoneGrid(int zoneX, int zoneZ) {
+    ZoneGrid grid;
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 6; j++) {
+            int x = zoneX + 16 * (i - 1);
+            int z = zoneZ + 16 * (j - 1);
+            uPtr<Chunk> c = mkU<Chunk>(nullptr, x, z);
+            Generation::GenerateChunk(c.get(), x, z);
+            if (i > 0) {
+                c->linkNeighbor(grid.chunks[6 * (i - 1) + j], XNEG);
+            }
+            if (j > 0) {
+                c->linkNeighbor(grid.chunks[6 * i + j - 1], ZNEG);
+            }
+            if (i > 0 && i < 5 && j > 0 && j < 5) {
+                grid.zone.push_back(c.get());
+            }
+            grid.chunks.push_back(std::move(c));
+        }
+    }
+    return grid;
+}
+
+// One zone of each biome
+static const struct { const char *name; int x, z; } biomeZones[] = {
+    {"grassland", -6144, 4096}, {"mountain", -5120, 4096},
+    {"desert", -6144, -6144}, {"snowland", -5120, 6144}
+};
+
+void chunkStorage() {
+    std::cout << "== chunk storage" << std::endl;
+    std::vector<uPtr<Chunk>> chunks = generateChunks();
+
+    // The flat array every Chunk used to hold
+    std::vector<std::array<BlockType, 65536>> flat(chunks.size());
+    size_t sectionBytes = 0, uniformSections = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        for (int i = 0; i < 65536; i++) {
+            flat[c][i] = chunks[c]->getBlockAt(i & 15, (i >> 4) & 255, i >> 12);
+        }
+        sectionBytes += chunks[c]->blockMemoryUsage();
+        for (int y = 0; y < 256; y += 16) {
+            bool uniform = true;
+            for (int i = 0; i < 4096 && uniform; i++) {
+                uniform = chunks[c]->getBlockAt(i & 15, y + ((i >> 4) & 15), i >> 8) == chunks[c]->getBlockAt(0, y, 0);
+            }
+            uniformSections += uniform;
+        }
+    }
+    std::cout << "chunks:                 " << chunks.size() << std::endl;
+    std::cout << "bytes/chunk flat:       " << sizeof(std::array<BlockType, 65536>) << std::endl;
+    std::cout << "bytes/chunk sections:   " << sectionBytes / chunks.size() << std::endl;
+    std::cout << "single-value sections:  " << uniformSections << " / " << chunks.size() * 16 << std::endl;
+
+    const int ops = 20000000;
+    std::mt19937 rng(1234);
+    std::vector<unsigned int> coords(1 << 16);
+    for (unsigned int &i : coords) {
+        i = rng() & 65535;
+    }
+
+    // Reads
+    unsigned int sum = 0;
+    Clock::time_point start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        sum += flat[n % flat.size()][i];
+    }
+    double flatGet = secondsSince(start);
+    start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        sum += chunks[n % chunks.size()]->getBlockAt(i & 15, (i >> 4) & 255, i >> 12);
+    }
+    double sectionGet = secondsSince(start);
+
+    // Writes of block types already present near the written block,
+    // like the edits made by population and the player. The values come
+    // from a copy taken before, so that only the writes are timed.
+    const std::vector<std::array<BlockType, 65536>> before(flat);
+    start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        flat[n % flat.size()][i] = before[n % flat.size()][i ^ 1];
+    }
+    double flatSet = secondsSince(start);
+    start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        chunks[n % chunks.size()]->setBlockAt(i & 15, (i >> 4) & 255, i >> 12, before[n % flat.size()][i ^ 1]);
+    }
+    double sectionSet = secondsSince(start);
+
+    // The same writes with the value read from the block next to it
+    start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        std::array<BlockType, 65536> &f = flat[n % flat.size()];
+        f[i] = f[i ^ 1];
+    }
+    double flatGetSet = secondsSince(start);
+    start = Clock::now();
+    for (int n = 0; n < ops; n++) {
+        unsigned int i = coords[n & 65535];
+        Chunk *c = chunks[n % chunks.size()].get();
+        unsigned int j = i ^ 1;
+        c->setBlockAt(i & 15, (i >> 4) & 255, i >> 12, c->getBlockAt(j & 15, (j >> 4) & 255, j >> 12));
+    }
+    double sectionGetSet = secondsSince(start);
+
+    // Both sides received the same writes, so they must still agree
+    size_t mismatches = 0;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        for (int i = 0; i < 65536; i++) {
+            mismatches += flat[c][i] != chunks[c]->getBlockAt(i & 15, (i >> 4) & 255, i >> 12);
+        }
+    }
+
+    std::cout << "get Mops/s flat:        " << ops / flatGet * 1e-6 << std::endl;
+    std::cout << "get Mops/s sections:    " << ops / sectionGet * 1e-6 << std::endl;
+    std::cout << "set Mops/s flat:        " << ops / flatSet * 1e-6 << std::endl;
+    std::cout << "set Mops/s sections:    " << ops / sectionSet * 1e-6 << std::endl;
+    std::cout << "get+set Mops/s flat:    " << ops / flatGetSet * 1e-6 << std::endl;
+    std::cout << "get+set Mops/s sections:" << ops / sectionGetSet * 1e-6 << std::endl;
+    std::cout << "mismatched blocks:      " << mismatches << std::endl;
+    std::cout << "(checksum " << sum << ")" << std::endl;
+}
+
+void regionFiles() {
+    std::cout << "== region files" << std::endl;
+    double generateSeconds;
+    std::vector<uPtr<Chunk>> chunks = generateChunks(&generateSeconds);
+
+    QDir dir(QDir::tempPath() + "/MiniMinecraft-benchmark-world");
+    dir.removeRecursively();
+    QDir().mkpath(dir.absolutePath());
+
+    // Same steps as RegionIO, minus the queue
+    Clock::time_point start = Clock::now();
+    size_t compressedBytes = 0;
+    {
+        std::vector<uPtr<RegionFile>> regions;
+        for (const uPtr<Chunk> &c : chunks) {
+            QString name = RegionFile::fileName(RegionFile::regionCoord(c->minX), RegionFile::regionCoord(c->minZ));
+            RegionFile region(dir.filePath(name));
+            QByteArray record = qCompress(RegionFile::encodeChunk(c.get()));
+            compressedBytes += record.size();
+            region.write(RegionFile::indexOf(c->minX, c->minZ), record);
+        }
+    }
+    double saveSeconds = secondsSince(start);
+    std::vector<QString> files;
+    std::unordered_set<int64_t> regionKeys;
+    for (const uPtr<Chunk> &c : chunks) {
+        int regionX = RegionFile::regionCoord(c->minX), regionZ = RegionFile::regionCoord(c->minZ);
+        if (regionKeys.insert(toKey(regionX, regionZ)).second) {
+            files.push_back(RegionFile::fileName(regionX, regionZ));
+        }
+    }
+    qint64 savedBytes = 0;
+    for (const QString &file : files) {
+        savedBytes += QFile(dir.filePath(file)).size();
+    }
+
+    // Edit and save every Chunk again, with records that shrink and grow,
+    // as Chunks evicted and reloaded while the player builds would be
+    const int rewrites = 8;
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> coord(0, 15), height(0, 255), blocks(0, 2000);
+    start = Clock::now();
+    for (int round = 0; round < rewrites; round++) {
+        for (const uPtr<Chunk> &c : chunks) {
+            for (int edit = blocks(rng); edit > 0; edit--) {
+                c->setBlockAt(coord(rng), height(rng), coord(rng), round & 1 ? EMPTY : STONE);
+            }
+            QString name = RegionFile::fileName(RegionFile::regionCoord(c->minX), RegionFile::regionCoord(c->minZ));
+            RegionFile region(dir.filePath(name));
+            region.write(RegionFile::indexOf(c->minX, c->minZ), qCompress(RegionFile::encodeChunk(c.get())));
+        }
+    }
+    double rewriteSeconds = secondsSince(start);
+    qint64 rewrittenBytes = 0, freeBytes = 0;
+    for (const QString &file : files) {
+        rewrittenBytes += QFile(dir.filePath(file)).size();
+        freeBytes += RegionFile(dir.filePath(file)).freeBytes();
+    }
+
+    // Load into fresh Chunks from freshly opened files
+    std::vector<uPtr<Chunk>> loaded;
+    start = Clock::now();
+    for (const uPtr<Chunk> &c : chunks) {
+        QString name = RegionFile::fileName(RegionFile::regionCoord(c->minX), RegionFile::regionCoord(c->minZ));
+        RegionFile region(dir.filePath(name));
+        uPtr<Chunk> l = mkU<Chunk>(nullptr, c->minX, c->minZ);
+        QByteArray record = region.read(RegionFile::indexOf(c->minX, c->minZ));
+        if (!RegionFile::decodeChunk(qUncompress(record), l.get())) {
+            std::cout << "chunk " << c->minX << ", " << c->minZ << " failed to load" << std::endl;
+        }
+        loaded.push_back(std::move(l));
+    }
+    double loadSeconds = secondsSince(start);
+
+    size_t mismatches = 0;
+    std::vector<BlockType> a(65536), b(65536);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        chunks[i]->getBlocks(a.data());
+        loaded[i]->getBlocks(b.data());
+        mismatches += a != b || chunks[i]->biome != loaded[i]->biome || chunks[i]->humidity != loaded[i]->humidity;
+    }
+    dir.removeRecursively();
+
+    std::cout << "chunks:                 " << chunks.size() << std::endl;
+    std::cout << "bytes/chunk on disk:    " << compressedBytes / chunks.size() << std::endl;
+    std::cout << "ms/chunk generate:      " << generateSeconds * 1e3 / chunks.size() << std::endl;
+    std::cout << "ms/chunk save:          " << saveSeconds * 1e3 / chunks.size() << std::endl;
+    std::cout << "ms/chunk rewrite:       " << rewriteSeconds * 1e3 / (rewrites * chunks.size()) << std::endl;
+    std::cout << "ms/chunk load:          " << loadSeconds * 1e3 / chunks.size() << std::endl;
+    std::cout << "KB on disk:             " << savedBytes / 1024 << " saved, " << rewrittenBytes / 1024
+              << " after " << rewrites << " rewrites, " << freeBytes / 1024 << " of it free" << std::endl;
+    std::cout << "mismatched chunks:      " << mismatches << std::endl;
+}
+
+void meshing() {
+    std::cout << "== meshing (terrain only, no population)" << std::endl;
+    const MeshingMode modes[] = {MESH_PER_FACE, MESH_GREEDY};
+    const char *modeNames[] = {"per face", "greedy"};
+
+    for (const auto &biome : biomeZones) {
+        ZoneGrid grid = generateZoneGrid(biome.x, biome.z);
+        std::cout << biome.name << " (" << grid.zone.size() << " chunks)" << std::endl;
+        double faceArea[2];
+        for (int m = 0; m < 2; m++) {
+            size_t vertices = 0;
+            faceArea[m] = 0;
+            Clock::time_point start = Clock::now();
+            for (Chunk *c : grid.zone) {
+                c->meshingMode = modes[m];
+                c->createVBOdata();
+                vertices += c->meshedVertexCount();
+                for (int s = 0; s < 16; s++) {
+                    for (auto *data : {&c->VBOdata.opaque[s], &c->VBOdata.transparent[s]}) {
+                        // Total block faces covered by the quads
+                        for (size_t q = 0; q < data->size(); q += 4) {
+                            glm::vec3 a = glm::vec3((*data)[q + 1].position() - (*data)[q].position());
+                            glm::vec3 b = glm::vec3((*data)[q + 3].position() - (*data)[q].position());
+                            faceArea[m] += glm::length(glm::cross(a, b));
+                        }
+                    }
+                }
+            }
+            double seconds = secondsSince(start);
+            size_t n = grid.zone.size();
+            std::cout << "  " << modeNames[m] << ":" << std::endl;
+            std::cout << "    vertices/chunk:     " << vertices / n << std::endl;
+            std::cout << "    ms/chunk:           " << seconds * 1e3 / n << std::endl;
+            std::cout << "    GPU bytes/chunk:    " << vertices * sizeof(Vertex) / n << std::endl;
+            // What each Chunk uploaded as its own 32-bit index buffers before
+            // all Chunks shared one QuadIndexBuffer
+            std::cout << "    index bytes saved:  " << vertices / 4 * 6 * sizeof(GLuint) / n << std::endl;
+        }
+        std::cout << "  faces covered:        " << faceArea[0] << " vs " << faceArea[1]
+                  << (faceArea[0] == faceArea[1] ? " (match)" : " (MISMATCH)") << std::endl;
+    }
+}
+
+void faceCulling() {
+    std::cout << "== face culling (terrain only, no population)" << std::endl;
+    std::cout << "kernel: FaceMask rows combined with "
+#if defined(__AVX2__)
+              << "AVX2"
+#elif defined(__SSE2__) || defined(_M_X64)
+              << "SSE2"
+#else
+              << "64 bit words"
+#endif
+              << std::endl;
+
+    size_t chunks = 0, mismatches = 0;
+    double referenceSeconds = 0, kernelSeconds = 0;
+    for (const auto &biome : biomeZones) {
+        ZoneGrid grid = generateZoneGrid(biome.x, biome.z);
+        for (Chunk *c : grid.zone) {
+            c->meshingMode = MESH_PER_FACE;
+            Clock::time_point start = Clock::now();
+            c->createVBOdataReference();
+            referenceSeconds += secondsSince(start);
+            auto reference = c->VBOdata;
+
+            start = Clock::now();
+            c->createVBOdata();
+            kernelSeconds += secondsSince(start);
+
+            // The kernel must produce the same quads in the same order
+            bool same = true;
+            for (int s = 0; s < 16; s++) {
+                for (auto data : {std::make_pair(&reference.opaque[s], &c->VBOdata.opaque[s]),
+                                  std::make_pair(&reference.transparent[s], &c->VBOdata.transparent[s])}) {
+                    same = same && data.first->size() == data.second->size();
+                    for (size_t i = 0; same && i < data.first->size(); i++) {
+                        same = (*data.first)[i].a == (*data.second)[i].a && (*data.first)[i].b == (*data.second)[i].b;
+                    }
+                }
+            }
+            mismatches += !same;
+            chunks++;
+        }
+    }
+
+    std::cout << "chunks:                 " << chunks << std::endl;
+    std::cout << "chunks/s reference:     " << chunks / referenceSeconds << std::endl;
+    std::cout << "chunks/s kernel:        " << chunks / kernelSeconds << std::endl;
+    std::cout << "mismatched chunks:      " << mismatches << std::endl;
+}
+
+// How Terrain::draw() found the Chunks to draw before it kept a render
+// list: a hash map lookup for every Chunk of the render distance
+static void probeVisible(const Terrain &terrain, int distance, const Frustum &frustum, std::vector<Chunk *> &visible) {
+    visible.clear();
+    for (int x = -distance * 64; x <= (distance + 1) * 64; x += 16) {
+        for (int z = -distance * 64; z <= (distance + 1) * 64; z += 16) {
+            if (terrain.hasChunkAt(x, z)) {
+                Chunk *c = terrain.getChunkAt(x, z).get();
+                if (c->VBOready && c->meshMinY <= c->meshMaxY
+                        && frustum.intersects(glm::vec3(c->minX, c->meshMinY, c->minZ),
+                                              glm::vec3(c->minX + 16, c->meshMaxY, c->minZ + 16))) {
+                    visible.push_back(c);
+                }
+            }
+        }
+    }
+}
+
+void renderList() {
+    std::cout << "== render list (CPU time to find the chunks to draw, no GL calls)" << std::endl;
+    const int frames = 200;
+    glm::mat4 viewProj = glm::perspective(glm::radians(45.f), 1.5f, 0.1f, 1000.f)
+            * glm::lookAt(glm::vec3(8, 120, 8), glm::vec3(8, 100, -40), glm::vec3(0, 1, 0));
+    Frustum frustum(viewProj);
+
+    for (int distance : {3, 8, 16}) {
+        // Every Chunk of the render distance, pretending to have a mesh
+        Terrain terrain(nullptr);
+        terrain.setRenderDistance(distance);
+        for (int x = -distance * 64; x <= (distance + 1) * 64; x += 16) {
+            for (int z = -distance * 64; z <= (distance + 1) * 64; z += 16) {
+                Chunk *c = terrain.instantiateChunkAt(x, z);
+                c->VBOready = true;
+                c->meshMinY = 40;
+                c->meshMaxY = 140;
+            }
+        }
+
+        // The first call builds the list, as when the player enters a new zone
+        Clock::time_point start = Clock::now();
+        size_t listed = terrain.cullChunks(viewProj).size();
+        double rebuildSeconds = secondsSince(start);
+
+        start = Clock::now();
+        for (int i = 0; i < frames; i++) {
+            listed = terrain.cullChunks(viewProj).size();
+        }
+        double listSeconds = secondsSince(start);
+
+        std::vector<Chunk *> visible;
+        start = Clock::now();
+        for (int i = 0; i < frames; i++) {
+            probeVisible(terrain, distance, frustum, visible);
+        }
+        double probeSeconds = secondsSince(start);
+
+        std::cout << "render distance " << distance << " (" << terrain.residentChunkCount() << " chunks, "
+                  << listed << " visible" << (listed == visible.size() ? "" : ", MISMATCH") << ")" << std::endl;
+        std::cout << "  us/frame lookups:     " << probeSeconds * 1e6 / frames << std::endl;
+        std::cout << "  us/frame render list: " << listSeconds * 1e6 / frames << std::endl;
+        std::cout << "  us to rebuild list:   " << rebuildSeconds * 1e6 << std::endl;
+    }
+}
+
+void transparentSort() {
+    std::cout << "== transparent sort (CPU time to order transparent quads, no GL calls)" << std::endl;
+    const int frames = 400;
+    // Walking speed in blocks per frame
+    const float step = 0.1f;
+
+    for (const auto &biome : biomeZones) {
+        ZoneGrid grid = generateZoneGrid(biome.x, biome.z);
+        // The sections with a transparent mesh
+        std::vector<std::pair<Chunk *, int>> meshed;
+        size_t quads = 0;
+        for (Chunk *c : grid.zone) {
+            c->createVBOdata();
+            for (int s = 0; s < 16; s++) {
+                if (!c->VBOdata.transparent[s].empty()) {
+                    meshed.push_back(std::make_pair(c, s));
+                    quads += c->VBOdata.transparent[s].size() / 4;
+                }
+            }
+        }
+        std::cout << biome.name << " (" << meshed.size() << " meshes, " << quads << " transparent quads)" << std::endl;
+        if (meshed.empty()) {
+            continue;
+        }
+
+        // The camera walks across the zone above sea level
+        auto eyeAt = [&](int frame) {
+            return glm::vec3(biome.x + frame * step, 140.f, biome.z + 32.f);
+        };
+
+        // Sorting every mesh every frame
+        Clock::time_point start = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            for (const auto &cs : meshed) {
+                Chunk *c = cs.first;
+                std::vector<Vertex> vertices = c->VBOdata.transparent[cs.second];
+                SortWorker::sortBackToFront(vertices, eyeAt(f) - glm::vec3(c->minX, 0, c->minZ));
+            }
+        }
+        double everyFrameSeconds = secondsSince(start);
+
+        // As Terrain does: every mesh once, then only the near ones again
+        // when the camera enters another block
+        size_t sorts = 0;
+        glm::ivec3 lastCell(INT_MIN);
+        start = Clock::now();
+        for (int f = 0; f < frames; f++) {
+            glm::vec3 eye = eyeAt(f);
+            glm::ivec3 cell = glm::ivec3(glm::floor(eye));
+            if (cell == lastCell) {
+                continue;
+            }
+            for (const auto &cs : meshed) {
+                Chunk *c = cs.first;
+                int s = cs.second;
+                glm::vec3 nearest = glm::clamp(eye, glm::vec3(c->minX, c->VBOdata.minY[s], c->minZ),
+                                               glm::vec3(c->minX + 16, c->VBOdata.maxY[s], c->minZ + 16));
+                if (f > 0 && glm::distance(eye, nearest) > SortWorker::RESORT_DISTANCE) {
+                    continue;
+                }
+                std::vector<Vertex> vertices = c->VBOdata.transparent[s];
+                SortWorker::sortBackToFront(vertices, eye - glm::vec3(c->minX, 0, c->minZ));
+                sorts++;
+            }
+            lastCell = cell;
+        }
+        double cellSeconds = secondsSince(start);
+
+        std::cout << "  ms/frame every frame: " << everyFrameSeconds * 1e3 / frames << std::endl;
+        std::cout << "  ms/frame on new cell: " << cellSeconds * 1e3 / frames << std::endl;
+        std::cout << "  sorts/frame:          " << double(meshed.size()) << " vs " << double(sorts) / frames << std::endl;
+    }
+}
+
+void blockEdits() {
+    std::cout << "== block edits (worker CPU time to remesh after one edit, greedy meshing)" << std::endl;
+    const int edits = 200;
+    std::mt19937 rng(1);
+    // Inside the zone, so that edits on a Chunk's edge only reach Chunks of the zone
+    std::uniform_int_distribution<int> coord(1, 62);
+
+    for (const auto &biome : biomeZones) {
+        // The zone and the ring of Chunks around it, linked by Terrain
+        Terrain terrain(nullptr);
+        std::vector<Chunk *> chunks;
+        for (int x = biome.x - 16; x < biome.x + 80; x += 16) {
+            for (int z = biome.z - 16; z < biome.z + 80; z += 16) {
+                Chunk *c = terrain.instantiateChunkAt(x, z);
+                Generation::GenerateChunk(c, x, z);
+                c->meshingMode = MESH_GREEDY;
+                chunks.push_back(c);
+            }
+        }
+
+        double wholeSeconds = 0, sectionSeconds = 0;
+        size_t remeshedChunks = 0, remeshedSections = 0;
+        for (int e = 0; e < edits; e++) {
+            for (Chunk *c : chunks) {
+                c->dirtySections = 0;
+            }
+            // Dig out the top block of a column
+            int x = biome.x + coord(rng), z = biome.z + coord(rng);
+            int y = terrain.getChunkAt(x, z)->getHeightAt(x - 16 * static_cast<int>(glm::floor(x / 16.f)),
+                                                          z - 16 * static_cast<int>(glm::floor(z / 16.f)));
+            terrain.setBlockAt(x, y, z, EMPTY);
+
+            for (Chunk *c : chunks) {
+                if (c->dirtySections == 0) {
+                    continue;
+                }
+                // Before sections were tracked, every dirty Chunk was meshed whole
+                c->VBOdata.sections = ALL_SECTIONS;
+                Clock::time_point start = Clock::now();
+                c->createVBOdata();
+                wholeSeconds += secondsSince(start);
+                remeshedChunks++;
+
+                c->VBOdata.sections = c->dirtySections;
+                start = Clock::now();
+                c->createVBOdata();
+                sectionSeconds += secondsSince(start);
+                remeshedSections += std::bitset<16>(c->dirtySections).count();
+            }
+        }
+
+        std::cout << biome.name << " (" << edits << " edits)" << std::endl;
+        std::cout << "  ms/edit whole chunks:   " << wholeSeconds * 1e3 / edits << std::endl;
+        std::cout << "  ms/edit dirty sections: " << sectionSeconds * 1e3 / edits << std::endl;
+        std::cout << "  sections/edit:          " << 16.0 * remeshedChunks / edits << " vs "
+                  << double(remeshedSections) / edits << std::endl;
+    }
+}
+
+// Takes the Chunks the workers have finished out of a completion queue
+static size_t drainCompleted(CompletionQueue<Chunk *> &completed) {
+    size_t count = 0;
+    Chunk *c;
+    while (completed.pop(c)) {
+        count++;
+    }
+    return count;
+}
+
+void streamingStress() {
+    std::cout << "== streaming stress (edits while chunks generate, populate and mesh; "
+              << "build with CONFIG+=thread_sanitizer to check for data races)" << std::endl;
+    const double seconds = 5;
+    // A strip of chunks ROWS wide, streamed in one column at a time
+    const int rows = 5, columns = 16;
+    JobSystem jobs;
+    // Room for every job of one column. Nothing is cancelled here.
+    CompletionQueue<Chunk *> generated(rows), populated(rows), meshed(2 * rows), cancelled(2 * rows);
+    LatencyStats generationLatency;
+    std::mt19937 rng(19);
+    std::uniform_int_distribution<int> block(0, 15), height(100, 180), edge(0, 1);
+
+    size_t laps = 0, edits = 0, generations = 0, populations = 0, meshings = 0;
+    Clock::time_point start = Clock::now();
+    while (secondsSince(start) < seconds) {
+        Terrain terrain(nullptr);
+        int minX = 4096 * static_cast<int>(laps), minZ = 0;
+        auto chunkAt = [&](int i, int j) { return terrain.getChunkAt(minX + 16 * i, minZ + 16 * j).get(); };
+
+        for (int i = 0; i < columns; i++) {
+            size_t started = 0;
+            // Linking the new column to the last one happens while nothing
+            // runs, but the workers below read the last column's border
+            // while the new one is generated
+            for (int j = 0; j < rows; j++) {
+                Chunk *c = terrain.instantiateChunkAt(minX + 16 * i, minZ + 16 * j);
+                c->genState = TERRAIN_RUNNING;
+                BlockTypeWorker *worker = new BlockTypeWorker(&generated, &cancelled, &generationLatency);
+                worker->setChunks({c});
+                jobs.submit(worker);
+                started++;
+            }
+            // Populating column i - 2 writes into columns i - 3 and i - 1,
+            // which are meshed at the same time. Terrain never schedules
+            // these together, so this is harder on the locks than play is.
+            for (int j = 1; j < rows - 1; j++) {
+                if (i >= 3) {
+                    Chunk *c = chunkAt(i - 2, j);
+                    c->genState = POPULATION_RUNNING;
+                    populationworker *worker = new populationworker(&populated);
+                    worker->setChunk(c);
+                    jobs.submit(worker);
+                    started++;
+                }
+                for (int m : {i - 1, i - 3}) {
+                    if (m >= 1) {
+                        Chunk *c = chunkAt(m, j);
+                        c->VBOState = VBO_RUNNING;
+                        c->meshingMode = (m & 1) ? MESH_GREEDY : MESH_PER_FACE;
+                        c->VBOdata.sections = c->dirtySections.exchange(0) | (c->VBOready ? 0 : ALL_SECTIONS);
+                        VBOWorker *worker = new VBOWorker(&meshed, &cancelled);
+                        worker->setChunk(c);
+                        jobs.submit(worker);
+                        started++;
+                    }
+                }
+            }
+
+            // Dig and place blocks in the generated columns, across Chunk
+            // borders too, until the workers are done. Thousands of times
+            // faster than a player edits, but paced so that meshing, which
+            // retries a section whenever it is written mid-read, still runs.
+            size_t finished = 0;
+            while (finished < started && i > 0) {
+                int x = minX + 16 * (i - 1 - static_cast<int>(rng() % std::min(i, 4))) + block(rng);
+                int z = minZ + 16 * (1 + static_cast<int>(rng() % (rows - 2))) + block(rng);
+                if (edge(rng)) {
+                    x -= x & 15;
+                }
+                terrain.setBlockAt(x, height(rng), z, edits & 1 ? STONE : EMPTY);
+                edits++;
+                if (edits % 64 == 0) {
+                    terrain.getChunkAt(x, z)->blockMemoryUsage();
+                    ChunkSection::reclaimRetired();
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(20));
+                size_t g = drainCompleted(generated);
+                size_t p = drainCompleted(populated);
+                size_t v = drainCompleted(meshed);
+                generations += g;
+                populations += p;
+                meshings += v;
+                finished += g + p + v;
+            }
+            jobs.waitForDone();
+            size_t g = drainCompleted(generated);
+            size_t p = drainCompleted(populated);
+            size_t v = drainCompleted(meshed);
+            generations += g;
+            populations += p;
+            meshings += v;
+
+            for (int j = 0; j < rows; j++) {
+                chunkAt(i, j)->genState = TERRAIN_DONE;
+                if (i >= 3 && j >= 1 && j < rows - 1) {
+                    chunkAt(i - 2, j)->genState = GEN_COMPLETE;
+                }
+                for (int m : {i - 1, i - 3}) {
+                    if (m >= 1 && j >= 1 && j < rows - 1) {
+                        chunkAt(m, j)->VBOState = VBO_DONE;
+                        chunkAt(m, j)->VBOready = true;
+                    }
+                }
+            }
+        }
+        laps++;
+    }
+    double elapsed = secondsSince(start);
+
+    std::cout << laps << " strips of " << rows << " x " << columns << " chunks in " << elapsed << " s" << std::endl;
+    std::cout << "  block edits:      " << edits << std::endl;
+    std::cout << "  chunks generated: " << generations << std::endl;
+    std::cout << "  chunks populated: " << populations << std::endl;
+    std::cout << "  chunks meshed:    " << meshings << std::endl;
+    std::cout << "  jobs stolen:      " << jobs.stolenCount() << " on " << jobs.workerCount() << " workers" << std::endl;
+}
+
+void terrainStreaming() {
+    std::cout << "== terrain streaming (GenerateNew() every frame while walking and turning; "
+              << "build with CONFIG+=thread_sanitizer to check for data races)" << std::endl;
+    const double seconds = 10;
+    // Fast enough to leave zones behind and turn into ungenerated ones
+    const float speed = 20.f, turnSeconds = 2.f;
+    // Evicted zones are saved, and encoded on the region thread
+    QDir dir(QDir::tempPath() + "/MiniMinecraft-benchmark-streaming");
+    dir.removeRecursively();
+    uPtr<Terrain> terrain = mkU<Terrain>(nullptr);
+    terrain->setWorldDirectory(dir.absolutePath());
+    terrain->setRenderDistance(2);
+    // Small enough that zones are evicted while their neighbors still work
+    terrain->setMemoryBudget(8 * 1024 * 1024);
+    std::mt19937 rng(22);
+    std::uniform_int_distribution<int> offset(-48, 48), height(100, 180);
+
+    glm::vec3 position(0.f, 140.f, 0.f);
+    size_t frames = 0, edits = 0;
+    Clock::time_point start = Clock::now(), last = start;
+    while (secondsSince(start) < seconds) {
+        double elapsed = secondsSince(start);
+        float dt = static_cast<float>(secondsSince(last));
+        last = Clock::now();
+        // Turn a quarter circle every turnSeconds
+        float angle = static_cast<float>(static_cast<int>(elapsed / turnSeconds)) * 1.5707963f;
+        glm::vec3 forward(glm::cos(angle), 0.f, glm::sin(angle));
+        position += forward * speed * dt;
+        terrain->GenerateNew(position, forward, forward * speed);
+
+        // Dig and place around the player, in Chunks the workers have
+        // finished but may still be reading for their neighbors' meshes
+        for (int e = 0; e < 4; e++) {
+            int x = static_cast<int>(position.x) + offset(rng), z = static_cast<int>(position.z) + offset(rng);
+            if (terrain->hasChunkAt(x, z) && terrain->getChunkAt(x, z)->genState == GEN_COMPLETE) {
+                terrain->setBlockAt(x, height(rng), z, edits & 1 ? STONE : EMPTY);
+                edits++;
+            }
+        }
+        frames++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+
+    std::cout << frames << " frames in " << secondsSince(start) << " s, " << edits << " block edits, "
+              << ChunkSection::retiredMemoryUsage() / 1024.0 << " KB of replaced block storage not yet freed" << std::endl;
+    std::cout << terrain->statsAsString() << std::endl;
+    // Saves every changed Chunk that is left
+    terrain.reset();
+    dir.removeRecursively();
+}
+
+void jobCancellation() {
+    std::cout << "== job cancellation (leaving queued generation and meshing jobs behind)" << std::endl;
+    const int rounds = 20;
+    Terrain terrain(nullptr);
+    terrain.setRenderDistance(1);
+    // Around home, the Chunks that are drawn. Away is far enough that
+    // none of them is in its generation ring or drawn there.
+    const int minHome = -64, maxHome = 128;
+    const glm::vec3 home(32.f, 140.f, 32.f), away(8192.f, 140.f, 32.f), forward(1.f, 0.f, 0.f);
+    auto forArea = [&](glm::vec3 center, auto f) {
+        for (int x = minHome; x < maxHome; x += 16) {
+            for (int z = minHome; z < maxHome; z += 16) {
+                int cx = x + static_cast<int>(center.x - home.x), cz = z + static_cast<int>(center.z - home.z);
+                if (terrain.hasChunkAt(cx, cz)) {
+                    f(terrain.getChunkAt(cx, cz).get());
+                }
+            }
+        }
+    };
+    auto count = [&](glm::vec3 center, auto pred) {
+        int n = 0;
+        forArea(center, [&](Chunk *c) { n += pred(c); });
+        return n;
+    };
+    auto running = [](Chunk *c) { return c->genState == TERRAIN_RUNNING || c->VBOState == VBO_RUNNING; };
+    auto done = [](Chunk *c) { return c->genState == GEN_COMPLETE && c->VBOready; };
+    // Ticks at center until pred holds, or a minute has passed
+    auto tickUntil = [&](glm::vec3 center, auto pred) {
+        Clock::time_point start = Clock::now();
+        do {
+            terrain.GenerateNew(center, forward);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        } while (!pred() && secondsSince(start) < 60);
+    };
+
+    // Once away is meshed, leaving home takes one short tick, which cancels
+    // the jobs home still has queued before the workers get to them
+    tickUntil(away, [&]() { return count(away, done) == count(away, [](Chunk *) { return 1; }); });
+
+    size_t generating = 0, meshing = 0;
+    int requeued = 0, generatedFirst = 0, wrongState = 0;
+    for (int r = 0; r < rounds; r++) {
+        // Back home until it has jobs in flight, in the later rounds until
+        // meshing jobs are among them, then straight away
+        auto leaving = [&r, &running](Chunk *c) { return r >= rounds / 2 ? c->VBOState == VBO_RUNNING : running(c); };
+        Clock::time_point start = Clock::now();
+        for (;;) {
+            terrain.GenerateNew(home, forward);
+            if (count(home, leaving) > 0 || secondsSince(start) > 60) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::vector<std::pair<Chunk *, bool>> left;
+        forArea(home, [&](Chunk *c) {
+            if (running(c)) {
+                left.push_back(std::make_pair(c, c->genState == TERRAIN_RUNNING));
+            }
+        });
+        terrain.GenerateNew(away, forward);
+        tickUntil(away, [&]() { return count(home, running) == 0; });
+
+        // A cancelled generation job leaves its Chunk to be generated
+        // again, and a meshing job of a Chunk no longer drawn leaves it
+        // without a mesh, as if neither had been handed to a worker
+        for (const auto &l : left) {
+            Chunk *c = l.first;
+            if (l.second) {
+                generating++;
+                requeued += c->genState == UNGENERATED;
+                generatedFirst += c->genState != UNGENERATED;
+                wrongState += c->genState == TERRAIN_RUNNING || c->genState == LOAD_RUNNING;
+            } else {
+                meshing++;
+                wrongState += c->VBOState != VBO_NONE || c->VBOready;
+            }
+        }
+    }
+    int cancelled = terrain.cancelledJobCount();
+
+    // Back home for good, every Chunk there is generated and meshed again
+    Clock::time_point start = Clock::now();
+    tickUntil(home, [&]() { return count(home, done) == count(home, [](Chunk *) { return 1; }); });
+    int ready = count(home, done), total = count(home, [](Chunk *) { return 1; });
+
+    std::cout << rounds << " times left home with jobs in flight for " << generating << " generating and "
+              << meshing << " meshing chunks" << std::endl;
+    std::cout << "  jobs cancelled:                  " << cancelled << std::endl;
+    std::cout << "  generation back to ungenerated:  " << requeued << ", finished before the cancel: "
+              << generatedFirst << std::endl;
+    std::cout << "  chunks in the wrong state:       " << wrongState << std::endl;
+    std::cout << "  generated and meshed on return:  " << ready << " / " << total
+              << " in " << secondsSince(start) << " s" << std::endl;
+}
+
+// Runs producers threads that each hand back count items through push,
+// while this thread drains them with drain until all have arrived.
+// Prints the items per second and the longest and average drain.
+template <typename Push, typename Drain>
+static void measureCompletions(const char *name, int producers, int count, Push push, Drain drain) {
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < count; i++) {
+                push(static_cast<intptr_t>(p) * count + i + 1);
+            }
+        });
+    }
+
+    size_t received = 0, drains = 0;
+    double longestDrain = 0, totalDrain = 0;
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    while (received < static_cast<size_t>(producers) * count) {
+        Clock::time_point drainStart = Clock::now();
+        size_t n = drain();
+        double seconds = secondsSince(drainStart);
+        if (n > 0) {
+            received += n;
+            drains++;
+            totalDrain += seconds;
+            longestDrain = std::max(longestDrain, seconds);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    double elapsed = secondsSince(start);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    std::cout << name << std::endl;
+    std::cout << "  M completions/s:  " << received / elapsed * 1e-6 << std::endl;
+    std::cout << "  drain avg us:     " << totalDrain / std::max<size_t>(drains, 1) * 1e6 << std::endl;
+    std::cout << "  drain max us:     " << longestDrain * 1e6 << std::endl;
+}
+
+void completionQueues() {
+    std::cout << "== completion queues (workers on every core handing back results as fast as they can, "
+              << "the GUI thread draining)" << std::endl;
+    const int producers = std::max(1, QThread::idealThreadCount());
+    const int count = 200000;
+    std::cout << "producers:          " << producers << std::endl;
+
+    // The unordered_set and QMutex Terrain used to collect finished Chunks in
+    std::unordered_set<intptr_t> set;
+    QMutex lock;
+    measureCompletions("mutex + unordered_set", producers, count,
+        [&](intptr_t item) {
+            lock.lock();
+            set.insert(item);
+            lock.unlock();
+        },
+        [&]() {
+            size_t n = 0;
+            lock.lock();
+            for (auto it = set.begin(); it != set.end(); ) {
+                it = set.erase(it);
+                n++;
+            }
+            lock.unlock();
+            return n;
+        });
+
+    CompletionQueue<intptr_t> queue(1024);
+    measureCompletions("CompletionQueue", producers, count,
+        [&](intptr_t item) {
+            queue.push(item);
+        },
+        [&]() {
+            size_t n = 0;
+            intptr_t item;
+            while (queue.pop(item)) {
+                n++;
+            }
+            return n;
+        });
+}
+
+void terrainNoise() {
+    std::cout << "== terrain noise" << std::endl;
+    std::cout << "kernel: grid samples evaluated with "
+#if defined(__AVX2__)
+              << "AVX2"
+#elif defined(__SSE2__) || defined(_M_X64)
+              << "SSE2"
+#else
+              << "scalar floats"
+#endif
+              << std::endl;
+
+    // Samples per second of genPerlinNormal one at a time and a grid at a
+    // time, at the scale of the hills and of the fastest varying field
+    for (int size : {16, 64}) {
+        for (double scale : {0.015, 0.05}) {
+            const int grids = size == 16 ? 400 : 25;
+            std::vector<float> grid(size * size);
+            double scalarSeconds = 0, gridSeconds = 0, maxError = 0;
+            for (int g = 0; g < grids; g++) {
+                int minX = 64 * (g % 20) - 640, minZ = 64 * (g / 20) - 640;
+                Clock::time_point start = Clock::now();
+                Noise::genPerlinNormalGrid(.01, scale, minX, minZ, size, grid.data());
+                gridSeconds += secondsSince(start);
+
+                start = Clock::now();
+                for (int z = minZ; z < minZ + size; z++) {
+                    for (int x = minX; x < minX + size; x++) {
+                        float n = Noise::genPerlinNormal(glm::vec2(.01 + x * scale, .01 + z * scale));
+                        maxError = std::max(maxError, double(std::abs(n - grid[(x - minX) + size * (z - minZ)])));
+                    }
+                }
+                scalarSeconds += secondsSince(start);
+            }
+            double samples = double(grids) * size * size;
+            std::cout << size << " x " << size << " grids, scale " << scale << ":" << std::endl;
+            std::cout << "  Msamples/s one at a time: " << samples / scalarSeconds * 1e-6 << std::endl;
+            std::cout << "  Msamples/s by grid:       " << samples / gridSeconds * 1e-6 << std::endl;
+            std::cout << "  max difference:           " << maxError << std::endl;
+        }
+    }
+}
+
+// Heights of zone noise sampled every ZoneNoiseCache::DEFAULT_STEP blocks
+// may be at most this many blocks from the reference heights
+#define ZONE_NOISE_MAX_ERROR 0.25
+
+void zoneNoise() {
+    std::cout << "== zone noise (slowly varying fields sampled once per zone and interpolated)" << std::endl;
+    std::cout << "bound at step " << ZoneNoiseCache::DEFAULT_STEP << ": " << ZONE_NOISE_MAX_ERROR << " blocks" << std::endl;
+
+    // Columns per second of the biome heights GenerateChunk starts from
+    // and their distance from the reference heights, by step
+    bool withinBound = true;
+    for (int step : {1, 2, 4, 8, 16}) {
+        size_t columns = 0, mismatches = 0;
+        double referenceSeconds = 0, zoneSeconds = 0, maxHeightError = 0, totalHeightError = 0;
+        Generation::ColumnHeights reference, interpolated;
+        for (const auto &biome : biomeZones) {
+            for (int zoneX = biome.x; zoneX < biome.x + 256; zoneX += 64) {
+                for (int zoneZ = biome.z; zoneZ < biome.z + 256; zoneZ += 64) {
+                    // Sampling the zone is shared by its 16 Chunks
+                    Clock::time_point start = Clock::now();
+                    Generation::ZoneNoise zone;
+                    Generation::SampleZoneNoise(zoneX, zoneZ, step, zone);
+                    zoneSeconds += secondsSince(start);
+
+                    for (int minX = zoneX; minX < zoneX + 64; minX += 16) {
+                        for (int minZ = zoneZ; minZ < zoneZ + 64; minZ += 16) {
+                            start = Clock::now();
+                            Generation::ComputeColumnHeightsReference(minX, minZ, reference);
+                            referenceSeconds += secondsSince(start);
+
+                            start = Clock::now();
+                            Generation::ComputeColumnHeights(minX, minZ, zone, interpolated);
+                            zoneSeconds += secondsSince(start);
+
+                            for (int i = 0; i < 256; i++) {
+                                double error = std::abs(reference.height[i] - interpolated.height[i]);
+                                maxHeightError = std::max(maxHeightError, error);
+                                totalHeightError += error;
+                                mismatches += static_cast<int>(reference.height[i]) != static_cast<int>(interpolated.height[i]);
+                            }
+                            columns += 256;
+                        }
+                    }
+                }
+            }
+        }
+        if (step == ZoneNoiseCache::DEFAULT_STEP) {
+            withinBound = maxHeightError <= ZONE_NOISE_MAX_ERROR;
+        }
+        std::cout << "step " << step << ":" << std::endl;
+        std::cout << "  columns/s one at a time:   " << columns / referenceSeconds << std::endl;
+        std::cout << "  columns/s from zone noise: " << columns / zoneSeconds << std::endl;
+        std::cout << "  height difference:         " << totalHeightError / columns << " avg, "
+                  << maxHeightError << " max" << std::endl;
+        std::cout << "  columns of another height: " << 100.0 * mismatches / columns << "%" << std::endl;
+    }
+    std::cout << (withinBound ? "within bound" : "BOUND EXCEEDED") << std::endl;
+}
+
+void caveNoise() {
+    std::cout << "== cave noise (one zone of each biome)" << std::endl;
+
+    // Time per Chunk to find its caves, and the blocks that end up
+    // carved out differently than when sampling every block
+    const int steps[][2] = {{2, 2}, {4, 4}, {4, 8}, {8, 8}};
+    Generation::CaveMask reference, interpolated;
+    for (const auto &step : steps) {
+        size_t chunks = 0, referenceCaves = 0, caves = 0, mismatches = 0;
+        double referenceSeconds = 0, latticeSeconds = 0;
+        for (const auto &biome : biomeZones) {
+            for (int minX = biome.x; minX < biome.x + 64; minX += 16) {
+                for (int minZ = biome.z; minZ < biome.z + 64; minZ += 16) {
+                    Clock::time_point start = Clock::now();
+                    Generation::SampleCavesReference(minX, minZ, reference);
+                    referenceSeconds += secondsSince(start);
+
+                    start = Clock::now();
+                    Generation::SampleCaves(minX, minZ, step[0], step[1], interpolated);
+                    latticeSeconds += secondsSince(start);
+
+                    for (size_t i = 0; i < reference.cave.size(); i++) {
+                        referenceCaves += reference.cave[i];
+                        caves += interpolated.cave[i];
+                        mismatches += reference.cave[i] != interpolated.cave[i];
+                    }
+                    chunks++;
+                }
+            }
+        }
+        std::cout << "step " << step[0] << " x " << step[1] << " x " << step[0]
+                  << (step[0] == Generation::CaveMask::STEP_XZ && step[1] == Generation::CaveMask::STEP_Y ? " (used)" : "")
+                  << ":" << std::endl;
+        std::cout << "  ms/chunk every block:  " << referenceSeconds * 1e3 / chunks << std::endl;
+        std::cout << "  ms/chunk lattice:      " << latticeSeconds * 1e3 / chunks << std::endl;
+        std::cout << "  cave blocks:           " << referenceCaves << " -> " << caves << std::endl;
+        std::cout << "  blocks carved differently: " << mismatches << " ("
+                  << 100.0 * mismatches / referenceCaves << "% of the caves)" << std::endl;
+    }
+
+    double seconds = 0;
+    size_t chunks = generateChunks(&seconds).size();
+    std::cout << "ms/chunk GenerateChunk:  " << seconds * 1e3 / chunks << std::endl;
+}
+
+int run(int argc, char *argv[]) {
+    struct Entry { const char *name; void (*fn)(); };
+    const Entry benchmarks[] = {
+        {"storage", chunkStorage},
+        {"region", regionFiles},
+        {"meshing", meshing},
+        {"faces", faceCulling},
+        {"renderlist", renderList},
+        {"transparentsort", transparentSort},
+        {"edits", blockEdits},
+        {"stress", streamingStress},
+        {"streaming", terrainStreaming},
+        {"cancellation", jobCancellation},
+        {"completions", completionQueues},
+        {"noise", terrainNoise},
+        {"zonenoise", zoneNoise},
+        {"caves", caveNoise},
+    };
+
+    // Names given after --benchmark select which benchmarks to run
+    std::vector<const char*> selected;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            for (int j = i + 1; j < argc && argv[j][0] != '-'; j++) {
+                selected.push_back(argv[j]);
+            }
+        }
+    }
+
+    int ran = 0;
+    for (const Entry &b : benchmarks) {
+        bool wanted = selected.empty();
+        for (const char *name : selected) {
+            wanted |= std::strcmp(name, b.name) == 0;
+        }
+        if (wanted) {
+            b.fn();
+            ran++;
+        }
+    }
+    if (ran == 0) {
+        std::cerr << "No benchmark matched. Available:";
+        for (const Entry &b : benchmarks) {
+            std::cerr << " " << b.name;
+        }
+        std::cerr << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}
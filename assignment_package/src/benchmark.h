@@ -0,0 +1,75 @@
+#pragma once
+
+// Offline benchmarks that exercise the terrain code without opening a window.
+// Run the program as `MiniMinecraft --benchmark` to run all of them, or
+// `MiniMinecraft --benchmark <name> ...` to run only the named ones.
+// Results are printed to stdout.
+namespace Benchmark {
+    // Returns the process exit code
+    int run(int argc, char *argv[]);
+
+    // Block storage: bytes per chunk and get/set throughput of the
+    // sectioned palette storage against a flat 65536 block array
+    void chunkStorage();
+
+    // Region files: bytes per chunk on disk, and the time to save and
+    // load a chunk against the time to generate it
+    void regionFiles();
+
+    // Chunk meshing in each MeshingMode for a zone of every biome:
+    // vertices, time and GPU bytes per chunk, and the index bytes
+    // saved by sharing one QuadIndexBuffer
+    void meshing();
+
+    // Chunks meshed per second by the FaceMask kernel against the
+    // reference mesher, and whether their output is identical
+    void faceCulling();
+
+    // CPU time per frame to find the Chunks to draw at several render
+    // distances, with Terrain's render list against looking up every Chunk
+    void renderList();
+
+    // CPU time per frame to keep transparent quads in back to front order
+    // while the camera walks, sorting every mesh each frame against only
+    // sorting the near ones again when the camera enters another block
+    void transparentSort();
+
+    // Worker CPU time to remesh after digging out one block, meshing every
+    // Chunk the edit dirtied whole against only its dirty sections
+    void blockEdits();
+
+    // Streams Chunks in while workers generate, populate and mesh them and
+    // blocks are edited on this thread, without the scheduling Terrain uses
+    // to keep them apart. Meant to be run under ThreadSanitizer.
+    void streamingStress();
+
+    // Walks a player through a Terrain that runs without a GL context,
+    // calling GenerateNew() every frame and editing generated Chunks, so
+    // that Terrain's own scheduling, cancellation and eviction run against
+    // its workers. Meant to be run under ThreadSanitizer as well.
+    void terrainStreaming();
+
+    // Leaves a Terrain's generation and meshing jobs behind while they are
+    // queued, checks that the cancelled Chunks went back to the state they
+    // were queued from, and that they are generated and meshed on return
+    void jobCancellation();
+
+    // Results handed from worker threads on every core to the GUI thread
+    // per second, and how long the GUI thread spends draining them, with
+    // a mutex-guarded set against a CompletionQueue
+    void completionQueues();
+
+    // Noise samples per second one at a time against a grid at a time,
+    // and how far the two differ
+    void terrainNoise();
+
+    // Biome height columns per second sampling all noise at every column
+    // against interpolating the slowly varying noise from samples every
+    // few blocks of the zone, and how far their heights differ
+    void zoneNoise();
+
+    // Time per Chunk to find its caves sampling the noise at every block
+    // against interpolating it from a coarse lattice, how many blocks the
+    // two carve out differently, and the time to generate a Chunk
+    void caveNoise();
+}
@@ -2,9 +2,9 @@
 #include <glm_includes.h>
 
 Drawable::Drawable(OpenGLContext* context)
-    : m_countOpaque(-1), m_bufIdxOpaque(), m_bufIdxTransparrent(), m_bufPos(), m_bufNor(), m_bufCol(), m_bufVertOpaque(), m_bufVertTransparrent(),
+    : m_countOpaque(-1), m_bufIdxOpaque(), m_bufIdxTransparrent(), m_bufPos(), m_bufNor(), m_bufCol(), m_bufVertOpaque(), m_bufVertTransparrent(), m_bufUV(), m_vao(),
       m_idxOpaqueGenerated(false), m_idxTransparrentGenerated(false), m_posGenerated(false), m_norGenerated(false), m_colGenerated(false), m_vertOpaqueGenerated(false), m_vertTransparrentGenerated(false),
-      m_uvGenerated(false),
+      m_uvGenerated(false), m_vaoGenerated(false), m_vaoConfigured(false),
       mp_context(context)
 {
 
@@ -23,7 +23,12 @@ void Drawable::destroyVBOdata()
     mp_context->glDeleteBuffers(1, &m_bufCol);
     mp_context->glDeleteBuffers(1, &m_bufVertOpaque);
     mp_context->glDeleteBuffers(1, &m_bufVertTransparrent);
+    mp_context->glDeleteBuffers(1, &m_bufUV);
+    if (m_vaoGenerated) {
+        mp_context->glDeleteVertexArrays(1, &m_vao);
+    }
     m_idxOpaqueGenerated = m_idxTransparrentGenerated = m_posGenerated = m_norGenerated = m_colGenerated = m_vertOpaqueGenerated = m_vertTransparrentGenerated =  m_uvGenerated =false;
+    m_vaoGenerated = m_vaoConfigured = false;
     m_countOpaque = -1;
     m_countTransparrent = -1;
 
@@ -56,7 +61,10 @@ void Drawable::generateIdxOpaque()
         m_idxOpaqueGenerated = true;
         // Create a VBO on our GPU and store its handle in bufIdx
         mp_context->glGenBuffers(1, &m_bufIdxOpaque);
+        m_vaoConfigured = false;
     }
+    // The caller binds the index buffer next, which the bound VAO records
+    generateVAO();
 
 
 }
@@ -67,7 +75,9 @@ void Drawable::generateIdxTransparrent()
         m_idxTransparrentGenerated = true;
         // Create a VBO on our GPU and store its handle in bufIdx
         mp_context->glGenBuffers(1, &m_bufIdxTransparrent);
+        m_vaoConfigured = false;
     }
+    generateVAO();
 }
 
 void Drawable::generatePos()
@@ -76,6 +86,7 @@ void Drawable::generatePos()
         m_posGenerated = true;
         // Create a VBO on our GPU and store its handle in bufPos
         mp_context->glGenBuffers(1, &m_bufPos);
+        m_vaoConfigured = false;
     }
 }
 
@@ -85,6 +96,7 @@ void Drawable::generateNor()
         m_norGenerated = true;
         // Create a VBO on our GPU and store its handle in bufNor
         mp_context->glGenBuffers(1, &m_bufNor);
+        m_vaoConfigured = false;
     }
 
 }
@@ -95,6 +107,7 @@ void Drawable::generateCol()
         m_colGenerated = true;
         // Create a VBO on our GPU and store its handle in bufCol
         mp_context->glGenBuffers(1, &m_bufCol);
+        m_vaoConfigured = false;
     }
 
 }
@@ -105,6 +118,7 @@ void Drawable::generateVertOpaque()
         m_vertOpaqueGenerated = true;
         // Create a VBO on our GPU and store its handle in m_bufVert
         mp_context->glGenBuffers(1, &m_bufVertOpaque);
+        m_vaoConfigured = false;
     }
 
 }
@@ -115,6 +129,7 @@ void Drawable::generateVertTransparent()
         m_vertTransparrentGenerated = true;
         // Create a VBO on our GPU and store its handle in m_bufVert
         mp_context->glGenBuffers(1, &m_bufVertTransparrent);
+        m_vaoConfigured = false;
     }
 
 }
@@ -125,10 +140,58 @@ void Drawable::generateUV()
         m_uvGenerated = true;
         // Create a VBO on our GPU and store its handle in m_bufUV
         mp_context->glGenBuffers(1, &m_bufUV);
+        m_vaoConfigured = false;
     }
 
 }
 
+void Drawable::generateVAO()
+{
+    if (!m_vaoGenerated) {
+        m_vaoGenerated = true;
+        mp_context->glGenVertexArrays(1, &m_vao);
+        m_vaoConfigured = false;
+    }
+    mp_context->glBindVertexArray(m_vao);
+}
+
+int Drawable::uvComponents()
+{
+    return 4;
+}
+
+void Drawable::configureVAO()
+{
+    // Each attribute reads floats from its own tightly packed buffer
+    auto attribute = [this](GLuint location, bool generated, GLuint buf, int components) {
+        if (generated) {
+            mp_context->glBindBuffer(GL_ARRAY_BUFFER, buf);
+            mp_context->glEnableVertexAttribArray(location);
+            mp_context->glVertexAttribPointer(location, components, GL_FLOAT, false, 0, NULL);
+        } else {
+            mp_context->glDisableVertexAttribArray(location);
+        }
+    };
+    attribute(ATTR_POS, m_posGenerated, m_bufPos, 4);
+    attribute(ATTR_NOR, m_norGenerated, m_bufNor, 4);
+    attribute(ATTR_COL, m_colGenerated, m_bufCol, 4);
+    attribute(ATTR_UV, m_uvGenerated, m_bufUV, uvComponents());
+    bindIdxOpaque();
+}
+
+bool Drawable::bindVAO()
+{
+    if (!m_idxOpaqueGenerated) {
+        return false;
+    }
+    generateVAO();
+    if (!m_vaoConfigured) {
+        configureVAO();
+        m_vaoConfigured = true;
+    }
+    return true;
+}
+
 bool Drawable::bindIdxOpaque()
 {
     if(m_idxOpaqueGenerated) {
@@ -206,6 +269,7 @@ int InstancedDrawable::instanceCount() const {
 void InstancedDrawable::generateOffsetBuf() {
     m_offsetGenerated = true;
     mp_context->glGenBuffers(1, &m_bufPosOffset);
+    m_vaoConfigured = false;
 }
 
 bool InstancedDrawable::bindOffsetBuf() {
@@ -219,11 +283,31 @@ void InstancedDrawable::clearOffsetBuf() {
     if(m_offsetGenerated) {
         mp_context->glDeleteBuffers(1, &m_bufPosOffset);
         m_offsetGenerated = false;
+        m_vaoConfigured = false;
     }
 }
 void InstancedDrawable::clearColorBuf() {
     if(m_colGenerated) {
         mp_context->glDeleteBuffers(1, &m_bufCol);
         m_colGenerated = false;
+        m_vaoConfigured = false;
+    }
+}
+
+void InstancedDrawable::configureVAO() {
+    Drawable::configureVAO();
+    if (!m_offsetGenerated) {
+        mp_context->glDisableVertexAttribArray(ATTR_POS_OFFSET);
+        mp_context->glVertexAttribDivisor(ATTR_COL, 0);
+        return;
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPosOffset);
+    mp_context->glEnableVertexAttribArray(ATTR_POS_OFFSET);
+    mp_context->glVertexAttribPointer(ATTR_POS_OFFSET, 3, GL_FLOAT, false, 0, NULL);
+    mp_context->glVertexAttribDivisor(ATTR_POS_OFFSET, 1);
+    if (m_colGenerated) {
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
+        mp_context->glVertexAttribPointer(ATTR_COL, 3, GL_FLOAT, false, 0, NULL);
     }
+    mp_context->glVertexAttribDivisor(ATTR_COL, 1);
 }
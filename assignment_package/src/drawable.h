@@ -2,6 +2,12 @@
 #include <openglcontext.h>
 #include <glm_includes.h>
 
+// Attribute locations every ShaderProgram binds its inputs to, so that the
+// VAO of a Drawable works with any program
+enum VertexAttribute : GLuint {
+    ATTR_POS = 0, ATTR_NOR, ATTR_COL, ATTR_UV, ATTR_POS_OFFSET, ATTR_PACKED
+};
+
 //This defines a class which can be rendered by our shader program.
 //Make any geometry a subclass of ShaderProgram::Drawable in order to render it with the ShaderProgram class.
 class Drawable
@@ -18,6 +24,7 @@ protected:
     GLuint m_bufVertOpaque;
     GLuint m_bufVertTransparrent;
     GLuint m_bufUV;
+    GLuint m_vao; // The Vertex Array Object recording which buffer feeds each attribute
 
     bool m_idxOpaqueGenerated; // Set to TRUE by generateIdx(), returned by bindIdx().
     bool m_idxTransparrentGenerated;
@@ -27,12 +34,20 @@ protected:
     bool m_vertOpaqueGenerated;
     bool m_vertTransparrentGenerated;
     bool m_uvGenerated;
-
+    bool m_vaoGenerated;
+    bool m_vaoConfigured; // Cleared whenever a new buffer is generated
 
     OpenGLContext* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                           // we need to pass our OpenGL context to the Drawable in order to call GL functions
                           // from within this class.
 
+    // Creates the VAO if needed and binds it
+    void generateVAO();
+    // Points the VAO's attributes at the generated buffers.
+    // Called by bindVAO() after buffers were generated.
+    virtual void configureVAO();
+    // Components of each UV in bufUV
+    virtual int uvComponents();
 
 public:
     Drawable(OpenGLContext* mp_context);
@@ -65,6 +80,10 @@ public:
     bool bindVertTransparent();
     bool bindVertOpaque();
     bool bindUV();
+
+    // Bind the VAO to draw the Drawable, first configuring it if new
+    // buffers were generated. Returns false if nothing was uploaded.
+    bool bindVAO();
 };
 
 // A subclass of Drawable that enables the base code to render duplicates of
@@ -89,5 +108,10 @@ public:
     void clearOffsetBuf();
     void clearColorBuf();
 
+protected:
+    // Colors and offsets are per instance once there is an offset buffer
+    void configureVAO() override;
+public:
+
     virtual void createInstancedVBOdata(std::vector<glm::vec3> &offsets, std::vector<glm::vec3> &colors) = 0;
 };
@@ -52,7 +52,6 @@ void FrameBuffer::create() {
     {
         m_created = false;
         std::cout << "Frame buffer did not initialize correctly..." << std::endl;
-        mp_context->printGLErrorLog();
     }
 }
 
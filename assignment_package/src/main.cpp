@@ -1,4 +1,5 @@
 #include <mainwindow.h>
+#include "benchmark.h"
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -21,6 +22,12 @@ void debugFormatVersion()
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--benchmark") == 0) {
+            return Benchmark::run(argc, argv);
+        }
+    }
+
     QApplication a(argc, argv);
 
     // Set OpenGL 4.0 and, optionally, 4-sample multisampling
@@ -28,6 +35,10 @@ int main(int argc, char *argv[])
     format.setVersion(4, 0);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     format.setProfile(QSurfaceFormat::CoreProfile);
+#ifndef QT_NO_DEBUG
+    // Lets OpenGLContext::startDebugLogging() receive KHR_debug messages
+    format.setOption(QSurfaceFormat::DebugContext);
+#endif
     //format.setSamples(4);  // Uncomment for nice antialiasing. Not always supported.
 
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
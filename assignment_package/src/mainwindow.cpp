@@ -19,6 +19,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerHumid(QString)), &playerInfoWindow, SLOT(slot_setHumidText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendTerrainStats(QString)), &playerInfoWindow, SLOT(slot_setTerrainStatsText(QString)));
 }
 
 MainWindow::~MainWindow()
@@ -20,6 +20,8 @@ MyGL::MyGL(QWidget *parent)
 {
     // Connect the timer to a function so that when the timer ticks the function is executed
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
+    // Player edits count as visible once the frame drawing them is swapped
+    connect(this, SIGNAL(frameSwapped()), this, SLOT(framePresented()));
     // Tell the timer to redraw 60 times per second
     m_timer.start(16);
     setFocusPolicy(Qt::ClickFocus);
@@ -27,13 +29,36 @@ MyGL::MyGL(QWidget *parent)
     // set the initial epoch time
     m_prevFrameTime = QDateTime::currentMSecsSinceEpoch();
 
+    // `--memory-budget <MB>` caps how much memory the Terrain keeps before evicting far away zones
+    QStringList args = QCoreApplication::arguments();
+    int budgetArg = args.indexOf("--memory-budget");
+    if (budgetArg != -1 && budgetArg + 1 < args.size()) {
+        m_terrain.setMemoryBudget(args[budgetArg + 1].toULongLong() * 1024 * 1024);
+    }
+    // `--world <directory>` saves the world there. Without it nothing is written to disk.
+    int worldArg = args.indexOf("--world");
+    if (worldArg != -1 && worldArg + 1 < args.size()) {
+        m_terrain.setWorldDirectory(args[worldArg + 1]);
+    }
+    // `--render-distance <zones>` sets how many zones are drawn on each side of the player's zone
+    int distanceArg = args.indexOf("--render-distance");
+    if (distanceArg != -1 && distanceArg + 1 < args.size()) {
+        m_terrain.setRenderDistance(args[distanceArg + 1].toInt());
+    }
+
+    // `--workers <count>` sets how many threads generate and mesh Chunks,
+    // by default one less than the cores
+    int workersArg = args.indexOf("--workers");
+    if (workersArg != -1 && workersArg + 1 < args.size()) {
+        m_terrain.setWorkerCount(args[workersArg + 1].toInt());
+    }
+
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
     setCursor(Qt::BlankCursor); // Make the cursor invisible
 }
 
 MyGL::~MyGL() {
     makeCurrent();
-    glDeleteVertexArrays(1, &vao);
 }
 
 
@@ -60,10 +85,7 @@ void MyGL::initializeGL()
     // Set the color with which the screen is filled at the start of each render call.
     glClearColor(0.37f, 0.74f, 1.0f, 1);
 
-    printGLErrorLog();
-
-    // Create a Vertex Attribute Object
-    glGenVertexArrays(1, &vao);
+    startDebugLogging();
 
     //Create the instance of the world axes
     m_worldAxes.createVBOdata();
@@ -121,10 +143,6 @@ void MyGL::initializeGL()
     img = img.mirrored();
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img.width(), img.height(), 0, GL_BGRA, GL_UNSIGNED_BYTE, img.bits());
 
-    // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
-    // using multiple VAOs, we can just bind one once.
-    glBindVertexArray(vao);
-
 }
 
 void MyGL::resizeGL(int w, int h) {
@@ -145,8 +163,6 @@ void MyGL::resizeGL(int w, int h) {
     m_progLambert.setViewProjMatrix(viewproj);
     m_progSky.setViewProjMatrix(inverse_viewproj);
     m_progFlat.setViewProjMatrix(viewproj);
-
-    printGLErrorLog();
 }
 
 
@@ -174,7 +190,7 @@ void MyGL::tick() {
                    creepers.end());
 
     // generate new terrain based on player position
-    m_terrain.GenerateNew(m_player.mcr_position);
+    m_terrain.GenerateNew(m_player.mcr_position, m_player.mcr_camera.mcr_forward, m_player.mcr_velocity);
 
     // Set time in the shaders
     m_progLambert.setTime(m_time);
@@ -187,6 +203,10 @@ void MyGL::tick() {
     sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
 }
 
+void MyGL::framePresented() {
+    m_terrain.framePresented();
+}
+
 void MyGL::sendPlayerDataToGUI() const {
     emit sig_sendPlayerPos(m_player.posAsQString());
     emit sig_sendPlayerVel(m_player.velAsQString());
@@ -198,12 +218,19 @@ void MyGL::sendPlayerDataToGUI() const {
     emit sig_sendPlayerChunk(QString::fromStdString("( " + std::to_string(chunk.x) + ", " + std::to_string(chunk.y) + " )"));
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
     emit sig_sendPlayerHumid(QString::fromStdString("( " + std::to_string(m_terrain.getChunkAt(chunk.x, chunk.y)->humidity) + " )"));
+    const GLCallCounts &glCalls = lastFrameGLCalls();
+    emit sig_sendTerrainStats(QString::fromStdString(m_terrain.statsAsString()
+                                                     + "\nGL calls last frame: " + std::to_string(glCalls.issued + glCalls.passed)
+                                                     + " (state " + std::to_string(glCalls.issued) + " issued, "
+                                                     + std::to_string(glCalls.skipped) + " skipped; draws, uploads and attributes "
+                                                     + std::to_string(glCalls.passed) + ")"));
 }
 
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
+    beginFrame();
     m_frameBuffer.bindFrameBuffer();
 
     // Clear the screen so that we only see newly drawn images
@@ -246,7 +273,7 @@ void MyGL::paintGL() {
 }
 
 void MyGL::renderTerrain() {
-    m_terrain.draw(&m_progLambert);
+    m_terrain.draw(&m_progLambert, m_player.mcr_camera.getViewProj(), m_player.mcr_camera.mcr_position);
 }
 
 
@@ -317,6 +344,10 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         m_inputs.shiftPressed = true;
     } else if (e->key() == Qt::Key_C) {
         spawnCreeper();
+    } else if (e->key() == Qt::Key_G) {
+        m_terrain.setMeshingMode(m_terrain.meshingMode() == MESH_GREEDY ? MESH_PER_FACE : MESH_GREEDY);
+    } else if (e->key() == Qt::Key_V) {
+        m_terrain.setFrustumFrozen(!m_terrain.frustumFrozen());
     }
 }
 
@@ -402,10 +433,10 @@ void MyGL::placeBlock() {
             }
         }
         // don't allow block to be placed in the location of a nonempty block
-        if (m_terrain.getBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2]) != EMPTY) {
+        if (isSolid(m_terrain.getBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2]))) {
             return;
         }
-        m_terrain.setBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2], STONE);
+        m_terrain.editBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2], STONE);
     }
 }
 
@@ -419,7 +450,7 @@ void MyGL::removeBlock() {
         // prohibit bedrock from being removed
         BlockType toRemove = m_terrain.getBlockAt(blockToRemove[0], blockToRemove[1], blockToRemove[2]);
         if (toRemove != BEDROCK) {
-            m_terrain.setBlockAt(blockToRemove[0], blockToRemove[1], blockToRemove[2], EMPTY);
+            m_terrain.editBlockAt(blockToRemove[0], blockToRemove[1], blockToRemove[2], EMPTY);
         }
     }
 }
@@ -468,7 +499,7 @@ void MyGL::spawnCreeper() {
             }
         }
         // don't allow block to be placed in the location of a nonempty block
-        if (m_terrain.getBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2]) != EMPTY) {
+        if (isSolid(m_terrain.getBlockAt(newBlockLocation[0], newBlockLocation[1], newBlockLocation[2]))) {
             return;
         }
         uPtr<Creeper> newCreep = mkU<Creeper>(glm::vec3(newBlockLocation[0] + 0.5f, newBlockLocation[1], newBlockLocation[2] + 0.5f), m_terrain, m_head, m_body, m_leg);
@@ -34,8 +34,6 @@ private:
     PostProcessShader m_noOpPostProcessShader;
     FrameBuffer m_frameBuffer;
 
-    GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
-                // Don't worry too much about this. Just know it is necessary in order to render geometry.
     GLuint textureHandle; // handle to the texture file containing block textures
     GLuint creeperTextureHandle; // handle to the creeper texture file
 
@@ -109,6 +107,7 @@ protected:
 
 private slots:
     void tick(); // Slot that gets called ~60 times per second by m_timer firing.
+    void framePresented(); // Slot that gets called when a frame drawn by paintGL() has been swapped to the screen.
 
 signals:
     void sig_sendPlayerPos(QString) const;
@@ -118,6 +117,7 @@ signals:
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
     void sig_sendPlayerHumid(QString) const;
+    void sig_sendTerrainStats(QString) const;
 };
 
 
@@ -4,12 +4,21 @@
 #include <QApplication>
 #include <QProcessEnvironment>
 #include <QOpenGLContext>
+#include <QOpenGLDebugLogger>
 #include <QDebug>
+#include <cstring>
+#include <algorithm>
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
-{}
+    : QOpenGLWidget(parent), m_multiDrawElementsBaseVertex(nullptr), m_multiDrawResolved(false),
+      mp_debugLogger(nullptr), m_program(), m_vertexArray(), m_buffers(), m_activeTexture(), m_textures(),
+      m_caps(), m_blendSrc(), m_blendDst(), m_depthFunc(), m_depthMask(), m_uniforms(),
+      m_glCalls{0, 0, 0}, m_lastFrameGLCalls{0, 0, 0}
+{
+    beginFrame();
+    m_lastFrameGLCalls = {0, 0, 0};
+}
 
 OpenGLContext::~OpenGLContext()
 {}
@@ -69,26 +78,25 @@ void OpenGLContext::debugContextVersion()
     }
 }
 
-void OpenGLContext::printGLErrorLog()
-{
-    GLenum error = glGetError();
-    if (error != GL_NO_ERROR) {
-        std::cerr << "OpenGL error " << error << ": ";
-        const char *e =
-            error == GL_INVALID_OPERATION             ? "GL_INVALID_OPERATION" :
-            error == GL_INVALID_ENUM                  ? "GL_INVALID_ENUM" :
-            error == GL_INVALID_VALUE                 ? "GL_INVALID_VALUE" :
-            error == GL_INVALID_INDEX                 ? "GL_INVALID_INDEX" :
-            error == GL_INVALID_OPERATION             ? "GL_INVALID_OPERATION" :
-            QString::number(error).toUtf8().constData();
-        std::cerr << e << std::endl;
-        // Throwing here allows us to use the debugger to track down the error.
-#ifndef __APPLE__
-        // Don't do this on OS X.
-        // http://lists.apple.com/archives/mac-opengl/2012/Jul/msg00038.html
-        throw;
-#endif
+void OpenGLContext::startDebugLogging()
+{
+#ifndef QT_NO_DEBUG
+    mp_debugLogger = new QOpenGLDebugLogger(this);
+    // Fails when the driver lacks KHR_debug or the context is not a debug context
+    if (!mp_debugLogger->initialize()) {
+        std::cerr << "OpenGL debug output is not available" << std::endl;
+        return;
     }
+    connect(mp_debugLogger, &QOpenGLDebugLogger::messageLogged, [](const QOpenGLDebugMessage &message) {
+        // Put a breakpoint here to see the call that raised the message
+        std::cerr << (message.type() == QOpenGLDebugMessage::ErrorType ? "OpenGL error " : "OpenGL message ")
+                  << message.id() << ": " << message.message().toStdString() << std::endl;
+    });
+    // Drivers report things like where buffers live as notifications
+    mp_debugLogger->disableMessages(QOpenGLDebugMessage::AnySource, QOpenGLDebugMessage::AnyType,
+                                    QOpenGLDebugMessage::NotificationSeverity);
+    mp_debugLogger->startLogging(QOpenGLDebugLogger::SynchronousLogging);
+#endif
 }
 
 void OpenGLContext::printLinkInfoLog(int prog)
@@ -142,3 +150,411 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+void OpenGLContext::glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                                  const void *const *indices, GLsizei drawcount, const GLint *basevertex)
+{
+    if (!m_multiDrawResolved) {
+        m_multiDrawElementsBaseVertex = reinterpret_cast<MultiDrawElementsBaseVertexProc>(
+                    context()->getProcAddress("glMultiDrawElementsBaseVertex"));
+        m_multiDrawResolved = true;
+    }
+    if (m_multiDrawElementsBaseVertex != nullptr) {
+        m_glCalls.passed++;
+        m_multiDrawElementsBaseVertex(mode, count, type, indices, drawcount, basevertex);
+        return;
+    }
+    for (GLsizei i = 0; i < drawcount; i++) {
+        glDrawElementsBaseVertex(mode, count[i], type, indices[i], basevertex[i]);
+    }
+}
+
+template<size_t N>
+static int indexOf(const std::array<GLenum, N> &values, GLenum value)
+{
+    auto it = std::find(values.begin(), values.end(), value);
+    return it == values.end() ? -1 : static_cast<int>(it - values.begin());
+}
+
+void OpenGLContext::beginFrame()
+{
+    m_program = m_vertexArray = UNKNOWN;
+    m_buffers.fill(UNKNOWN);
+    m_activeTexture = UNKNOWN_ENUM;
+    for (auto &unit : m_textures) {
+        unit.fill(UNKNOWN);
+    }
+    m_caps.fill(-1);
+    m_blendSrc = m_blendDst = m_depthFunc = UNKNOWN_ENUM;
+    m_depthMask = -1;
+
+    m_lastFrameGLCalls = m_glCalls;
+    m_glCalls = {0, 0, 0};
+}
+
+const OpenGLContext::GLCallCounts &OpenGLContext::lastFrameGLCalls() const
+{
+    return m_lastFrameGLCalls;
+}
+
+template<typename T>
+bool OpenGLContext::changes(T &cached, T value)
+{
+    if (cached == value) {
+        m_glCalls.skipped++;
+        return false;
+    }
+    cached = value;
+    m_glCalls.issued++;
+    return true;
+}
+
+bool OpenGLContext::uniformChanges(GLint location, const void *value, size_t bytes)
+{
+    if (location == -1) {
+        m_glCalls.issued++;
+        return true;
+    }
+    // Without a known program the value cannot be attributed to it. It
+    // may have gone to any program, so none keeps a value for the location.
+    if (m_program == UNKNOWN) {
+        for (auto it = m_uniforms.begin(); it != m_uniforms.end();) {
+            if (static_cast<uint32_t>(it->first) == static_cast<uint32_t>(location)) {
+                it = m_uniforms.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_glCalls.issued++;
+        return true;
+    }
+    std::vector<unsigned char> &cached = m_uniforms[(static_cast<uint64_t>(m_program) << 32) | static_cast<uint32_t>(location)];
+    if (cached.size() == bytes && std::memcmp(cached.data(), value, bytes) == 0) {
+        m_glCalls.skipped++;
+        return false;
+    }
+    const unsigned char *begin = static_cast<const unsigned char *>(value);
+    cached.assign(begin, begin + bytes);
+    m_glCalls.issued++;
+    return true;
+}
+
+void OpenGLContext::forgetUniforms(GLuint program)
+{
+    for (auto it = m_uniforms.begin(); it != m_uniforms.end();) {
+        if (it->first >> 32 == program) {
+            it = m_uniforms.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void OpenGLContext::glUseProgram(GLuint program)
+{
+    if (changes(m_program, program)) {
+        QOpenGLExtraFunctions::glUseProgram(program);
+    }
+}
+
+void OpenGLContext::glLinkProgram(GLuint program)
+{
+    // Linking resets the program's uniforms
+    forgetUniforms(program);
+    QOpenGLExtraFunctions::glLinkProgram(program);
+}
+
+void OpenGLContext::glDeleteProgram(GLuint program)
+{
+    forgetUniforms(program);
+    QOpenGLExtraFunctions::glDeleteProgram(program);
+}
+
+void OpenGLContext::glBindVertexArray(GLuint array)
+{
+    if (changes(m_vertexArray, array)) {
+        QOpenGLExtraFunctions::glBindVertexArray(array);
+    }
+}
+
+void OpenGLContext::glDeleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+    // Deleting a bound object binds 0 in its place
+    for (GLsizei i = 0; i < n; i++) {
+        if (m_vertexArray == arrays[i]) {
+            m_vertexArray = 0;
+        }
+    }
+    QOpenGLExtraFunctions::glDeleteVertexArrays(n, arrays);
+}
+
+void OpenGLContext::glBindBuffer(GLenum target, GLuint buffer)
+{
+    int t = indexOf(CACHED_BUFFER_TARGETS, target);
+    if (t == -1) {
+        m_glCalls.issued++;
+        QOpenGLExtraFunctions::glBindBuffer(target, buffer);
+    } else if (changes(m_buffers[t], buffer)) {
+        QOpenGLExtraFunctions::glBindBuffer(target, buffer);
+    }
+}
+
+void OpenGLContext::glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    for (GLsizei i = 0; i < n; i++) {
+        for (GLuint &bound : m_buffers) {
+            if (bound == buffers[i]) {
+                bound = 0;
+            }
+        }
+    }
+    QOpenGLExtraFunctions::glDeleteBuffers(n, buffers);
+}
+
+void OpenGLContext::glActiveTexture(GLenum texture)
+{
+    if (changes(m_activeTexture, texture)) {
+        QOpenGLExtraFunctions::glActiveTexture(texture);
+    }
+}
+
+void OpenGLContext::glBindTexture(GLenum target, GLuint texture)
+{
+    int t = indexOf(CACHED_TEXTURE_TARGETS, target);
+    GLuint unit = m_activeTexture - GL_TEXTURE0;
+    if (t == -1 || m_activeTexture == UNKNOWN_ENUM || unit >= TEXTURE_UNITS) {
+        m_glCalls.issued++;
+        QOpenGLExtraFunctions::glBindTexture(target, texture);
+    } else if (changes(m_textures[unit][t], texture)) {
+        QOpenGLExtraFunctions::glBindTexture(target, texture);
+    }
+}
+
+void OpenGLContext::glDeleteTextures(GLsizei n, const GLuint *textures)
+{
+    for (GLsizei i = 0; i < n; i++) {
+        for (auto &unit : m_textures) {
+            for (GLuint &bound : unit) {
+                if (bound == textures[i]) {
+                    bound = 0;
+                }
+            }
+        }
+    }
+    QOpenGLExtraFunctions::glDeleteTextures(n, textures);
+}
+
+void OpenGLContext::setCap(GLenum cap, bool enabled)
+{
+    int c = indexOf(CACHED_CAPS, cap);
+    if (c != -1 && !changes(m_caps[c], static_cast<int>(enabled))) {
+        return;
+    }
+    if (c == -1) {
+        m_glCalls.issued++;
+    }
+    if (enabled) {
+        QOpenGLExtraFunctions::glEnable(cap);
+    } else {
+        QOpenGLExtraFunctions::glDisable(cap);
+    }
+}
+
+void OpenGLContext::glEnable(GLenum cap)
+{
+    setCap(cap, true);
+}
+
+void OpenGLContext::glDisable(GLenum cap)
+{
+    setCap(cap, false);
+}
+
+void OpenGLContext::glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    if (m_blendSrc == sfactor && m_blendDst == dfactor) {
+        m_glCalls.skipped++;
+        return;
+    }
+    m_blendSrc = sfactor;
+    m_blendDst = dfactor;
+    m_glCalls.issued++;
+    QOpenGLExtraFunctions::glBlendFunc(sfactor, dfactor);
+}
+
+void OpenGLContext::glDepthFunc(GLenum func)
+{
+    if (changes(m_depthFunc, func)) {
+        QOpenGLExtraFunctions::glDepthFunc(func);
+    }
+}
+
+void OpenGLContext::glDepthMask(GLboolean flag)
+{
+    if (changes(m_depthMask, static_cast<int>(flag))) {
+        QOpenGLExtraFunctions::glDepthMask(flag);
+    }
+}
+
+void OpenGLContext::glUniform1i(GLint location, GLint v0)
+{
+    if (uniformChanges(location, &v0, sizeof(v0))) {
+        QOpenGLExtraFunctions::glUniform1i(location, v0);
+    }
+}
+
+void OpenGLContext::glUniform2i(GLint location, GLint v0, GLint v1)
+{
+    GLint v[2] {v0, v1};
+    if (uniformChanges(location, v, sizeof(v))) {
+        QOpenGLExtraFunctions::glUniform2i(location, v0, v1);
+    }
+}
+
+void OpenGLContext::glUniform3fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    if (uniformChanges(location, value, count * 3 * sizeof(GLfloat))) {
+        QOpenGLExtraFunctions::glUniform3fv(location, count, value);
+    }
+}
+
+void OpenGLContext::glUniform4fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    if (uniformChanges(location, value, count * 4 * sizeof(GLfloat))) {
+        QOpenGLExtraFunctions::glUniform4fv(location, count, value);
+    }
+}
+
+void OpenGLContext::glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    // The cache holds values only, so a transposed matrix is always set
+    // and the value after it is not compared against it
+    if (transpose) {
+        m_uniforms.erase((static_cast<uint64_t>(m_program) << 32) | static_cast<uint32_t>(location));
+        m_glCalls.issued++;
+        QOpenGLExtraFunctions::glUniformMatrix4fv(location, count, transpose, value);
+    } else if (uniformChanges(location, value, count * 16 * sizeof(GLfloat))) {
+        QOpenGLExtraFunctions::glUniformMatrix4fv(location, count, transpose, value);
+    }
+}
+
+void OpenGLContext::glClear(GLbitfield mask)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glClear(mask);
+}
+
+void OpenGLContext::glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glViewport(x, y, width, height);
+}
+
+void OpenGLContext::glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glBindFramebuffer(target, framebuffer);
+}
+
+void OpenGLContext::glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glDrawElements(mode, count, type, indices);
+}
+
+void OpenGLContext::glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glDrawElementsInstanced(mode, count, type, indices, instancecount);
+}
+
+void OpenGLContext::glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+}
+
+void OpenGLContext::glGenBuffers(GLsizei n, GLuint *buffers)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glGenBuffers(n, buffers);
+}
+
+void OpenGLContext::glGenVertexArrays(GLsizei n, GLuint *arrays)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glGenVertexArrays(n, arrays);
+}
+
+void OpenGLContext::glGenTextures(GLsizei n, GLuint *textures)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glGenTextures(n, textures);
+}
+
+void OpenGLContext::glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glBufferData(target, size, data, usage);
+}
+
+void OpenGLContext::glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glBufferSubData(target, offset, size, data);
+}
+
+void OpenGLContext::glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+}
+
+void OpenGLContext::glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glTexParameteri(target, pname, param);
+}
+
+void OpenGLContext::glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                                 GLint border, GLenum format, GLenum type, const void *pixels)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+void OpenGLContext::glTexBuffer(GLenum target, GLenum internalformat, GLuint buffer)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glTexBuffer(target, internalformat, buffer);
+}
+
+void OpenGLContext::glEnableVertexAttribArray(GLuint index)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glEnableVertexAttribArray(index);
+}
+
+void OpenGLContext::glDisableVertexAttribArray(GLuint index)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glDisableVertexAttribArray(index);
+}
+
+void OpenGLContext::glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void OpenGLContext::glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glVertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+void OpenGLContext::glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+    m_glCalls.passed++;
+    QOpenGLExtraFunctions::glVertexAttribDivisor(index, divisor);
+}
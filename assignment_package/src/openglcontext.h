@@ -3,19 +3,139 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 #include <QOpenGLExtraFunctions>
+#include <array>
+#include <unordered_map>
+#include <vector>
 
+class QOpenGLDebugLogger;
 
+
+// The GL functions below that change bindings, capabilities or uniforms
+// hide those of QOpenGLExtraFunctions with versions that remember the
+// state they set and skip calls that would not change it. Qt may change
+// state before paintGL(), so MyGL forgets it at the start of each frame
+// with beginFrame(); uniform values belong to their program and are kept.
+// Bindings and capabilities the cache does not track are passed through.
+// The draws, uploads and vertex attribute calls after them are counted
+// and passed through, so that the calls of a frame can be measured.
 class OpenGLContext
     : public QOpenGLWidget,
       public QOpenGLExtraFunctions
 {
 
 public:
+    // Calls made through the state cache, and the counted calls it
+    // does not track, which are always issued
+    struct GLCallCounts {
+        int issued, skipped, passed;
+    };
+
     OpenGLContext(QWidget *parent);
     ~OpenGLContext();
 
     void debugContextVersion();
-    void printGLErrorLog();
+    // In debug builds, print the driver's KHR_debug messages as they are
+    // raised, on the thread and in the call that caused them
+    void startDebugLogging();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // glMultiDrawElementsBaseVertex from OpenGL 3.2, which QOpenGLExtraFunctions
+    // does not provide. Resolved from the context on first use, and drawn
+    // with one glDrawElementsBaseVertex per draw if the driver lacks it.
+    void glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei *count, GLenum type,
+                                       const void *const *indices, GLsizei drawcount, const GLint *basevertex);
+
+    // Forget the cached state and start counting the calls of a new frame
+    void beginFrame();
+    const GLCallCounts &lastFrameGLCalls() const;
+
+    void glUseProgram(GLuint program);
+    void glLinkProgram(GLuint program);
+    void glDeleteProgram(GLuint program);
+    void glBindVertexArray(GLuint array);
+    void glDeleteVertexArrays(GLsizei n, const GLuint *arrays);
+    void glBindBuffer(GLenum target, GLuint buffer);
+    void glDeleteBuffers(GLsizei n, const GLuint *buffers);
+    void glActiveTexture(GLenum texture);
+    void glBindTexture(GLenum target, GLuint texture);
+    void glDeleteTextures(GLsizei n, const GLuint *textures);
+    void glEnable(GLenum cap);
+    void glDisable(GLenum cap);
+    void glBlendFunc(GLenum sfactor, GLenum dfactor);
+    void glDepthFunc(GLenum func);
+    void glDepthMask(GLboolean flag);
+    void glUniform1i(GLint location, GLint v0);
+    void glUniform2i(GLint location, GLint v0, GLint v1);
+    void glUniform3fv(GLint location, GLsizei count, const GLfloat *value);
+    void glUniform4fv(GLint location, GLsizei count, const GLfloat *value);
+    void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+
+    void glClear(GLbitfield mask);
+    void glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void glBindFramebuffer(GLenum target, GLuint framebuffer);
+    void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+    void glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instancecount);
+    void glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void *indices, GLint basevertex);
+    void glGenBuffers(GLsizei n, GLuint *buffers);
+    void glGenVertexArrays(GLsizei n, GLuint *arrays);
+    void glGenTextures(GLsizei n, GLuint *textures);
+    void glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+    void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+    void glCopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+    void glTexParameteri(GLenum target, GLenum pname, GLint param);
+    void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+                      GLint border, GLenum format, GLenum type, const void *pixels);
+    void glTexBuffer(GLenum target, GLenum internalformat, GLuint buffer);
+    void glEnableVertexAttribArray(GLuint index);
+    void glDisableVertexAttribArray(GLuint index);
+    void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+    void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer);
+    void glVertexAttribDivisor(GLuint index, GLuint divisor);
+
+private:
+    typedef void (QOPENGLF_APIENTRYP MultiDrawElementsBaseVertexProc)(GLenum, const GLsizei *, GLenum,
+                                                                       const void *const *, GLsizei, const GLint *);
+    MultiDrawElementsBaseVertexProc m_multiDrawElementsBaseVertex;
+    bool m_multiDrawResolved;
+
+    QOpenGLDebugLogger *mp_debugLogger;
+
+    // Marks cached state as not known, so that the next call is issued
+    static constexpr GLuint UNKNOWN = ~0u;
+    static constexpr GLenum UNKNOWN_ENUM = ~0u;
+    static constexpr int TEXTURE_UNITS = 16;
+    // Binding points whose buffer is context state. The element array
+    // buffer is part of the VAO and so is not cached.
+    static constexpr std::array<GLenum, 4> CACHED_BUFFER_TARGETS {
+        GL_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_TEXTURE_BUFFER
+    };
+    static constexpr std::array<GLenum, 2> CACHED_TEXTURE_TARGETS {GL_TEXTURE_2D, GL_TEXTURE_BUFFER};
+    static constexpr std::array<GLenum, 3> CACHED_CAPS {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE};
+
+    GLuint m_program;
+    GLuint m_vertexArray;
+    std::array<GLuint, CACHED_BUFFER_TARGETS.size()> m_buffers;
+    GLenum m_activeTexture;
+    std::array<std::array<GLuint, CACHED_TEXTURE_TARGETS.size()>, TEXTURE_UNITS> m_textures;
+    // 0 or 1 once known
+    std::array<int, CACHED_CAPS.size()> m_caps;
+    GLenum m_blendSrc, m_blendDst;
+    GLenum m_depthFunc;
+    int m_depthMask;
+    // The last value set to each uniform, keyed by program and location
+    std::unordered_map<uint64_t, std::vector<unsigned char>> m_uniforms;
+
+    GLCallCounts m_glCalls;
+    GLCallCounts m_lastFrameGLCalls;
+
+    // Counts the call, and returns true if it should be issued.
+    // Stores value into cached if it is issued.
+    template<typename T>
+    bool changes(T &cached, T value);
+    // Same for a uniform of the current program
+    bool uniformChanges(GLint location, const void *value, size_t bytes);
+    // Uniforms of the program are no longer known
+    void forgetUniforms(GLuint program);
+    void setCap(GLenum cap, bool enabled);
 };
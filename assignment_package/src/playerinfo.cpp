@@ -40,3 +40,6 @@ void PlayerInfo::slot_setHumidText(QString s) {
     ui->humidLabel->setText(s);
 }
 
+void PlayerInfo::slot_setTerrainStatsText(QString s) {
+    ui->statsLabel->setText(s);
+}
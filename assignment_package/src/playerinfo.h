@@ -21,6 +21,7 @@ public slots:
     void slot_setChunkText(QString);
     void slot_setZoneText(QString);
     void slot_setHumidText(QString);
+    void slot_setTerrainStatsText(QString);
 
 private:
     Ui::PlayerInfo *ui;
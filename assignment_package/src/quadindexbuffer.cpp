@@ -0,0 +1,42 @@
+#include "quadindexbuffer.h"
+#include <algorithm>
+#include <vector>
+
+QuadIndexBuffer::QuadIndexBuffer(OpenGLContext *context)
+    : mp_context(context), m_buf(0), m_quadCapacity(0)
+{}
+
+void QuadIndexBuffer::bind(int quads) {
+    if (m_quadCapacity == 0) {
+        mp_context->glGenBuffers(1, &m_buf);
+    }
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buf);
+
+    quads = std::min(quads, MAX_QUADS);
+    if (quads <= m_quadCapacity) {
+        return;
+    }
+    // Grow by at least double so that a few large meshes do not
+    // each cause a new upload
+    m_quadCapacity = std::min(std::max({quads, 2 * m_quadCapacity, 1024}), MAX_QUADS);
+    std::vector<GLushort> indices;
+    indices.reserve(6 * m_quadCapacity);
+    for (int q = 0; q < m_quadCapacity; q++) {
+        GLushort v = static_cast<GLushort>(4 * q);
+        for (GLushort i : {0, 1, 2, 0, 2, 3}) {
+            indices.push_back(static_cast<GLushort>(v + i));
+        }
+    }
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+}
+
+void QuadIndexBuffer::destroy() {
+    if (m_quadCapacity != 0) {
+        mp_context->glDeleteBuffers(1, &m_buf);
+        m_quadCapacity = 0;
+    }
+}
+
+size_t QuadIndexBuffer::gpuBytes() const {
+    return static_cast<size_t>(m_quadCapacity) * 6 * sizeof(GLushort);
+}
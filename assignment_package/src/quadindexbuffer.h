@@ -0,0 +1,29 @@
+#pragma once
+#include "openglcontext.h"
+#include <cstddef>
+
+// One index buffer holding the 0, 1, 2, 0, 2, 3 triangle pattern of
+// consecutive quads, shared by every Chunk so that Chunks only upload
+// vertices. The indices are 16 bit and so address at most MAX_QUADS
+// quads; longer meshes are drawn in batches of MAX_QUADS, each with its
+// first vertex as the base vertex.
+class QuadIndexBuffer {
+private:
+    OpenGLContext *mp_context;
+    GLuint m_buf;
+    // Quads the buffer holds indices for, 0 before it is first bound
+    int m_quadCapacity;
+
+public:
+    // 65536 vertices of four per quad
+    static constexpr int MAX_QUADS = 16384;
+
+    QuadIndexBuffer(OpenGLContext *context);
+    // Bind the buffer to GL_ELEMENT_ARRAY_BUFFER, first growing it to hold
+    // the indices of at least min(quads, MAX_QUADS) quads
+    void bind(int quads);
+    // Deallocate the GPU buffer
+    void destroy();
+    // Bytes of the GPU buffer
+    size_t gpuBytes() const;
+};
@@ -1,17 +1,26 @@
 #include "blocktypeworker.h"
 #include "generation.h"
+#include <QElapsedTimer>
 
-BlockTypeWorker::BlockTypeWorker(int m_xCorner, int m_zCorner, std::vector<Chunk *> m_chunksToGenerate,
-                                 std::unordered_set<Chunk *>* m_generatedChunks, QMutex * m_chunkCompletedLock)
-    : m_xCorner(m_xCorner), m_zCorner(m_zCorner), m_chunksToGenerate(m_chunksToGenerate), m_generatedChunks(m_generatedChunks),
-      m_chunkCompletedLock(m_chunkCompletedLock){}
+BlockTypeWorker::BlockTypeWorker(CompletionQueue<Chunk *>* m_generatedChunks, CompletionQueue<Chunk *>* m_cancelledChunks,
+                                 LatencyStats * m_generationLatency, ZoneNoiseCache * m_zoneNoise)
+    : m_chunksToGenerate(), m_generatedChunks(m_generatedChunks), m_cancelledChunks(m_cancelledChunks),
+      m_generationLatency(m_generationLatency), m_zoneNoise(m_zoneNoise){}
 
+void BlockTypeWorker::setChunks(std::initializer_list<Chunk *> chunks) {
+    m_chunksToGenerate.assign(chunks);
+}
 
 void BlockTypeWorker::run() {
+    QElapsedTimer timer;
     for (Chunk * c:  m_chunksToGenerate){
-        Generation::GenerateChunk(c, c->minX, c->minZ);
-        m_chunkCompletedLock->lock();
-        m_generatedChunks->insert(c);
-        m_chunkCompletedLock->unlock();
+        if (cancelled()) {
+            m_cancelledChunks->push(c);
+            continue;
+        }
+        timer.start();
+        Generation::GenerateChunk(c, c->minX, c->minZ, m_zoneNoise);
+        m_generationLatency->add(timer.nsecsElapsed() * 1e-6);
+        m_generatedChunks->push(c);
     }
 }
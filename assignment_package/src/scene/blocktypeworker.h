@@ -1,17 +1,27 @@
 #pragma once
 #include "chunk.h"
-#include <QRunnable>
-#include <QMutex>
+#include "latencystats.h"
+#include "completionqueue.h"
+#include "jobsystem.h"
+#include "zonenoisecache.h"
+#include <initializer_list>
 
-class BlockTypeWorker : public QRunnable
+// Generates the terrain of its Chunks one after another. Once cancelled,
+// the Chunks it has not started go to m_cancelledChunks untouched.
+class BlockTypeWorker : public Job
 {
 private:
-    int m_xCorner, m_zCorner;
     std::vector<Chunk *> m_chunksToGenerate;
-    std::unordered_set<Chunk *>* m_generatedChunks;
-    QMutex * m_chunkCompletedLock;
+    CompletionQueue<Chunk *>* m_generatedChunks;
+    CompletionQueue<Chunk *>* m_cancelledChunks;
+    LatencyStats * m_generationLatency;
+    ZoneNoiseCache * m_zoneNoise;
 public:
-    BlockTypeWorker(int m_xCorner, int m_zCorner, std::vector<Chunk *> m_chunksToGenerate, std::unordered_set<Chunk *>* m_generatedChunks, QMutex * m_chunkCompletedLock);
+    BlockTypeWorker(CompletionQueue<Chunk *>* m_generatedChunks, CompletionQueue<Chunk *>* m_cancelledChunks,
+                    LatencyStats * m_generationLatency, ZoneNoiseCache * m_zoneNoise = nullptr);
+
+    // The Chunks the next run() generates
+    void setChunks(std::initializer_list<Chunk *> chunks);
 
     void run() override;
 };
@@ -1,22 +1,61 @@
 #include "chunk.h"
+#include <algorithm>
 #include <iostream>
 #include <ostream>
+#include <string>
 
 
-Chunk::Chunk(OpenGLContext* mp_context, int minX, int minZ) : Drawable(mp_context),m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, minX(minX), minZ(minZ), genState(UNGENERATED), VBOState(VBO_NONE),
-    VBOdirty(false), VBOready(false)
+SectionMesh::SectionMesh()
+    : opaque(VertexArena::NO_MESH), transparent(VertexArena::NO_MESH), opaqueVertices(0), minY(0), maxY(-1),
+      transparentVertices(), transparentVersion(0), sortedVersion(-1), sortedCell(0)
+{}
+
+NeighborPtr::NeighborPtr(Chunk *c) : m_chunk(c) {}
+
+NeighborPtr::NeighborPtr(const NeighborPtr &p) : m_chunk(p.get()) {}
+
+NeighborPtr& NeighborPtr::operator=(const NeighborPtr &p) {
+    return *this = p.get();
+}
+
+NeighborPtr& NeighborPtr::operator=(Chunk *c) {
+    m_chunk.store(c, std::memory_order_release);
+    return *this;
+}
+
+Chunk* NeighborPtr::get() const {
+    return m_chunk.load(std::memory_order_acquire);
+}
+
+NeighborPtr::operator Chunk*() const {
+    return get();
+}
+
+Chunk* NeighborPtr::operator->() const {
+    return get();
+}
+
+Chunk::Chunk(OpenGLContext* mp_context, int minX, int minZ) : Drawable(mp_context),m_sections(), m_gpuBytes(0), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {YPOS, nullptr}, {YNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, meshMinY(0), meshMaxY(-1), minX(minX), minZ(minZ),
+    humidity(0), sectionMeshes(), genState(UNGENERATED), VBOState(VBO_NONE),
+    meshingMode(MESH_PER_FACE), VBOdirty(false), dirtySections(0), VBOready(false), saveDirty(false)
 {
-    std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    VBOdata.sections = ALL_SECTIONS;
 }
 
-Chunk::Chunk(OpenGLContext* mp_context, int minX, int minZ, GenState genState) : Drawable(mp_context),m_blocks(), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, minX(minX), minZ(minZ),
-    genState(genState), VBOState(VBO_NONE)
+Chunk::Chunk(OpenGLContext* mp_context, int minX, int minZ, GenState genState) : Drawable(mp_context),m_sections(), m_gpuBytes(0), m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {YPOS, nullptr}, {YNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}, meshMinY(0), meshMaxY(-1), minX(minX), minZ(minZ),
+    humidity(0), sectionMeshes(), genState(genState), VBOState(VBO_NONE), meshingMode(MESH_PER_FACE), VBOdirty(false), dirtySections(0), VBOready(false), saveDirty(false)
 {
+    VBOdata.sections = ALL_SECTIONS;
 }
 
-// Does bounds checking with at()
+// Does the same bounds checking as the flat 65536 block array it replaced:
+// anything that lands inside the array is valid, everything else throws
 BlockType Chunk::getBlockAt(unsigned int x, unsigned int y, unsigned int z) const {
-    return m_blocks.at(x + 16 * y + 16 * 256 * z);
+    unsigned int i = x + 16 * y + 16 * 256 * z;
+    if (i >= 65536) {
+        throw std::out_of_range("Block index " + std::to_string(i) + " is outside of the chunk");
+    }
+    return m_sections[(i >> 8) & 15].getBlockAt((i & 255) + 256 * (i >> 12));
 }
 
 // Exists to get rid of compiler warnings about int -> unsigned int implicit conversion
@@ -24,12 +63,79 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
     return getBlockAt(static_cast<unsigned int>(x), static_cast<unsigned int>(y), static_cast<unsigned int>(z));
 }
 
-// Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
-    if(x + 16 * y + 16 * 256 * z > 65536){
-        throw std::out_of_range("lol");
+    unsigned int i = x + 16 * y + 16 * 256 * z;
+    if (i >= 65536) {
+        throw std::out_of_range("Block index " + std::to_string(i) + " is outside of the chunk");
     }
-    m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    m_sections[(i >> 8) & 15].setBlockAt((i & 255) + 256 * (i >> 12), t);
+}
+
+void Chunk::setBlocks(const BlockType *blocks) {
+    std::array<BlockType, 4096> section;
+    for (int s = 0; s < 16; s++) {
+        for (int z = 0; z < 16; z++) {
+            for (int y = 0; y < 16; y++) {
+                std::copy_n(blocks + 16 * (16 * s + y) + 16 * 256 * z, 16, section.begin() + 16 * y + 256 * z);
+            }
+        }
+        m_sections[s].load(section.data());
+    }
+}
+
+void Chunk::getBlocks(BlockType *blocks) const {
+    getBlocks(blocks, ALL_SECTIONS);
+}
+
+void Chunk::getBlocks(BlockType *blocks, uint16_t sections) const {
+    std::array<BlockType, 4096> section;
+    for (int s = 0; s < 16; s++) {
+        if (((sections >> s) & 1) == 0) {
+            continue;
+        }
+        m_sections[s].unpack(section.data());
+        for (int z = 0; z < 16; z++) {
+            for (int y = 0; y < 16; y++) {
+                std::copy_n(section.begin() + 16 * y + 256 * z, 16, blocks + 16 * (16 * s + y) + 16 * 256 * z);
+            }
+        }
+    }
+}
+
+void Chunk::markDirty(uint16_t sections) {
+    if (sections != 0) {
+        // The sections are in place before the flag that makes the GUI thread look at them
+        dirtySections.fetch_or(sections);
+        VBOdirty = true;
+    }
+}
+
+uint16_t Chunk::sectionsAround(int y) {
+    uint16_t sections = 1 << (y >> 4);
+    if ((y & 15) == 0) {
+        sections |= sections >> 1;
+    } else if ((y & 15) == 15) {
+        sections |= static_cast<uint16_t>(sections << 1);
+    }
+    return sections;
+}
+
+uint16_t Chunk::nonEmptySections() const {
+    uint16_t sections = 0;
+    for (int s = 0; s < 16; s++) {
+        if (!m_sections[s].isEmpty()) {
+            sections |= 1 << s;
+        }
+    }
+    return sections;
+}
+
+size_t Chunk::blockMemoryUsage() const {
+    size_t total = 0;
+    for (const ChunkSection &s : m_sections) {
+        total += s.memoryUsage();
+    }
+    return total;
 }
 
 
@@ -42,15 +148,39 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
     {ZNEG, ZPOS}
 };
 
+// Only the border faces of the two Chunks change, so only their
+// sections with blocks in them are remeshed
 void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
     if(neighbor != nullptr) {
         this->m_neighbors[dir] = neighbor.get();
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
-        this->VBOdirty = true;
-        neighbor->VBOdirty = true;
+        this->markDirty(this->nonEmptySections());
+        neighbor->markDirty(neighbor->nonEmptySections());
+
+    }
+
+}
 
+void Chunk::unlinkNeighbors() {
+    for (auto &kv : m_neighbors) {
+        if (kv.second != nullptr) {
+            kv.second->m_neighbors[oppositeDirection.at(kv.first)] = nullptr;
+            kv.second->markDirty(kv.second->nonEmptySections());
+            kv.second = nullptr;
+        }
     }
+}
+
+size_t Chunk::gpuMemoryUsage() const {
+    return m_gpuBytes;
+}
 
+size_t Chunk::meshMemoryUsage() const {
+    size_t bytes = 0;
+    for (const SectionMesh &m : sectionMeshes) {
+        bytes += m.transparentVertices.capacity() * sizeof(Vertex);
+    }
+    return bytes;
 }
 
 void Chunk::setminX(int newX) {
@@ -65,144 +195,346 @@ void Chunk::setHumidity(float h) {
     humidity = h;
 }
 
-void Chunk::SendVBOdata(){
-
-    std::vector<Vertex> &combinedVertexOpaque = this->VBOdata.combinedVertexOpaque;
-    std::vector<GLuint> &combinedIdxOpaque = this->VBOdata.combinedIdxOpaque;
-    std::vector<Vertex> &combinedVertexTransparrent = this->VBOdata.combinedVertexTransparrent;
-    std::vector<GLuint> &combinedIdxtransparrent = this->VBOdata.combinedIdxTransparrent;
-
-    m_countOpaque = combinedIdxOpaque.size();
-    m_countTransparrent = combinedIdxtransparrent.size();
-    generateIdxOpaque();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpaque);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, combinedIdxOpaque.size() * sizeof(GLuint), combinedIdxOpaque.data(), GL_STATIC_DRAW);
-
-    generateVertOpaque();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufVertOpaque);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, combinedVertexOpaque.size() * sizeof(Vertex), combinedVertexOpaque.data(), GL_STATIC_DRAW);
-
-    generateIdxTransparrent();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTransparrent);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, combinedIdxtransparrent.size() * sizeof(GLuint), combinedIdxtransparrent.data(), GL_STATIC_DRAW);
-
-    generateVertTransparent();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufVertTransparrent);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, combinedVertexTransparrent.size() * sizeof(Vertex), combinedVertexTransparrent.data(), GL_STATIC_DRAW);
+void Chunk::SendVBOdata(VertexArena &arena){
+    for (int s = 0; s < 16; s++) {
+        if (((VBOdata.sections >> s) & 1) == 0) {
+            continue;
+        }
+        SectionMesh &m = sectionMeshes[s];
+        std::vector<Vertex> &opaque = VBOdata.opaque[s];
+        std::vector<Vertex> &transparent = VBOdata.transparent[s];
+        arena.release(m.opaque);
+        arena.release(m.transparent);
+        m.opaque = arena.allocate(opaque, glm::ivec2(minX, minZ));
+        m.transparent = arena.allocate(transparent, glm::ivec2(minX, minZ));
+        m.opaqueVertices = static_cast<int>(opaque.size());
+        m.minY = VBOdata.minY[s];
+        m.maxY = VBOdata.maxY[s];
+        // The quads are in meshing order until Terrain sorts them
+        m.transparentVertices = std::move(transparent);
+        m.transparentVersion++;
+        std::vector<Vertex>().swap(opaque);
+        transparent.clear();
+    }
 
+    // Every 4 vertices form one quad, drawn with the shared QuadIndexBuffer
+    int opaqueVertices = 0, transparentVertices = 0;
+    meshMinY = 256;
+    meshMaxY = -1;
+    for (const SectionMesh &m : sectionMeshes) {
+        opaqueVertices += m.opaqueVertices;
+        transparentVertices += static_cast<int>(m.transparentVertices.size());
+        if (m.minY <= m.maxY) {
+            meshMinY = std::min(meshMinY, m.minY);
+            meshMaxY = std::max(meshMaxY, m.maxY);
+        }
+    }
+    m_countOpaque = opaqueVertices / 4 * 6;
+    m_countTransparrent = transparentVertices / 4 * 6;
+    m_gpuBytes = (opaqueVertices + transparentVertices) * sizeof(Vertex);
     VBOState = VBO_DONE;
     VBOready = true;
-    this->VBOdata.combinedVertexOpaque.clear();
-    this->VBOdata.combinedIdxOpaque.clear();
-    this->VBOdata.combinedVertexTransparrent.clear();
-    this->VBOdata.combinedIdxTransparrent.clear();
 }
 
-void Chunk::deleteVBOdata(){
+void Chunk::deleteVBOdata(VertexArena &arena){
     if (VBOready != true){
         throw std::logic_error("VBO continuity error");
     }
     VBOState = VBO_NONE;
     VBOready = false;
-    this->destroyVBOdata();
+    m_gpuBytes = 0;
+    for (SectionMesh &m : sectionMeshes) {
+        arena.release(m.opaque);
+        arena.release(m.transparent);
+        int version = m.transparentVersion;
+        m = SectionMesh();
+        m.transparentVersion = version + 1;
+    }
+}
+
+void Chunk::prepareMeshing(std::vector<BlockType> &blocks, FaceMask &faces) {
+    uint16_t sections = VBOdata.sections;
+    blocks.assign(65536, EMPTY);
+    getBlocks(blocks.data(), sections | static_cast<uint16_t>(sections << 1) | static_cast<uint16_t>(sections >> 1));
+    faces.build(blocks.data(), m_neighbors[XPOS], m_neighbors[XNEG], m_neighbors[ZPOS], m_neighbors[ZNEG], sections);
+}
+
+size_t Chunk::meshedVertexCount() const {
+    size_t vertices = 0;
+    for (int s = 0; s < 16; s++) {
+        if ((VBOdata.sections >> s) & 1) {
+            vertices += VBOdata.opaque[s].size() + VBOdata.transparent[s].size();
+        }
+    }
+    return vertices;
 }
 
 void Chunk::createVBOdata() {
-    std::vector<GLuint> opaqueIdx, clearIdx, combinedIdxOpaque, combinedIdxtransparrent;
-    std::vector<Vertex> opaqueData, clearData, combinedVertexOpaque, combinedVertexTransparrent;
+    if (meshingMode == MESH_GREEDY) {
+        createVBOdataGreedy();
+        return;
+    }
+
+    std::vector<BlockType> blocks;
+    FaceMask faces;
+    prepareMeshing(blocks, faces);
+
+    // Same order as createVBOdataReference(): by section, then x, then y, then z, then face
+    for (int s = 0; s < 16; s++) {
+        if (((VBOdata.sections >> s) & 1) == 0) {
+            continue;
+        }
+        std::vector<Vertex> opaqueData, clearData;
+        for (int x = 0; x < 16; x++) {
+            for (int y = 16 * s; y < 16 * (s + 1); y++) {
+                uint16_t any = faces.anyRow(x, y);
+                for (int z = 0; any != 0; z++, any >>= 1) {
+                    if ((any & 1) == 0) {
+                        continue;
+                    }
+                    BlockType t = blocks[x + 16 * y + 16 * 256 * z];
+                    bool clear = isClear(t);
+                    for (const BlockFace &f : adjacentFaces) {
+                        if ((faces.row(f.direction, x, y) >> z) & 1) {
+                            if (clear) {
+                                appendVBOData(clearData, f, t, glm::ivec3(x,y,z));
+                            } else {
+                                appendVBOData(opaqueData, f, t, glm::ivec3(x,y,z));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        setVBOdata(s, opaqueData, clearData);
+    }
+}
+
+void Chunk::createVBOdataReference() {
+    for (int s = 0; s < 16; s++) {
+        if (((VBOdata.sections >> s) & 1) == 0) {
+            continue;
+        }
+        std::vector<Vertex> opaqueData, clearData;
 
         for (int x = 0;  x < 16; x++) {
-            for (int y = 0; y < 256; y++) {
+            for (int y = 16 * s; y < 16 * (s + 1); y++) {
                 for (int z = 0; z < 16; z++) {
                     BlockType t = getBlockAt(x, y, z);
 
-                if (t != EMPTY) {
-                    for (const BlockFace &f : adjacentFaces) {
-                        BlockType adj;
-                        bool crossed = false;
-                        if (crossBorder(glm::ivec3(x,y,z), glm::ivec3(f.directionVec))) {
-                            crossed = true;
-                            Chunk* neighbor = m_neighbors[f.direction];
-                            if (neighbor == nullptr) {
-                                adj = EMPTY;
-                            } else {
-                                int dx = (x + (int)f.directionVec.x) % 16;
-                                if (dx < 0) {
-                                    dx = 16 + dx;
+                    if (t != EMPTY) {
+                        for (const BlockFace &f : adjacentFaces) {
+                            BlockType adj;
+                            bool crossed = false;
+                            if (crossBorder(glm::ivec3(x,y,z), glm::ivec3(f.directionVec))) {
+                                crossed = true;
+                                Chunk* neighbor = m_neighbors[f.direction];
+                                if (neighbor == nullptr) {
+                                    adj = EMPTY;
+                                } else {
+                                    int dx = (x + (int)f.directionVec.x) % 16;
+                                    if (dx < 0) {
+                                        dx = 16 + dx;
+                                    }
+                                    int dy = (y + (int)f.directionVec.y) % 256;
+                                    if (dy < 0) {
+                                        dy = 256 + dy;
+                                    }
+                                    int dz = (z + (int)f.directionVec.z) % 16;
+                                    if (dz < 0) {
+                                        dz = 16 + dz;
+                                    }
+                                    adj = neighbor->getBlockAt(dx, dy, dz);
                                 }
-                                int dy = (y + (int)f.directionVec.y) % 256;
-                                if (dy < 0) {
-                                    dy = 256 + dy;
+                            } else {
+                                adj = getBlockAt(x + (int)f.directionVec.x, y + (int)f.directionVec.y, z + (int)f.directionVec.z);
+                            }
+                            if (isClear(t)) {
+                                if (adj == EMPTY && !crossed) {
+                                    appendVBOData(clearData, f, t, glm::ivec3(x,y,z));
                                 }
-                                int dz = (z + (int)f.directionVec.z) % 16;
-                                if (dz < 0) {
-                                    dz = 16 + dz;
+                            } else {
+                                if (isClear(adj)) {
+                                    appendVBOData(opaqueData, f, t, glm::ivec3(x,y,z));
                                 }
-                                adj = neighbor->getBlockAt(dx, dy, dz);
-                            }
-                        } else {
-                            adj = getBlockAt(x + (int)f.directionVec.x, y + (int)f.directionVec.y, z + (int)f.directionVec.z);
-                        }
-                        if (isClear(t)) {
-                            if (adj == EMPTY && !crossed) {
-                                appendVBOData(clearIdx, clearData, f, t, glm::ivec3(x,y,z), minX, minZ);
-                            }
-                        } else {
-                            if (isClear(adj)) {
-                                appendVBOData(opaqueIdx, opaqueData, f, t, glm::ivec3(x,y,z), minX, minZ);
                             }
                         }
                     }
                 }
             }
         }
-    }
 
-    combineVBO(opaqueData,combinedVertexOpaque, combinedIdxOpaque);
-    combineVBO(clearData,combinedVertexTransparrent, combinedIdxtransparrent);
+        setVBOdata(s, opaqueData, clearData);
+    }
+}
 
-    VBOdata.combinedVertexOpaque = std::move(combinedVertexOpaque);
-    VBOdata.combinedIdxOpaque = std::move(combinedIdxOpaque);
-    VBOdata.combinedVertexTransparrent = std::move(combinedVertexTransparrent);
-    VBOdata.combinedIdxTransparrent = std::move(combinedIdxtransparrent);
+void Chunk::setVBOdata(int s, std::vector<Vertex> &opaqueData, std::vector<Vertex> &clearData) {
+    int minY = 256, maxY = -1;
+    for (const std::vector<Vertex> *data : {&opaqueData, &clearData}) {
+        for (const Vertex &v : *data) {
+            int y = v.position().y;
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+    }
+    VBOdata.minY[s] = minY;
+    VBOdata.maxY[s] = maxY;
+    VBOdata.opaque[s] = std::move(opaqueData);
+    VBOdata.transparent[s] = std::move(clearData);
 }
 
-void Chunk::appendVBOData(std::vector<GLuint> &idx, std::vector<Vertex> &data, const BlockFace &f, BlockType t, glm::ivec3 xyz, float world_x, float world_z) {
-    int x = xyz.x, y = xyz.y, z = xyz.z;
+void Chunk::appendVBOData(std::vector<Vertex> &data, const BlockFace &f, BlockType t, glm::ivec3 xyz) {
+    int x = xyz.x, z = xyz.z;
 
     const std::array<VertexData, 4> &vertDat = f.vertices;
 
-    glm::vec4 uvOffset = glm::vec4(blockUVs.at(t).at(f.direction), 0, 0);
+    glm::vec2 tile = blockUV(t, f.direction);
+
+    // Add humidity
+    float humidity = 0;
+    if (t == GRASS && f.direction == YPOS) {
+        humidity = grassHumidity(x, z);
+    }
+
+    // Add flag to animated blocks
+    unsigned int flags = isAnimated(t) ? 1 : 0;
 
     for (const VertexData &vd : vertDat) {
-        // Pos
-        glm::vec4 pos = glm::vec4(vd.pos.x + x + world_x, vd.pos.y + y, vd.pos.z + z + world_z, vd.pos.w);
-        // Nor
-        glm::vec4 nor = glm::vec4(f.directionVec.x, f.directionVec.y, f.directionVec.z, 0);
-        // UV
-        glm::vec4 uv = uvOffset + vd.uv;
+        data.push_back(Vertex(xyz + glm::ivec3(vd.pos), f.direction, tile, glm::vec2(vd.uv), humidity, flags));
+    }
+}
+
+float Chunk::grassHumidity(int x, int z) {
+    float xPosStep = glm::smoothstep(0.f, 15.f, 15.f-float(x));
+    float xNegStep = glm::smoothstep(0.f, 15.f, float(x));
+    float zPosStep = glm::smoothstep(0.f, 15.f, 15.f-float(z));
+    float zNegStep = glm::smoothstep(0.f, 15.f, float(z));
+    float xPosHumidity = glm::mix(m_neighbors[XPOS]->humidity.load(), humidity.load(), xPosStep);
+    float xNegHumidity = glm::mix(m_neighbors[XNEG]->humidity.load(), humidity.load(), xNegStep);
+    float zPosHumidity = glm::mix(m_neighbors[ZPOS]->humidity.load(), humidity.load(), zPosStep);
+    float zNegHumidity = glm::mix(m_neighbors[ZNEG]->humidity.load(), humidity.load(), zNegStep);
+    return (xPosHumidity + xNegHumidity + zPosHumidity + zNegHumidity) / 4.f;
+}
 
-        // Add humidity
-        if (t == GRASS && f.direction == YPOS) {
-            float xPosStep = glm::smoothstep(0.f, 15.f, 15.f-float(x));
-            float xNegStep = glm::smoothstep(0.f, 15.f, float(x));
-            float zPosStep = glm::smoothstep(0.f, 15.f, 15.f-float(z));
-            float zNegStep = glm::smoothstep(0.f, 15.f, float(z));
-            float xPosHumidity = glm::mix(m_neighbors[XPOS]->humidity, humidity, xPosStep);
-            float xNegHumidity = glm::mix(m_neighbors[XNEG]->humidity, humidity, xNegStep);
-            float zPosHumidity = glm::mix(m_neighbors[ZPOS]->humidity, humidity, zPosStep);
-            float zNegHumidity = glm::mix(m_neighbors[ZNEG]->humidity, humidity, zNegStep);
-            uv[2] = (xPosHumidity + xNegHumidity + zPosHumidity + zNegHumidity) / 4.f;
+void Chunk::createVBOdataGreedy() {
+    std::vector<BlockType> blocks;
+    FaceMask faces;
+    prepareMeshing(blocks, faces);
+
+    // Quads are not merged across sections, so that each section is meshed on its own
+    uint16_t nonEmpty = nonEmptySections();
+    for (int s = 0; s < 16; s++) {
+        if (((VBOdata.sections >> s) & 1) == 0) {
+            continue;
+        }
+        std::vector<Vertex> opaqueData, clearData;
+        // A section of all air has no faces
+        if ((nonEmpty >> s) & 1) {
+            for (const BlockFace &f : adjacentFaces) {
+                appendGreedyFaces(blocks, faces, f, s, opaqueData, clearData);
+            }
         }
+        setVBOdata(s, opaqueData, clearData);
+    }
+}
 
-        // Add flag to animated blocks
-        if (isAnimated(t)) {
-            uv[3] = 1;
+void Chunk::appendGreedyFaces(const std::vector<BlockType> &blocks, const FaceMask &faces, const BlockFace &f, int section,
+                              std::vector<Vertex> &opaqueData, std::vector<Vertex> &clearData) {
+    // Slices span the section, whose blocks start at y = bottom
+    const int bottom = 16 * section;
+    const glm::ivec3 range(16, 16, 16);
+    const glm::ivec3 dir(f.directionVec);
+    // n is the axis the face points along, u and v span the face's plane
+    int n = dir.x != 0 ? 0 : (dir.y != 0 ? 1 : 2);
+    int u = n == 0 ? 2 : 0;
+    int v = n == 1 ? 2 : 1;
+
+    // The BlockType of every visible face in the current slice, EMPTY where there is none
+    std::vector<BlockType> mask(range[u] * range[v]);
+
+    for (int s = 0; s < range[n]; s++) {
+        // Only the blocks with a visible face are written into the mask,
+        // found from whichever FaceMask rows cross this slice
+        std::fill(mask.begin(), mask.end(), EMPTY);
+        int count = 0;
+        for (int b = 0; b < range[v]; b++) {
+            for (int a = 0; a < range[u]; a++) {
+                glm::ivec3 q;
+                q[n] = s; q[u] = a; q[v] = b;
+                q.y += bottom;
+                uint16_t row = faces.row(f.direction, q.x, q.y);
+                if (u == 2) {
+                    // The row runs along the slice, so it fills a whole line of the mask
+                    for (; row != 0; a++, row >>= 1) {
+                        if (row & 1) {
+                            mask[a + range[u] * b] = blocks[q.x + 16 * q.y + 16 * 256 * a];
+                            count++;
+                        }
+                    }
+                    break;
+                }
+                if ((row >> q.z) & 1) {
+                    mask[a + range[u] * b] = blocks[q.x + 16 * q.y + 16 * 256 * q.z];
+                    count++;
+                }
+            }
         }
+        if (count == 0) {
+            continue;
+        }
+        for (int b = 0; b < range[v]; b++) {
+            for (int a = 0; a < range[u]; ) {
+                BlockType t = mask[a + range[u] * b];
+                if (t == EMPTY) {
+                    a++;
+                    continue;
+                }
+                // Animated blocks wave per vertex, so they keep one quad per face
+                bool animated = isAnimated(t);
+                int w = 1;
+                while (!animated && a + w < range[u] && mask[a + w + range[u] * b] == t) {
+                    w++;
+                }
+                int h = 1;
+                while (!animated && b + h < range[v]) {
+                    bool rowMatches = true;
+                    for (int i = 0; i < w && rowMatches; i++) {
+                        rowMatches = mask[a + i + range[u] * (b + h)] == t;
+                    }
+                    if (!rowMatches) {
+                        break;
+                    }
+                    h++;
+                }
+                for (int j = 0; j < h; j++) {
+                    std::fill_n(mask.begin() + a + range[u] * (b + j), w, EMPTY);
+                }
 
-        // Vertex
-        Vertex v = Vertex(pos, nor, uv);
-        data.push_back(v);
+                glm::ivec3 origin, extent(1);
+                origin[n] = s; origin[u] = a; origin[v] = b;
+                origin.y += bottom;
+                extent[u] = w; extent[v] = h;
+                glm::vec2 tile = blockUV(t, f.direction);
+                std::vector<Vertex> &data = isClear(t) ? clearData : opaqueData;
+                for (const VertexData &vd : f.vertices) {
+                    glm::ivec3 pos = origin + glm::ivec3(vd.pos) * extent;
+                    if (animated) {
+                        data.push_back(Vertex(pos, f.direction, tile, glm::vec2(vd.uv), 0, 1));
+                        continue;
+                    }
+                    // The fragment shader repeats the tile once per block
+                    // (flag 2), starting from the tile's corner
+                    float humidity = 0;
+                    if (t == GRASS && f.direction == YPOS) {
+                        // Humidity of the block in this corner of the quad
+                        humidity = grassHumidity(origin.x + (vd.pos.x > 0 ? extent.x - 1 : 0),
+                                                 origin.z + (vd.pos.z > 0 ? extent.z - 1 : 0));
+                    }
+                    data.push_back(Vertex(pos, f.direction, tile, glm::vec2(0), humidity, 2));
+                }
+                a += w;
+            }
+        }
     }
 }
 
@@ -214,20 +546,6 @@ bool crossBorder(glm::ivec3 p1, glm::ivec3 p2) {
 
 }
 
-void Chunk::combineVBO(std::vector<Vertex> &data, std::vector<Vertex> &combinedVertex, std::vector<GLuint> &combinedIdx) {
-    int maxIdx = 0;
-    for (Vertex V : data) {
-        combinedVertex.push_back(V);
-        combinedIdx.push_back(0 + maxIdx);
-        combinedIdx.push_back(1 + maxIdx);
-        combinedIdx.push_back(2 + maxIdx);
-        combinedIdx.push_back(0 + maxIdx);
-        combinedIdx.push_back(2 + maxIdx);
-        combinedIdx.push_back(3 + maxIdx);
-        maxIdx += 4;
-    }
-}
-
 int Chunk::getHeightAt(int x, int z){
     for (int i = 255; i>0; i--){
         if (getBlockAt(x,i,z) != EMPTY){
@@ -237,10 +555,3 @@ int Chunk::getHeightAt(int x, int z){
     return -1;
 }
 
-bool isClear(BlockType t) {
-    return clearBlocks.find(t) != clearBlocks.end();
-}
-
-bool isAnimated(BlockType t/*, Direction d*/) {
-    return animatedBocks.find(t) != animatedBocks.end();
-}
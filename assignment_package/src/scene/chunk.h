@@ -2,13 +2,68 @@
 #include "smartpointerhelp.h"
 #include "glm_includes.h"
 #include <array>
+#include <atomic>
 #include <unordered_map>
 #include <cstddef>
 #include "drawable.h"
 #include "chunkhelper.h"
+#include "chunksection.h"
+#include "facemask.h"
+#include "vertexarena.h"
 
 
 
+// How createVBOdata() turns visible block faces into quads
+enum MeshingMode : unsigned char
+{
+    MESH_PER_FACE, // One quad per visible block face
+    MESH_GREEDY    // Adjacent coplanar faces of the same BlockType merged into larger, texture-tiled quads
+};
+
+// Bit s of a section mask stands for the blocks 16 * s <= y < 16 * (s + 1)
+#define ALL_SECTIONS 0xffff
+
+// The meshes of one 16 x 16 x 16 section of a Chunk, as last sent by
+// Chunk::SendVBOdata(). Each section has its own range of the VertexArena,
+// so that an edit only remeshes and uploads the sections it touches.
+struct SectionMesh {
+    VertexArena::Handle opaque, transparent;
+    int opaqueVertices;
+    // Vertical extent of the section's quads, minY > maxY when there are none
+    int minY, maxY;
+    // The transparent mesh as last sent, kept to sort its quads again
+    std::vector<Vertex> transparentVertices;
+    // Counts the transparent meshes sent and deleted, so that a sorted
+    // copy of an older mesh can be told apart
+    int transparentVersion;
+    // The transparentVersion and camera cell the quads were last sorted for
+    int sortedVersion;
+    glm::ivec3 sortedCell;
+
+    SectionMesh();
+};
+
+class Chunk;
+
+// A Chunk's pointer to one of its neighbors. The GUI thread links and
+// unlinks neighbors while workers follow these pointers, so they are
+// atomic; the Chunk a worker reaches through one is kept alive by
+// Terrain::canEvictZone().
+class NeighborPtr {
+private:
+    std::atomic<Chunk*> m_chunk;
+
+public:
+    NeighborPtr(Chunk *c = nullptr);
+    NeighborPtr(const NeighborPtr &p);
+    NeighborPtr& operator=(const NeighborPtr &p);
+    NeighborPtr& operator=(Chunk *c);
+
+    Chunk* get() const;
+    operator Chunk*() const;
+    Chunk* operator->() const;
+};
+
 // One Chunk is a 16 x 256 x 16 section of the world,
 // containing all the Minecraft blocks in that area.
 // We divide the world into Chunks in order to make
@@ -19,47 +74,116 @@
 // TODO have Chunk inherit from Drawable
 class Chunk : public Drawable {
 private:
-    // All of the blocks contained within this Chunk
-    std::array<BlockType, 65536> m_blocks;
+    // All of the blocks contained within this Chunk, as sixteen
+    // 16 x 16 x 16 sections stacked from y = 0 upwards
+    std::array<ChunkSection, 16> m_sections;
 
     // This Chunk's four neighbors to the north, south, east, and west
     // The third input to this map just lets us use a Direction as
     // a key for this map.
     // These allow us to properly determine
 
-    void appendVBOData(std::vector<GLuint> &idx, std::vector<Vertex> &data, const BlockFace &f, BlockType t, glm::ivec3 xyz, float world_x, float world_z/*, int &maxIdx*/);
+    // Bytes of vertex data last sent by SendVBOdata()
+    size_t m_gpuBytes;
+
+    void appendVBOData(std::vector<Vertex> &data, const BlockFace &f, BlockType t, glm::ivec3 xyz);
+    // Move the finished mesh of section s into VBOdata along with its vertical extent
+    void setVBOdata(int s, std::vector<Vertex> &opaqueData, std::vector<Vertex> &clearData);
     void bufferInterleavedData(std::vector<GLuint> &idx, std::vector<Vertex> &data, unsigned int max);
-    void combineVBO(std::vector<Vertex> &data, std::vector<Vertex> &combinedVertex, std::vector<GLuint> &combinedIdx);
+    // Humidity used to tint the top of the grass block at local (x, z)
+    float grassHumidity(int x, int z);
+
+    // The MESH_GREEDY version of createVBOdata()
+    void createVBOdataGreedy();
+    // Merge the visible faces of one direction in a section into quads, one slice at a time
+    void appendGreedyFaces(const std::vector<BlockType> &blocks, const FaceMask &faces, const BlockFace &f, int section,
+                           std::vector<Vertex> &opaqueData, std::vector<Vertex> &clearData);
+    // Unpack the sections to mesh and the ones above and below them, whose
+    // blocks hide faces, and find the visible faces of the sections to mesh
+    void prepareMeshing(std::vector<BlockType> &blocks, FaceMask &faces);
 
 public:
-    std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
-    struct {             // Structure declaration
-      std::vector<Vertex> combinedVertexOpaque;         // Member (int variable)
-      std::vector<GLuint> combinedIdxOpaque;   // Member (string variable)
-      std::vector<Vertex> combinedVertexTransparrent;         // Member (int variable)
-      std::vector<GLuint> combinedIdxTransparrent;   // Member (string variable)
-    } VBOdata;       // Structure variable
+    // Holds all six Directions, so that looking one up never inserts
+    // into the map while another thread reads it
+    std::unordered_map<Direction, NeighborPtr, EnumHash> m_neighbors;
+    struct {
+      // The sections createVBOdata() meshes, set before it runs
+      uint16_t sections;
+      // Indexed by section, only the meshed sections are filled in
+      std::array<std::vector<Vertex>, 16> opaque;
+      std::array<std::vector<Vertex>, 16> transparent;
+      std::array<int, 16> minY, maxY;   // Lowest and highest vertex, minY > maxY when there are none
+    } VBOdata;
+
+    // Vertical extent of all the section meshes last sent by SendVBOdata(),
+    // which bounds the Chunk for frustum culling
+    int meshMinY, meshMaxY;
 
     int minX;
     int minZ;
-    float humidity;
-    void SendVBOdata();
-    void deleteVBOdata();
+    // Written while the Chunk is generated, which may be while a
+    // neighbor's VBOWorker reads it
+    std::atomic<float> humidity;
+    // Where SendVBOdata() put the meshes of each section
+    std::array<SectionMesh, 16> sectionMeshes;
+    // Copy the meshes of the sections in VBOdata into the arena,
+    // replacing those sections' previous meshes
+    void SendVBOdata(VertexArena &arena);
+    void deleteVBOdata(VertexArena &arena);
     Biome biome;
 
     int getHeightAt(int x, int z);
     Chunk(OpenGLContext*, int minX, int minZ);
     Chunk(OpenGLContext* mp_context, int minX, int minZ, GenState genState);
     virtual ~Chunk(){}
-    GenState genState;
-    VBOState VBOState;
-    bool VBOdirty;
+    // Only the GUI thread changes the states, but workers and the
+    // region file thread may look at them
+    std::atomic<GenState> genState;
+    std::atomic<VBOState> VBOState;
+    // Set before the Chunk is handed to a VBOWorker
+    MeshingMode meshingMode;
+    // Set when any section needs to be meshed again. Population workers
+    // mark the neighbors they write into, so these are atomic.
+    std::atomic<bool> VBOdirty;
+    // The sections whose faces changed since they were handed to a VBOWorker
+    std::atomic<uint16_t> dirtySections;
+    // Remesh the given sections the next time the Chunk is meshed
+    void markDirty(uint16_t sections = ALL_SECTIONS);
+    // The sections whose faces a block at height y shows or hides: its own,
+    // and the one above or below when the block is on the section's edge
+    static uint16_t sectionsAround(int y);
+    // The sections that hold anything but EMPTY blocks, and so have faces
+    uint16_t nonEmptySections() const;
     bool VBOready;
+    // True when the blocks differ from what is stored in the region file
+    std::atomic<bool> saveDirty;
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
+    // Replace every block at once from an array laid out as x + 16 * y + 256 * 16 * z.
+    // Much cheaper than 65536 calls to setBlockAt since each section is packed only once.
+    void setBlocks(const BlockType *blocks);
+    // Copy every block out into the same layout setBlocks() takes
+    void getBlocks(BlockType *blocks) const;
+    // Copy only the blocks of the given sections, leaving the rest of blocks as it was
+    void getBlocks(BlockType *blocks, uint16_t sections) const;
+    // Bytes of block storage held by this Chunk
+    size_t blockMemoryUsage() const;
+    // Bytes of vertex data this Chunk holds on the GPU
+    size_t gpuMemoryUsage() const;
+    // Bytes of the copy of its transparent meshes kept on the CPU for sorting
+    size_t meshMemoryUsage() const;
     void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // Clear the pointers that this Chunk's neighbors hold to it, so that
+    // it can be deleted. The neighbors are marked for remeshing since their
+    // border faces are no longer hidden.
+    void unlinkNeighbors();
     void createVBOdata() override;
+    // The original mesher, which looks up both blocks of every face one by one.
+    // Always meshes one quad per face; kept to check createVBOdata() against.
+    void createVBOdataReference();
+    // Vertices meshed into VBOdata by the last createVBOdata()
+    size_t meshedVertexCount() const;
     void setminX(int);
     void setminZ(int);
     void setHumidity(float);
@@ -2,6 +2,7 @@
 #include "chunk.h"
 #include <array>
 #include <unordered_set>
+#include <cstdint>
 
 //using namespace std;
 
@@ -9,17 +10,51 @@
 // of memory to store our different block types. By default, the size of a C++ enum
 // is that of an int (so, usually four bytes). This *does* limit us to only 256 different
 // block types, but in the scope of this project we'll never get anywhere near that many.
-#define BLK_UVX * 0.0625f
-#define BLK_UVY * 0.0625f
 #define BLK_UV 0.0625f
+
+// Block property flags, see BLOCK_LIST
+#define BLOCK_CLEAR    1  // Faces of the blocks behind it are drawn
+#define BLOCK_ANIMATED 2  // Waves in the vertex shader and scrolls its texture
+#define BLOCK_SOLID    4  // Takes up its cell: rays stop at it and nothing is placed or grown into it
+#define BLOCK_COLLIDES 8  // Stops the player and creepers from moving through it
+#define BLOCK_LIQUID   16 // Entities inside it swim
+
+// Every BlockType and its properties, one line per block. Region files
+// store BlockType values, so new blocks go at the end of the list.
+// The tiles are the (column, row) of the block's texture in the atlas
+// for its four sides, its top and its bottom, and light is the light
+// level the block emits.
+//  X(name,       side,    top,     bottom,  flags,                                                light)
+#define BLOCK_LIST(X) \
+    X(EMPTY,      0, 0,    0, 0,    0, 0,    BLOCK_CLEAR,                                          0) \
+    X(GRASS,      3, 15,   8, 13,   2, 15,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(DIRT,       2, 15,   2, 15,   2, 15,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(STONE,      1, 15,   1, 15,   1, 15,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(WATER,      13, 3,   13, 3,   13, 3,   BLOCK_CLEAR | BLOCK_ANIMATED | BLOCK_SOLID | BLOCK_LIQUID, 0) \
+    X(SNOW,       4, 11,   2, 11,   2, 15,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(LAVA,       13, 1,   13, 1,   13, 1,   BLOCK_CLEAR | BLOCK_ANIMATED | BLOCK_SOLID | BLOCK_LIQUID, 15) \
+    X(BEDROCK,    1, 14,   1, 14,   1, 14,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(OAK_LOG,    4, 14,   5, 14,   5, 14,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(OAK_LEAVES, 5, 12,   5, 12,   5, 12,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(SAND,       2, 14,   2, 14,   2, 14,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(SANDSTONE,  0, 3,    0, 4,    0, 2,    BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(CACTUS,     6, 11,   5, 11,   7, 11,   BLOCK_SOLID | BLOCK_COLLIDES,                         0) \
+    X(ICE,        3, 11,   3, 11,   3, 11,   BLOCK_CLEAR | BLOCK_SOLID | BLOCK_COLLIDES,           0)
+
 enum BlockType : unsigned char
 {
-    EMPTY, GRASS, DIRT, STONE, WATER, SNOW, LAVA, BEDROCK, OAK_LOG, OAK_LEAVES, SAND, SANDSTONE, CACTUS, ICE
+#define X(name, ...) name,
+    BLOCK_LIST(X)
+#undef X
 };
 
+#define X(...) + 1
+constexpr int BLOCK_TYPE_COUNT = 0 BLOCK_LIST(X);
+#undef X
+
 enum GenState : unsigned char
 {
-    UNGENERATED, TERRAIN_RUNNING, TERRAIN_DONE, POPULATION_RUNNING, GEN_COMPLETE
+    UNGENERATED, LOAD_RUNNING, TERRAIN_RUNNING, TERRAIN_DONE, POPULATION_RUNNING, GEN_COMPLETE
 };
 
 enum VBOState : unsigned char
@@ -65,14 +100,27 @@ struct BlockFace {
     {}
 };
 
+// One terrain vertex packed into 8 bytes, decoded in lambert.vert.glsl.
+// The position is local to the Chunk, whose origin the VertexArena page holds.
+//   a: x (5 bits) | y (9) | z (5) | normal Direction (3) | flags (2) | humidity (8)
+//   b: atlas tile column (4) | tile row (4) | corner u (1) | corner v (1)
+// flags: 1 = animated, 2 = texture tiled across a greedy quad
 struct Vertex {
-    glm::vec4 pos;
-    glm::vec4 nor;
-    glm::vec4 uv;
-
-    Vertex(glm::vec4 p, glm::vec4 n, glm::vec4 u)
-        :   pos(p), nor(n), uv(u)
+    uint32_t a;
+    uint32_t b;
+
+    // tile is the corner of the block's tile in the atlas, as stored in blockUVs,
+    // and corner is the offset into the tile, either 0 or BLK_UV on each axis
+    Vertex(glm::ivec3 pos, Direction nor, glm::vec2 tile, glm::vec2 corner, float humidity, unsigned int flags)
+        :   a(uint32_t(pos.x) | uint32_t(pos.y) << 5 | uint32_t(pos.z) << 14 | uint32_t(nor) << 19 | (flags & 3u) << 22
+              | uint32_t(glm::clamp(humidity, 0.f, 1.f) * 255.f + 0.5f) << 24),
+            b(uint32_t(tile.x / BLK_UV + 0.5f) | uint32_t(tile.y / BLK_UV + 0.5f) << 4
+              | uint32_t(corner.x > 0) << 8 | uint32_t(corner.y > 0) << 9)
     {}
+
+    glm::ivec3 position() const {
+        return glm::ivec3(a & 31u, (a >> 5) & 511u, (a >> 14) & 31u);
+    }
 };
 
 const static std::array<BlockFace, 6> adjacentFaces {
@@ -108,88 +156,51 @@ const static std::array<BlockFace, 6> adjacentFaces {
 
 };
 
-const static std::unordered_map<BlockType, std::unordered_map<Direction, glm::vec2, EnumHash>, EnumHash> blockUVs
-{
-    {DIRT, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {XPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {ZNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {ZPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {YNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {YPOS, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)}}},
-    {STONE, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {XPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {ZNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {ZPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {YNEG, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {YPOS, glm::vec2(1.f BLK_UVX, 15.f BLK_UVY)}}},
-    {SNOW, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(4.f BLK_UVX, 11.f BLK_UVY)},
-                                                               {XPOS, glm::vec2(4.f BLK_UVX, 11.f BLK_UVY)},
-                                                               {ZNEG, glm::vec2(4.f BLK_UVX, 11.f BLK_UVY)},
-                                                               {ZPOS, glm::vec2(4.f BLK_UVX, 11.f BLK_UVY)},
-                                                               {YNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                               {YPOS, glm::vec2(2.f BLK_UVX, 11.f BLK_UVY)}}},
-    {WATER, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)},
-                                                                {XPOS, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)},
-                                                                {ZNEG, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)},
-                                                                {ZPOS, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)},
-                                                                {YNEG, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)},
-                                                                {YPOS, glm::vec2(13.f BLK_UVX, 3.f BLK_UVY)}}},
-    {GRASS, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {XPOS, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {ZNEG, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {ZPOS, glm::vec2(3.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {YNEG, glm::vec2(2.f BLK_UVX, 15.f BLK_UVY)},
-                                                                {YPOS, glm::vec2(8.f BLK_UVX, 13.f BLK_UVY)}}},
-    {LAVA, std::unordered_map<Direction, glm::vec2, EnumHash>  {{XNEG, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)},
-                                                                {XPOS, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)},
-                                                                {ZNEG, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)},
-                                                                {ZPOS, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)},
-                                                                {YNEG, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)},
-                                                                {YPOS, glm::vec2(13.f BLK_UVX, 1.f BLK_UVY)}}},
-    {BEDROCK, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(1.f BLK_UVX, 14.f BLK_UVY)}}},
-    {OAK_LOG, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(4.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(4.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(4.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(4.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(5.f BLK_UVX, 14.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(5.f BLK_UVX, 14.f BLK_UVY)}}},
-    {OAK_LEAVES, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(5.f BLK_UVX, 12.f BLK_UVY)}}},
-    {SAND, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-                                                              {XPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-                                                              {ZNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-                                                              {ZPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-                                                              {YNEG, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)},
-                                                              {YPOS, glm::vec2(2.f BLK_UVX, 14.f BLK_UVY)}}},
-    {SANDSTONE, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(0.f BLK_UVX, 3.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(0.f BLK_UVX, 3.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(0.f BLK_UVX, 3.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(0.f BLK_UVX, 3.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(0.f BLK_UVX, 2.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(0.f BLK_UVX, 4.f BLK_UVY)}}},
-    {CACTUS, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(6.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(7.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(5.f BLK_UVX, 11.f BLK_UVY)}}},
-    {ICE, std::unordered_map<Direction, glm::vec2, EnumHash> {{XNEG, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {XPOS, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {ZNEG, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {ZPOS, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {YNEG, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)},
-                                                                  {YPOS, glm::vec2(3.f BLK_UVX, 11.f BLK_UVY)}}}
+// The properties of one BlockType, from BLOCK_LIST
+struct BlockInfo {
+    unsigned char tiles[6][2]; // Atlas (column, row) of each face, indexed by Direction
+    unsigned char flags;
+    unsigned char light;
 };
 
+// Indexed by BlockType. Every value a BlockType can hold has an entry,
+// so lookups need no bounds check; unused ones have no properties.
+#define X(name, sideX, sideY, topX, topY, bottomX, bottomY, flags, light) \
+    {{{sideX, sideY}, {sideX, sideY}, {topX, topY}, {bottomX, bottomY}, {sideX, sideY}, {sideX, sideY}}, flags, light},
+constexpr BlockInfo blockInfo[256] = {
+    BLOCK_LIST(X)
+};
+#undef X
+
+constexpr bool isClear(BlockType t) {
+    return blockInfo[t].flags & BLOCK_CLEAR;
+}
+
+constexpr bool isAnimated(BlockType t) {
+    return blockInfo[t].flags & BLOCK_ANIMATED;
+}
+
+constexpr bool isSolid(BlockType t) {
+    return blockInfo[t].flags & BLOCK_SOLID;
+}
+
+constexpr bool hasCollision(BlockType t) {
+    return blockInfo[t].flags & BLOCK_COLLIDES;
+}
+
+constexpr bool isLiquid(BlockType t) {
+    return blockInfo[t].flags & BLOCK_LIQUID;
+}
+
+constexpr unsigned char lightEmission(BlockType t) {
+    return blockInfo[t].light;
+}
+
+// Corner of the texture of face d of BlockType t in the atlas
+inline glm::vec2 blockUV(BlockType t, Direction d) {
+    return glm::vec2(blockInfo[t].tiles[d][0], blockInfo[t].tiles[d][1]) * BLK_UV;
+}
+
 const static std::unordered_map<BlockType, glm::vec3, EnumHash> blockColor {
     {GRASS, glm::vec3(95.f, 159.f, 53.f) / 255.f},
     {DIRT, glm::vec3(121.f, 85.f, 58.f) / 255.f},
@@ -200,16 +211,4 @@ const static std::unordered_map<BlockType, glm::vec3, EnumHash> blockColor {
     {BEDROCK, glm::vec3(0.f, 0.f, 0.f)}
 };
 
-const static std::unordered_set<BlockType, EnumHash> clearBlocks
-{
-    EMPTY, WATER, LAVA, ICE
-};
-
-const static std::unordered_set<BlockType, EnumHash> animatedBocks
-{
-    WATER, LAVA
-};
-
 bool crossBorder(glm::ivec3 p1, glm::ivec3 p2);
-bool isClear(BlockType);
-bool isAnimated(BlockType);
@@ -0,0 +1,25 @@
+#include "chunkpriority.h"
+// Chunks this close to the player are needed wherever the camera looks
+#define NEAR_DISTANCE 24.f
+
+ChunkPriority::ChunkPriority()
+    : m_position(0.f), m_forward(0.f)
+{}
+
+void ChunkPriority::update(glm::vec3 playerPos, glm::vec3 viewDir) {
+    m_position = glm::vec2(playerPos.x, playerPos.z);
+    glm::vec2 forward(viewDir.x, viewDir.z);
+    float length = glm::length(forward);
+    m_forward = length > 1e-4f ? forward / length : glm::vec2(0.f);
+}
+
+float ChunkPriority::priority(int minX, int minZ, int size) const {
+    glm::vec2 toCenter = glm::vec2(minX, minZ) + size * 0.5f - m_position;
+    float dist = glm::length(toCenter);
+    if (dist < NEAR_DISTANCE) {
+        return dist;
+    }
+    // Distance counts once straight ahead, 1.5 times to the side and twice behind
+    float facing = glm::dot(toCenter / dist, m_forward);
+    return dist * (1.5f - 0.5f * facing);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "glm_includes.h"
+
+// Orders Chunk work by how soon the player is likely to see the Chunk:
+// nearer Chunks first, and at the same distance the ones in front of the
+// camera before the ones behind it. The Terrain updates it every tick,
+// so work that is still queued is reordered as the player moves and turns.
+class ChunkPriority {
+private:
+    glm::vec2 m_position;
+    // The camera's forward vector in the x-z plane,
+    // zero when looking straight up or down
+    glm::vec2 m_forward;
+
+public:
+    ChunkPriority();
+
+    void update(glm::vec3 playerPos, glm::vec3 viewDir);
+
+    // Priority of the size x size area with lower-left corner (minX, minZ).
+    // Lower values are scheduled first.
+    float priority(int minX, int minZ, int size = 16) const;
+};
@@ -0,0 +1,279 @@
+#include "chunk.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#define SECTION_BLOCKS 4096
+
+QMutex ChunkSection::s_retiredLock;
+std::vector<ChunkSection::Retired> ChunkSection::s_retired;
+std::atomic<size_t> ChunkSection::s_retiredBytes(0);
+std::atomic<uint32_t> ChunkSection::s_epoch(0);
+std::atomic<int> ChunkSection::s_readers[2] = {{0}, {0}};
+
+ChunkSection::Storage::Storage(unsigned char bits)
+    : bits(bits), paletteSize(0), palette(new std::atomic<BlockType>[1u << bits]),
+      words(new std::atomic<uint64_t>[SECTION_BLOCKS * bits / 64])
+{
+    for (unsigned int p = 0; p < (1u << bits); p++) {
+        palette[p].store(EMPTY, std::memory_order_relaxed);
+    }
+    for (unsigned int w = 0; w < SECTION_BLOCKS * bits / 64u; w++) {
+        words[w].store(0, std::memory_order_relaxed);
+    }
+}
+
+unsigned int ChunkSection::Storage::getIndex(unsigned int i) const {
+    unsigned int bit = i * bits;
+    return (words[bit >> 6].load(std::memory_order_relaxed) >> (bit & 63)) & ((1u << bits) - 1);
+}
+
+// Only writers call this, one at a time, so the load and store need not be one atomic step
+void ChunkSection::Storage::setIndex(unsigned int i, unsigned int paletteIdx) {
+    unsigned int bit = i * bits;
+    uint64_t mask = uint64_t((1u << bits) - 1) << (bit & 63);
+    std::atomic<uint64_t> &w = words[bit >> 6];
+    uint64_t old = w.load(std::memory_order_relaxed);
+    w.store((old & ~mask) | ((uint64_t(paletteIdx) << (bit & 63)) & mask), std::memory_order_relaxed);
+}
+
+BlockType ChunkSection::Storage::getBlockAt(unsigned int i) const {
+    return palette[getIndex(i)].load(std::memory_order_relaxed);
+}
+
+size_t ChunkSection::Storage::memoryUsage() const {
+    return sizeof(Storage) + (size_t(1) << bits) * sizeof(BlockType) + SECTION_BLOCKS * bits / 64 * sizeof(uint64_t);
+}
+
+ChunkSection::ChunkSection()
+    : m_sequence(0), m_uniform(EMPTY), m_storage(nullptr)
+{}
+
+ChunkSection::~ChunkSection() {
+    delete m_storage.load();
+}
+
+void ChunkSection::beginWrite() const {
+    uint32_t seq = m_sequence.load(std::memory_order_relaxed);
+    while ((seq & 1) != 0 || !m_sequence.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                                                 std::memory_order_relaxed)) {
+        if ((seq & 1) != 0) {
+            std::this_thread::yield();
+            seq = m_sequence.load(std::memory_order_relaxed);
+        }
+    }
+    // Keeps the writes that follow from becoming visible before the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void ChunkSection::endWrite() const {
+    m_sequence.fetch_add(1, std::memory_order_release);
+}
+
+uint32_t ChunkSection::beginRead() const {
+    uint32_t seq = m_sequence.load(std::memory_order_acquire);
+    while ((seq & 1) != 0) {
+        std::this_thread::yield();
+        seq = m_sequence.load(std::memory_order_acquire);
+    }
+    return seq;
+}
+
+bool ChunkSection::endRead(uint32_t seq) const {
+    // Keeps the reads before it from moving past the second load of the sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return m_sequence.load(std::memory_order_relaxed) == seq;
+}
+
+BlockType ChunkSection::getBlockAt(unsigned int i) const {
+    for (;;) {
+        uint32_t seq = beginRead();
+        const Storage *s = m_storage.load(std::memory_order_acquire);
+        BlockType t = (s == nullptr) ? m_uniform.load(std::memory_order_relaxed) : s->getBlockAt(i);
+        if (endRead(seq)) {
+            return t;
+        }
+    }
+}
+
+int ChunkSection::findInPalette(const Storage *s, BlockType t) const {
+    for (unsigned int p = 0; p < s->paletteSize; p++) {
+        if (s->palette[p].load(std::memory_order_relaxed) == t) {
+            return static_cast<int>(p);
+        }
+    }
+    return -1;
+}
+
+void ChunkSection::retire(Storage *s) {
+    // s was unpublished before this, so a reader that can still hold it
+    // entered its ReadGuard in this epoch or an earlier one
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t epoch = s_epoch.load(std::memory_order_seq_cst);
+    s_retiredBytes.fetch_add(s->memoryUsage(), std::memory_order_relaxed);
+    QMutexLocker locker(&s_retiredLock);
+    s_retired.push_back({epoch, uPtr<Storage>(s)});
+}
+
+ChunkSection::ReadGuard::ReadGuard() {
+    // Retry if the epoch moved on before this reader was counted in it,
+    // so that reclaimRetired() cannot miss it
+    for (;;) {
+        uint32_t epoch = s_epoch.load(std::memory_order_seq_cst);
+        m_counter = epoch & 1;
+        s_readers[m_counter].fetch_add(1, std::memory_order_seq_cst);
+        if (s_epoch.load(std::memory_order_seq_cst) == epoch) {
+            return;
+        }
+        s_readers[m_counter].fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+ChunkSection::ReadGuard::~ReadGuard() {
+    s_readers[m_counter].fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void ChunkSection::reclaimRetired() {
+    // Readers of the epochs before the last one have all left when the
+    // epoch moved on to this one. Once the last epoch's have too, nothing
+    // retired up to then can still be read.
+    uint32_t epoch = s_epoch.load(std::memory_order_seq_cst);
+    if (s_readers[(epoch - 1) & 1].load(std::memory_order_seq_cst) != 0) {
+        return;
+    }
+    std::vector<Retired> freed;
+    {
+        QMutexLocker locker(&s_retiredLock);
+        auto kept = std::partition(s_retired.begin(), s_retired.end(), [epoch](const Retired &r) {
+            return r.epoch == epoch;
+        });
+        std::move(kept, s_retired.end(), std::back_inserter(freed));
+        s_retired.erase(kept, s_retired.end());
+    }
+    for (const Retired &r : freed) {
+        s_retiredBytes.fetch_sub(r.storage->memoryUsage(), std::memory_order_relaxed);
+    }
+    s_epoch.store(epoch + 1, std::memory_order_seq_cst);
+}
+
+size_t ChunkSection::retiredMemoryUsage() {
+    return s_retiredBytes.load(std::memory_order_relaxed);
+}
+
+ChunkSection::Storage* ChunkSection::grow(Storage *s, unsigned char bits) {
+    Storage *wider = new Storage(bits);
+    if (s == nullptr) {
+        // Every index is 0, which is the old uniform value
+        wider->palette[0].store(m_uniform.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        wider->paletteSize = 1;
+    } else {
+        for (unsigned int p = 0; p < s->paletteSize; p++) {
+            wider->palette[p].store(s->palette[p].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        wider->paletteSize = s->paletteSize;
+        for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+            wider->setIndex(i, s->getIndex(i));
+        }
+        retire(s);
+    }
+    m_storage.store(wider, std::memory_order_release);
+    return wider;
+}
+
+void ChunkSection::setBlockAt(unsigned int i, BlockType t) {
+    beginWrite();
+    Storage *s = m_storage.load(std::memory_order_relaxed);
+    if (s == nullptr && t == m_uniform.load(std::memory_order_relaxed)) {
+        endWrite();
+        return;
+    }
+    int p = (s == nullptr) ? -1 : findInPalette(s, t);
+    if (p == -1) {
+        if (s == nullptr) {
+            s = grow(nullptr, 1);
+        } else if (s->paletteSize == (1u << s->bits)) {
+            s = grow(s, s->bits * 2);
+        }
+        p = static_cast<int>(s->paletteSize++);
+        s->palette[p].store(t, std::memory_order_relaxed);
+    }
+    s->setIndex(i, static_cast<unsigned int>(p));
+    endWrite();
+}
+
+void ChunkSection::load(const BlockType *blocks) {
+    std::vector<BlockType> palette;
+    for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+        if (std::find(palette.begin(), palette.end(), blocks[i]) == palette.end()) {
+            palette.push_back(blocks[i]);
+        }
+    }
+
+    // Built before taking the lock, so readers only wait for the swap
+    Storage *s = nullptr;
+    if (palette.size() > 1) {
+        unsigned char bits = 1;
+        while ((1u << bits) < palette.size()) {
+            bits *= 2;
+        }
+        s = new Storage(bits);
+        for (size_t p = 0; p < palette.size(); p++) {
+            s->palette[p].store(palette[p], std::memory_order_relaxed);
+        }
+        s->paletteSize = static_cast<unsigned int>(palette.size());
+        for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+            s->setIndex(i, static_cast<unsigned int>(findInPalette(s, blocks[i])));
+        }
+    }
+
+    beginWrite();
+    Storage *old = m_storage.load(std::memory_order_relaxed);
+    if (s == nullptr) {
+        m_uniform.store(palette[0], std::memory_order_relaxed);
+    }
+    m_storage.store(s, std::memory_order_release);
+    if (old != nullptr) {
+        retire(old);
+    }
+    endWrite();
+}
+
+void ChunkSection::unpack(BlockType *out) const {
+    for (;;) {
+        uint32_t seq = beginRead();
+        const Storage *s = m_storage.load(std::memory_order_acquire);
+        if (s == nullptr) {
+            std::fill_n(out, SECTION_BLOCKS, m_uniform.load(std::memory_order_relaxed));
+        } else {
+            for (unsigned int i = 0; i < SECTION_BLOCKS; i++) {
+                out[i] = s->getBlockAt(i);
+            }
+        }
+        if (endRead(seq)) {
+            return;
+        }
+    }
+}
+
+bool ChunkSection::isEmpty() const {
+    for (;;) {
+        uint32_t seq = beginRead();
+        bool empty = m_storage.load(std::memory_order_acquire) == nullptr
+                && m_uniform.load(std::memory_order_relaxed) == EMPTY;
+        if (endRead(seq)) {
+            return empty;
+        }
+    }
+}
+
+size_t ChunkSection::memoryUsage() const {
+    for (;;) {
+        uint32_t seq = beginRead();
+        const Storage *s = m_storage.load(std::memory_order_acquire);
+        size_t total = sizeof(ChunkSection) + (s != nullptr ? s->memoryUsage() : 0);
+        if (endRead(seq)) {
+            return total;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <QMutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Only include this through chunk.h, which defines BlockType first.
+
+// One ChunkSection is a 16 x 16 x 16 slice of a Chunk.
+// Instead of storing one BlockType per block, a section keeps a
+// small palette of the BlockTypes it contains and a bit-packed
+// array of indices into that palette. Sections that contain a single
+// BlockType (e.g. all air above the terrain, or solid stone) store
+// only that one value and allocate nothing.
+//
+// Meshing workers read sections while the GUI thread edits them and
+// population workers write trees into them. Each section is guarded by a
+// sequence lock: writers take it one at a time and make the sequence odd
+// while they write, and readers retry until they read the same even
+// sequence before and after copying the blocks. Readers never block a
+// writer, and every block a reader returns comes from one consistent
+// version of the section. All the block data is held in relaxed atomics
+// so that a read racing a write is well defined, just thrown away.
+class ChunkSection {
+private:
+    // The palette and packed indices of a section with more than one BlockType.
+    // Indices are 1, 2, 4 or 8 bits wide so that none straddles a 64-bit word.
+    struct Storage {
+        unsigned char bits;
+        // Entries in use, only read and written under the write lock
+        unsigned int paletteSize;
+        // 1 << bits entries, so that every index a reader decodes, even
+        // from a torn read, is in bounds
+        std::unique_ptr<std::atomic<BlockType>[]> palette;
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+
+        Storage(unsigned char bits);
+        unsigned int getIndex(unsigned int i) const;
+        void setIndex(unsigned int i, unsigned int paletteIdx);
+        BlockType getBlockAt(unsigned int i) const;
+        size_t memoryUsage() const;
+    };
+
+    // Odd while a writer holds the section
+    mutable std::atomic<uint32_t> m_sequence;
+    // The value of every block when m_storage is null
+    std::atomic<BlockType> m_uniform;
+    // A new Storage is always fully built before it is published here
+    std::atomic<Storage*> m_storage;
+
+    // Storage replaced by a wider one or by load(), of every section, with
+    // the epoch it was replaced in. A reader on another thread may still be
+    // reading it, so it is freed by reclaimRetired() once every ReadGuard
+    // that was entered by then has been left.
+    struct Retired {
+        uint32_t epoch;
+        uPtr<Storage> storage;
+    };
+    static QMutex s_retiredLock;
+    static std::vector<Retired> s_retired;
+    static std::atomic<size_t> s_retiredBytes;
+    // Readers enter the counter of the epoch they start in
+    static std::atomic<uint32_t> s_epoch;
+    static std::atomic<int> s_readers[2];
+
+    // Spins until no other writer holds the section, then makes the sequence odd
+    void beginWrite() const;
+    // Makes the sequence even again, publishing the writes
+    void endWrite() const;
+    // Waits out a writer and returns the even sequence the read starts at
+    uint32_t beginRead() const;
+    // True when no writer ran since beginRead() returned seq
+    bool endRead(uint32_t seq) const;
+
+    int findInPalette(const Storage *s, BlockType t) const;
+    // Keep s for readers that may still hold it, until reclaimRetired()
+    static void retire(Storage *s);
+    // Copy s into a new Storage with indices of the given width and publish it
+    Storage* grow(Storage *s, unsigned char bits);
+
+public:
+    ChunkSection();
+    ~ChunkSection();
+    ChunkSection(const ChunkSection&) = delete;
+    ChunkSection& operator=(const ChunkSection&) = delete;
+
+    // i = x + 16 * y + 256 * z, all local to the section
+    BlockType getBlockAt(unsigned int i) const;
+    void setBlockAt(unsigned int i, BlockType t);
+
+    // Replace the whole section with the 4096 given blocks, which use the
+    // same x + 16 * y + 256 * z layout. Picks the narrowest palette that fits.
+    void load(const BlockType *blocks);
+    // Expand the section into 4096 blocks
+    void unpack(BlockType *out) const;
+
+    // True when the section is uniformly EMPTY. A section with storage
+    // counts as not empty even if its blocks were all dug out.
+    bool isEmpty() const;
+
+    // Heap and inline bytes used by this section, not counting retired
+    // storage. Reads like getBlockAt() and never holds up readers.
+    size_t memoryUsage() const;
+
+    // Held by threads other than the one calling reclaimRetired() for as
+    // long as they read sections, such as a worker for its whole job
+    class ReadGuard {
+    private:
+        int m_counter;
+    public:
+        ReadGuard();
+        ~ReadGuard();
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
+    // Frees the storage retired before the oldest ReadGuard still held was
+    // entered. Called once per generation tick from the thread that
+    // edits the Terrain, which reads sections without a ReadGuard.
+    static void reclaimRetired();
+    // Bytes of retired storage not yet freed
+    static size_t retiredMemoryUsage();
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// A bounded queue that any number of worker threads push into and one
+// thread, the GUI thread, pops from, without taking a lock. Workers hand
+// finished Chunks back through it, so a worker finishing never waits on
+// the GUI thread draining its results, nor the other way around.
+//
+// Each slot has a sequence number that says whether it is free to push
+// into or holds an item ready to pop. Producers only contend with each
+// other, on a compare-and-swap claiming the next position; the consumer
+// owns its position outright. A push into a full queue yields until the
+// consumer makes room, so give the queue room for every job that can be
+// in flight and a push never waits.
+template <typename T>
+class CompletionQueue {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    // On separate cache lines, so that producers claiming positions do
+    // not keep taking the consumer's line away from it
+    alignas(64) std::atomic<size_t> m_pushPos;
+    alignas(64) size_t m_popPos;
+
+public:
+    // Holds at least capacity items, rounded up to a power of two
+    explicit CompletionQueue(size_t capacity);
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    // From any thread. Returns false instead of waiting when the queue is full.
+    bool tryPush(T item);
+    // From any thread. Waits for the consumer when the queue is full.
+    void push(T item);
+
+    // Only from the consumer thread. Returns false when the queue is empty.
+    bool pop(T &out);
+    // Only from the consumer thread. Appends every item pushed so far to
+    // out and returns how many there were.
+    size_t popAll(std::vector<T> &out);
+
+    size_t capacity() const;
+};
+
+template <typename T>
+CompletionQueue<T>::CompletionQueue(size_t capacity)
+    : m_slots(), m_mask(0), m_pushPos(0), m_popPos(0)
+{
+    size_t slotCount = 2;
+    while (slotCount < capacity) {
+        slotCount *= 2;
+    }
+    m_slots.reset(new Slot[slotCount]);
+    m_mask = slotCount - 1;
+    for (size_t i = 0; i < slotCount; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool CompletionQueue<T>::tryPush(T item) {
+    size_t pos = m_pushPos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot &slot = m_slots[pos & m_mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (lag == 0) {
+            // The slot is free; claim its position
+            if (m_pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.item = std::move(item);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (lag < 0) {
+            // The slot still holds the item pushed one lap ago
+            return false;
+        } else {
+            // Another producer claimed the position first
+            pos = m_pushPos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+void CompletionQueue<T>::push(T item) {
+    while (!tryPush(item)) {
+        std::this_thread::yield();
+    }
+}
+
+template <typename T>
+bool CompletionQueue<T>::pop(T &out) {
+    Slot &slot = m_slots[m_popPos & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != m_popPos + 1) {
+        return false;
+    }
+    out = std::move(slot.item);
+    // Free for the push one lap later
+    slot.sequence.store(m_popPos + m_mask + 1, std::memory_order_release);
+    m_popPos++;
+    return true;
+}
+
+template <typename T>
+size_t CompletionQueue<T>::popAll(std::vector<T> &out) {
+    size_t count = 0;
+    T item;
+    while (pop(item)) {
+        out.push_back(std::move(item));
+        count++;
+    }
+    return count;
+}
+
+template <typename T>
+size_t CompletionQueue<T>::capacity() const {
+    return m_mask + 1;
+}
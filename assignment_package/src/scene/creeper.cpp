@@ -301,7 +301,7 @@ void Creeper::updateLiquid(const Terrain &terrain) {
     for (glm::vec3 &pos : rayOrigins) {
         try {
             BlockType type = terrain.getBlockAt(glm::floor(pos[0]), glm::floor(pos[1]), glm::floor(pos[2]));
-            if (type == LAVA || type == WATER) {
+            if (isLiquid(type)) {
                 m_inLiquid = true;
                 return;
             }
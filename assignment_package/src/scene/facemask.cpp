@@ -0,0 +1,156 @@
+#include "facemask.h"
+#include "chunk.h"
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// The padded opacity and occupancy rows are 18 x 258: one extra row of x
+// on each side for the neighboring Chunks, and one extra row of y above
+// and below the Chunk
+#define PAD_X 18
+#define PAD_Y 258
+
+namespace {
+
+// Every ISA below provides the same operations on a group of rows,
+// so the kernel is written once
+#if defined(__AVX2__)
+struct Rows {
+    __m256i v;
+    static const int count = 16;
+    static Rows load(const uint16_t *p) { return {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))}; }
+    static Rows fill(uint16_t x) { return {_mm256_set1_epi16(static_cast<short>(x))}; }
+    void store(uint16_t *p) const { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    Rows operator&(Rows o) const { return {_mm256_and_si256(v, o.v)}; }
+    Rows operator|(Rows o) const { return {_mm256_or_si256(v, o.v)}; }
+    // ~this & o
+    Rows andNot(Rows o) const { return {_mm256_andnot_si256(v, o.v)}; }
+    Rows shiftDown() const { return {_mm256_srli_epi16(v, 1)}; }
+    Rows shiftUp() const { return {_mm256_slli_epi16(v, 1)}; }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Rows {
+    __m128i v;
+    static const int count = 8;
+    static Rows load(const uint16_t *p) { return {_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))}; }
+    static Rows fill(uint16_t x) { return {_mm_set1_epi16(static_cast<short>(x))}; }
+    void store(uint16_t *p) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    Rows operator&(Rows o) const { return {_mm_and_si128(v, o.v)}; }
+    Rows operator|(Rows o) const { return {_mm_or_si128(v, o.v)}; }
+    Rows andNot(Rows o) const { return {_mm_andnot_si128(v, o.v)}; }
+    Rows shiftDown() const { return {_mm_srli_epi16(v, 1)}; }
+    Rows shiftUp() const { return {_mm_slli_epi16(v, 1)}; }
+};
+#else
+// Four rows in one 64 bit word. Shifts are masked so that no bit
+// moves from one row into the next.
+struct Rows {
+    uint64_t v;
+    static const int count = 4;
+    static Rows load(const uint16_t *p) { Rows r; std::memcpy(&r.v, p, sizeof(r.v)); return r; }
+    static Rows fill(uint16_t x) { return {x * 0x0001000100010001ull}; }
+    void store(uint16_t *p) const { std::memcpy(p, &v, sizeof(v)); }
+    Rows operator&(Rows o) const { return {v & o.v}; }
+    Rows operator|(Rows o) const { return {v | o.v}; }
+    Rows andNot(Rows o) const { return {~v & o.v}; }
+    Rows shiftDown() const { return {(v >> 1) & 0x7fff7fff7fff7fffull}; }
+    Rows shiftUp() const { return {(v << 1) & 0xfffefffefffefffeull}; }
+};
+#endif
+
+// Faces of the block rows (o, n) whose neighbors in one direction are (oa, na)
+inline Rows visible(Rows o, Rows n, Rows oa, Rows na) {
+    // Opaque blocks next to a clear block, and clear blocks next to an EMPTY one
+    return oa.andNot(o) | na.andNot(o.andNot(n));
+}
+
+}
+
+FaceMask::FaceMask()
+    : m_rows(6 * 16 * 256, 0)
+{}
+
+void FaceMask::build(const BlockType *blocks, const Chunk *xPos, const Chunk *xNeg, const Chunk *zPos, const Chunk *zNeg,
+                     uint16_t sections) {
+    // The sections whose blocks hide the faces of the ones to build
+    uint16_t read = sections | static_cast<uint16_t>(sections << 1) | static_cast<uint16_t>(sections >> 1);
+    auto inSections = [](uint16_t mask, int y) {
+        return (mask >> (y >> 4)) & 1;
+    };
+
+    // o: opaque blocks, n: blocks that are not EMPTY, both indexed by (x + 1, y + 1).
+    // Past the top, bottom and sides of the Chunk n is all set, since clear
+    // blocks never show faces across the Chunk's edge, and o holds the
+    // neighbor's opacity, which is nothing above and below.
+    std::vector<uint16_t> o(PAD_X * PAD_Y, 0), n(PAD_X * PAD_Y, 0xffff);
+    for (int x = 0; x < 16; x++) {
+        for (int y = 0; y < 256; y++) {
+            if (!inSections(read, y)) {
+                y += 15;
+                continue;
+            }
+            uint16_t oRow = 0, nRow = 0;
+            for (int z = 0; z < 16; z++) {
+                BlockType t = blocks[x + 16 * y + 16 * 256 * z];
+                oRow |= !isClear(t) << z;
+                nRow |= (t != EMPTY) << z;
+            }
+            o[(x + 1) * PAD_Y + y + 1] = oRow;
+            n[(x + 1) * PAD_Y + y + 1] = nRow;
+        }
+    }
+    // The neighbors' opacity along the X edges, and along the Z edges
+    // as the bit that shifts in from past the end of the row
+    std::vector<uint16_t> zPosO(16 * 256, 0), zNegO(16 * 256, 0);
+    for (int y = 0; y < 256; y++) {
+        if (!inSections(sections, y)) {
+            y += 15;
+            continue;
+        }
+        for (int i = 0; i < 16; i++) {
+            if (xPos != nullptr) {
+                o[17 * PAD_Y + y + 1] |= !isClear(xPos->getBlockAt(0, y, i)) << i;
+            }
+            if (xNeg != nullptr) {
+                o[0 * PAD_Y + y + 1] |= !isClear(xNeg->getBlockAt(15, y, i)) << i;
+            }
+            if (zPos != nullptr) {
+                zPosO[i * 256 + y] = !isClear(zPos->getBlockAt(i, y, 0)) << 15;
+            }
+            if (zNeg != nullptr) {
+                zNegO[i * 256 + y] = !isClear(zNeg->getBlockAt(i, y, 15));
+            }
+        }
+    }
+
+    const Rows zPosN = Rows::fill(0x8000), zNegN = Rows::fill(0x0001);
+    for (int x = 0; x < 16; x++) {
+        const uint16_t *col = &o[(x + 1) * PAD_Y + 1];
+        const uint16_t *colN = &n[(x + 1) * PAD_Y + 1];
+        for (int y = 0; y < 256; y += Rows::count) {
+            if (!inSections(sections, y)) {
+                continue;
+            }
+            Rows ro = Rows::load(col + y), rn = Rows::load(colN + y);
+            Rows faces[6];
+            faces[XPOS] = visible(ro, rn, Rows::load(col + PAD_Y + y), Rows::load(colN + PAD_Y + y));
+            faces[XNEG] = visible(ro, rn, Rows::load(col - PAD_Y + y), Rows::load(colN - PAD_Y + y));
+            faces[YPOS] = visible(ro, rn, Rows::load(col + y + 1), Rows::load(colN + y + 1));
+            faces[YNEG] = visible(ro, rn, Rows::load(col + y - 1), Rows::load(colN + y - 1));
+            faces[ZPOS] = visible(ro, rn, ro.shiftDown() | Rows::load(&zPosO[x * 256 + y]), rn.shiftDown() | zPosN);
+            faces[ZNEG] = visible(ro, rn, ro.shiftUp() | Rows::load(&zNegO[x * 256 + y]), rn.shiftUp() | zNegN);
+            for (int d = 0; d < 6; d++) {
+                faces[d].store(&m_rows[(d * 16 + x) * 256 + y]);
+            }
+        }
+    }
+}
+
+uint16_t FaceMask::anyRow(int x, int y) const {
+    uint16_t any = 0;
+    for (int d = 0; d < 6; d++) {
+        any |= m_rows[(d * 16 + x) * 256 + y];
+    }
+    return any;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+class Chunk;
+enum BlockType : unsigned char;
+enum Direction : unsigned char;
+
+// The visible faces of every block in a Chunk, found a whole row of
+// 16 blocks at a time. Each (x, y) row is a 16 bit mask over z of which
+// blocks are opaque and which are not EMPTY, and a face is visible
+// where the block's own mask is set and its neighbor's mask is clear.
+// The rows are combined with SSE2 or AVX2 when the compiler targets them.
+class FaceMask {
+private:
+    // rows[(d * 16 + x) * 256 + y] has bit z set when block (x, y, z) shows its face in Direction d
+    std::vector<uint16_t> m_rows;
+
+public:
+    FaceMask();
+
+    // Find the visible faces of a Chunk whose blocks are laid out as
+    // x + 16 * y + 256 * 16 * z, using the same rules as Chunk::createVBOdataReference():
+    // opaque blocks show faces next to clear blocks, including those of the
+    // neighbors or the missing neighbors past the Chunk's edges, and clear
+    // blocks only show faces next to EMPTY blocks inside the Chunk.
+    // Only the rows of the 16 block high sections in the mask are found,
+    // which read the blocks of those sections and of the ones above and below.
+    void build(const BlockType *blocks, const Chunk *xPos, const Chunk *xNeg, const Chunk *zPos, const Chunk *zNeg,
+               uint16_t sections = 0xffff);
+
+    uint16_t row(Direction d, int x, int y) const {
+        return m_rows[(static_cast<int>(d) * 16 + x) * 256 + y];
+    }
+    // The faces of all six Directions in row (x, y)
+    uint16_t anyRow(int x, int y) const;
+};
@@ -0,0 +1,31 @@
+#include "frustum.h"
+
+Frustum::Frustum() {
+    m_planes.fill(glm::vec4(0.f, 0.f, 0.f, 1.f));
+}
+
+Frustum::Frustum(const glm::mat4 &viewProj) {
+    // Each plane is the fourth row of the matrix plus or minus one of
+    // the other rows (Gribb and Hartmann). glm matrices are column major,
+    // so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+    glm::mat4 t = glm::transpose(viewProj);
+    m_planes[0] = t[3] + t[0]; // left
+    m_planes[1] = t[3] - t[0]; // right
+    m_planes[2] = t[3] + t[1]; // bottom
+    m_planes[3] = t[3] - t[1]; // top
+    m_planes[4] = t[3] + t[2]; // near
+    m_planes[5] = t[3] - t[2]; // far
+}
+
+bool Frustum::intersects(glm::vec3 min, glm::vec3 max) const {
+    for (const glm::vec4 &p : m_planes) {
+        // The corner of the box farthest along the plane's normal
+        glm::vec3 corner(p.x >= 0 ? max.x : min.x,
+                         p.y >= 0 ? max.y : min.y,
+                         p.z >= 0 ? max.z : min.z);
+        if (glm::dot(glm::vec3(p), corner) + p.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+// The six planes of a camera's view volume, used to skip drawing
+// what the camera cannot see
+class Frustum {
+private:
+    // (a, b, c, d) with a point p inside the plane when dot(abc, p) + d >= 0
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    // A frustum that contains everything
+    Frustum();
+    // The view volume of a camera with the given view-projection matrix
+    explicit Frustum(const glm::mat4 &viewProj);
+
+    // Whether any of the axis-aligned box from min to max may be inside.
+    // Conservative: boxes near a corner of the frustum may pass while outside it.
+    bool intersects(glm::vec3 min, glm::vec3 max) const;
+};
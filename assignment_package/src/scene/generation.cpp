@@ -1,4 +1,5 @@
 #include "generation.h"
+#include "zonenoisecache.h"
 #include <iostream>
 #include <ostream>
 
@@ -6,56 +7,165 @@ namespace Generation{
 
 
 
-float genGrasslandsHeight(int x, int z){
-    float terrainBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.005, .01 + z * 0.005));
-    float hillsBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.015, .01 + z * 0.015));
-    float mointainBase = Noise::genPerlinNormal(glm::vec2( + x * 0.004, z * 0.004));
+// The noise fields the biome heights are built from, for the 16 x 16
+// columns of a Chunk, indexed like ColumnHeights
+struct HeightNoise {
+    std::array<float, 256> terrainBase, hillsBase, grassMountainBase, mountainBase, highFreqBase, desertBase;
+};
 
+float genGrasslandsHeight(float terrainBase, float hillsBase, float mointainBase){
     float mountainNoise = pow(mointainBase, 10.0f);
     float fbm_height = Noise::fbm1D(abs(mointainBase));
     float final_height =  hillsBase * 10.f + mountainNoise * 5.f + fbm_height * 50.f + terrainBase *20.f  +110.f;
     return final_height;
 }
 
-float genMountainHeight(int x, int z){
-    float terrainBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.005, .01 + z * 0.005));
-    float hillsBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.015, .01 + z * 0.015));
-    float mointainBase = Noise::genPerlinNormal(glm::vec2( + x * 0.01, z * 0.01));
-    float highFrewBase = Noise::genPerlinNormal(glm::vec2( + x * 0.05, z * 0.05));
-
+float genMountainHeight(float terrainBase, float hillsBase, float mointainBase, float highFrewBase){
     float mountainNoise = pow(mointainBase, 10.0f);
     float fbm_height = Noise::fbm1D(abs(highFrewBase));
     float final_height =  glm::min(terrainBase *10.f + hillsBase * 40.f + fbm_height * 30.f +  mountainNoise * 110.f + 140.f, 255.f);
     return final_height;
 }
 
-float genSnowHeight(int x, int z){
-    float terrainBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.005, .01 + z * 0.005));
-    float hillsBase = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.015, .01 + z * 0.015));
-    float mointainBase = Noise::genPerlinNormal(glm::vec2( + x * 0.004, z * 0.004));
-
+float genSnowHeight(float terrainBase, float hillsBase, float mointainBase){
     float fbm_height = Noise::fbm1D(abs(mointainBase));
     float final_height =  hillsBase * 10.f + fbm_height * 50.f + terrainBase *20.f  +110.f;
     return final_height;
 }
 
-float genDesertHeight(int x, int z){
-    float desertBase = Noise::genPerlinNormal(glm::vec2( 1.0+ x * 0.006, 1.0+ z * 0.006));
-
+float genDesertHeight(float desertBase){
     float fbm_height = Noise::fbm1D(abs(desertBase));
     float final_height =  fbm_height * 50.f  +130.f;
     return final_height;
 }
 
+// Blends the biome heights of every column by its temperature and humidity
+void blendColumnHeights(const HeightNoise &noise, ColumnHeights &out){
+    for (int i = 0; i < 256; i++) {
+        float grassHeight = genGrasslandsHeight(noise.terrainBase[i], noise.hillsBase[i], noise.grassMountainBase[i]);
+        float mountainHeight = genMountainHeight(noise.terrainBase[i], noise.hillsBase[i], noise.mountainBase[i], noise.highFreqBase[i]);
+        float snowHeight = genSnowHeight(noise.terrainBase[i], noise.hillsBase[i], noise.grassMountainBase[i]);
+        float dessetHeight = genDesertHeight(noise.desertBase[i]);
+
+        float tempSLERP = glm::smoothstep(0.3f, .7f, out.temperature[i]);
+        float humiditySLERP = glm::smoothstep(0.3f, .7f, out.humidity[i]);
+        float interp1 = glm::mix(mountainHeight, grassHeight, tempSLERP);
+        float interp2 = glm::mix(snowHeight, dessetHeight, tempSLERP);
+        out.height[i] = glm::mix(interp2, interp1, humiditySLERP);
+        out.humidityBiome[i] = out.humidity[i];
+        out.temperature[i] = tempSLERP;
+        out.humidity[i] = humiditySLERP;
+        out.grassHumidity[i] = glm::smoothstep(0.1f, 0.9f, out.grassHumidity[i]);
+    }
+}
+
+void SampleZoneNoise(int zoneX, int zoneZ, int step, ZoneNoise &out){
+    out.zoneX = zoneX;
+    out.zoneZ = zoneZ;
+    out.step = step;
+    out.size = 64 / step + 1;
+    // Scaling the lattice by step and the frequency by 1 / step yields the
+    // very same coordinates, since zone corners are multiples of 64
+    auto sample = [&](std::vector<float> &field, double offset, double scale) {
+        field.resize(out.size * out.size);
+        Noise::genPerlinNormalGrid(offset, scale * step, zoneX / step, zoneZ / step, out.size, field.data());
+    };
+    sample(out.terrainBase, .01, 0.005);
+    sample(out.grassMountainBase, 0, 0.004);
+    sample(out.desertBase, 1.0, 0.006);
+    sample(out.temperature, -.5, 0.001);
+    sample(out.humidity, 1.0, 0.001);
+    sample(out.grassHumidity, 0, 0.005);
+}
+
+// Bilinearly interpolates a field of the zone at the 16 x 16 columns of
+// the Chunk at (minX, minZ), indexed like ColumnHeights
+void interpolateZoneField(const ZoneNoise &zone, const std::vector<float> &field, int minX, int minZ, float *out){
+    for (int z = 0; z < 16; z++) {
+        int dz = minZ + z - zone.zoneZ;
+        int j = dz / zone.step;
+        float tz = static_cast<float>(dz % zone.step) / zone.step;
+        for (int x = 0; x < 16; x++) {
+            int dx = minX + x - zone.zoneX;
+            int i = dx / zone.step;
+            float tx = static_cast<float>(dx % zone.step) / zone.step;
+            const float *s = &field[i + zone.size * j];
+            out[x + 16 * z] = glm::mix(glm::mix(s[0], s[1], tx), glm::mix(s[zone.size], s[zone.size + 1], tx), tz);
+        }
+    }
+}
+
+void ComputeColumnHeights(int minX, int minZ, const ZoneNoise &zone, ColumnHeights &out){
+    HeightNoise noise;
+    interpolateZoneField(zone, zone.terrainBase, minX, minZ, noise.terrainBase.data());
+    interpolateZoneField(zone, zone.grassMountainBase, minX, minZ, noise.grassMountainBase.data());
+    interpolateZoneField(zone, zone.desertBase, minX, minZ, noise.desertBase.data());
+    interpolateZoneField(zone, zone.temperature, minX, minZ, out.temperature.data());
+    interpolateZoneField(zone, zone.humidity, minX, minZ, out.humidity.data());
+    interpolateZoneField(zone, zone.grassHumidity, minX, minZ, out.grassHumidity.data());
+    Noise::genPerlinNormalGrid(.01, 0.015, minX, minZ, 16, noise.hillsBase.data());
+    Noise::genPerlinNormalGrid(0, 0.01, minX, minZ, 16, noise.mountainBase.data());
+    Noise::genPerlinNormalGrid(0, 0.05, minX, minZ, 16, noise.highFreqBase.data());
+    blendColumnHeights(noise, out);
+}
+
+void ComputeColumnHeightsReference(int minX, int minZ, ColumnHeights &out){
+    HeightNoise noise;
+    for (int z = minZ; z < minZ + 16; z++) {
+        for (int x = minX; x < minX + 16; x++) {
+            int i = (x - minX) + 16 * (z - minZ);
+            noise.terrainBase[i] = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.005, .01 + z * 0.005));
+            noise.hillsBase[i] = Noise::genPerlinNormal(glm::vec2(.01 + x * 0.015, .01 + z * 0.015));
+            noise.grassMountainBase[i] = Noise::genPerlinNormal(glm::vec2( + x * 0.004, z * 0.004));
+            noise.mountainBase[i] = Noise::genPerlinNormal(glm::vec2( + x * 0.01, z * 0.01));
+            noise.highFreqBase[i] = Noise::genPerlinNormal(glm::vec2( + x * 0.05, z * 0.05));
+            noise.desertBase[i] = Noise::genPerlinNormal(glm::vec2( 1.0+ x * 0.006, 1.0+ z * 0.006));
+            out.temperature[i] = Noise::genPerlinNormal(glm::vec2(x * 0.001 -.5, z * 0.001 -.5));
+            out.humidity[i] = Noise::genPerlinNormal(glm::vec2(x * 0.001 +1.0, z * 0.001 +1.0));
+            out.grassHumidity[i] = Noise::genPerlinNormal(glm::vec2(x * 0.005, z * 0.005));
+        }
+    }
+    blendColumnHeights(noise, out);
+}
+
+
+void SampleCaves(int minX, int minZ, int stepXZ, int stepY, CaveMask &out){
+    std::vector<float> noise(256 * (CaveMask::TOP + 1));
+    Noise::perlinNoise3DLattice(1 / 16.f, glm::ivec3(minX, 0, minZ), glm::ivec3(16, CaveMask::TOP + 1, 16),
+                                stepXZ, stepY, noise.data());
+    for (size_t i = 0; i < noise.size(); i++) {
+        out.cave[i] = noise[i] < 0.f;
+    }
+}
+
+void SampleCavesReference(int minX, int minZ, CaveMask &out){
+    for (int y = 0; y <= CaveMask::TOP; y++) {
+        for (int z = minZ; z < minZ + 16; z++) {
+            for (int x = minX; x < minX + 16; x++) {
+                out.cave[(x - minX) + 16 * (z - minZ) + 256 * y] =
+                        Noise::perlinNoise3D(glm::vec3(x / 16.f, y / 16.f, z / 16.f)) < 0.f;
+            }
+        }
+    }
+}
+
 
-void setBlockAt(Chunk* c, int x, int y, int z, BlockType t){
-    c->setBlockAt(x - c->minX, y, z- c->minZ, t);
+// Blocks are generated into a flat scratch array and handed to the Chunk
+// in one go, so its sections are packed once instead of once per write
+struct ChunkBuilder {
+    int minX, minZ;
+    std::array<BlockType, 65536> blocks;
+    CaveMask caves;
+};
+
+void setBlockAt(ChunkBuilder* c, int x, int y, int z, BlockType t){
+    c->blocks.at((x - c->minX) + 16 * y + 16 * 256 * (z - c->minZ)) = t;
 }
 
-void SetRangeAndGenCaves(Chunk* c, int x, int z, int start, int end, BlockType block){
+void SetRangeAndGenCaves(ChunkBuilder* c, int x, int z, int start, int end, BlockType block){
     for (int i = start; i <= end; i++) {
         // cave generation
-        if (i >= 0 && i <= 128 && Noise::perlinNoise3D(glm::vec3(x / 16.f, i / 16.f, z / 16.f)) < 0.f) {
+        if (i >= 0 && i <= CaveMask::TOP && c->caves.cave[(x - c->minX) + 16 * (z - c->minZ) + 256 * i]) {
             if (i >= 25) {
                 setBlockAt(c, x, i, z, EMPTY);
             }
@@ -69,72 +179,88 @@ void SetRangeAndGenCaves(Chunk* c, int x, int z, int start, int end, BlockType b
     }
 }
 
-void SetRange(Chunk* c, int x, int z, int start, int end, BlockType block){
+void SetRange(ChunkBuilder* c, int x, int z, int start, int end, BlockType block){
     for (int i = start; i<=end; i++) {
        setBlockAt(c, x, i, z, block);
     }
 }
 
-void SetMountain(Chunk* c, int x, int z, float height){
-    SetRangeAndGenCaves(c, x, z, 1, height, STONE);
-    if(height > 200) {
+// Each block of a column is written once. Below sea level, the water
+// starts at the surface block and replaces it.
+
+void SetMountain(ChunkBuilder* c, int x, int z, float height){
+    SetRangeAndGenCaves(c, x, z, 1, height - 1, STONE);
+    if (height < 138) {
+        SetRangeAndGenCaves(c, x, z, height, 138, WATER);
+    } else if(height > 200) {
         setBlockAt(c, x, height, z, SNOW);
     } else {
         setBlockAt(c, x, height, z, STONE);
     }
-    if (height < 138) {
-        SetRangeAndGenCaves(c, x, z, height, 138, WATER);
-    }
-
 }
 
-void SetGrassland(Chunk* c, int x, int z, float height){
-    SetRangeAndGenCaves(c, x, z, 1, 128, STONE);
+void SetGrassland(ChunkBuilder* c, int x, int z, float height){
+    SetRangeAndGenCaves(c, x, z, 1, glm::min(height - 1, 127.f), STONE);
     SetRangeAndGenCaves(c, x, z, 128, height - 1, DIRT);
-    setBlockAt(c, x, height, z, GRASS);
     if (height < 138) {
         SetRangeAndGenCaves(c, x, z, height, 138, WATER);
+    } else {
+        setBlockAt(c, x, height, z, GRASS);
     }
 }
 
-void SetDesert(Chunk* c, int x, int z, float height){
-    SetRangeAndGenCaves(c, x, z, 1, 128, STONE);
+void SetDesert(ChunkBuilder* c, int x, int z, float height){
+    SetRangeAndGenCaves(c, x, z, 1, glm::min(height - 1, 127.f), STONE);
     SetRangeAndGenCaves(c, x, z, 128, height - 1, SAND);
     setBlockAt(c, x, height, z, SAND);
+    // Stone reaches up to y = 128 around a surface lower than that
+    SetRangeAndGenCaves(c, x, z, height + 1, 128, STONE);
 }
 
-void SetSnow(Chunk* c, int x, int z, float height){
-    SetRangeAndGenCaves(c, x, z, 1, 128, STONE);
+void SetSnow(ChunkBuilder* c, int x, int z, float height){
+    SetRangeAndGenCaves(c, x, z, 1, glm::min(height - 1, 127.f), STONE);
     SetRangeAndGenCaves(c, x, z, 128, height - 1, DIRT);
-    setBlockAt(c, x, height, z, SNOW);
     if (height < 138) {
         SetRange(c, x, z, height, 137, WATER);
         setBlockAt(c, x, 138, z, ICE);
+    } else {
+        setBlockAt(c, x, height, z, SNOW);
     }
 }
 
 
 
-void GenerateChunk(Chunk* c, int xChunk, int zChunk){
+void GenerateChunk(Chunk* c, int xChunk, int zChunk, ZoneNoiseCache *cache){
 
     int xCorner = static_cast<int>(glm::floor(xChunk / 16.f)) *16;
     int zCorner = static_cast<int>(glm::floor(zChunk / 16.f)) *16;
 
+    uPtr<ChunkBuilder> builder = mkU<ChunkBuilder>();
+    builder->minX = c->minX;
+    builder->minZ = c->minZ;
+    builder->blocks.fill(EMPTY);
+    SampleCaves(xCorner, zCorner, CaveMask::STEP_XZ, CaveMask::STEP_Y, builder->caves);
+
+    int zoneX = static_cast<int>(glm::floor(xCorner / 64.f)) * 64;
+    int zoneZ = static_cast<int>(glm::floor(zCorner / 64.f)) * 64;
+    sPtr<const ZoneNoise> zone;
+    if (cache != nullptr) {
+        zone = cache->get(zoneX, zoneZ);
+    } else {
+        sPtr<ZoneNoise> sampled = mkS<ZoneNoise>();
+        SampleZoneNoise(zoneX, zoneZ, ZoneNoiseCache::DEFAULT_STEP, *sampled);
+        zone = sampled;
+    }
+    ColumnHeights columns;
+    ComputeColumnHeights(xCorner, zCorner, *zone, columns);
+
     for (int x=xCorner; x< xCorner + 16; x++){
         for (int z=zCorner; z< zCorner + 16; z++){
-            float grassHeight =  genGrasslandsHeight(x,z);
-            float mountainHeight =  genMountainHeight(x,z);
-            float snowHeight = genSnowHeight(x,z);
-            float dessetHeight = genDesertHeight(x,z);
-
-            float temperatureBiome = Noise::genPerlinNormal(glm::vec2(x * 0.001 -.5, z * 0.001 -.5));
-            float humidityBiome = Noise::genPerlinNormal(glm::vec2(x * 0.001 +1.0, z * 0.001 +1.0));
-            float tempSLERP = glm::smoothstep(0.3f, .7f, temperatureBiome);
-            float humiditySLERP = glm::smoothstep(0.3f, .7f, humidityBiome);
-            c->setHumidity(humidityBiome);
-            float interp1 = glm::mix(mountainHeight, grassHeight, tempSLERP);
-            float interp2 = glm::mix(snowHeight, dessetHeight, tempSLERP);
-            float finalHeight = glm::mix(interp2, interp1, humiditySLERP);
+            int column = (x - xCorner) + 16 * (z - zCorner);
+            float tempSLERP = columns.temperature[column];
+            float humiditySLERP = columns.humidity[column];
+            float finalHeight = columns.height[column];
+            c->setHumidity(columns.humidityBiome[column]);
 
             if (x ==xCorner+8 && z==zCorner+8){
                 c->biome = tempSLERP>.5 ? (humiditySLERP > .5 ? GRASSLAND : DESERT) :
@@ -143,24 +269,24 @@ void GenerateChunk(Chunk* c, int xChunk, int zChunk){
 
             if (tempSLERP>.5){
                 if (humiditySLERP > .5){
-                    float h = Noise::genPerlinNormal(glm::vec2(x * 0.005, z * 0.005));
-                    float humidity = glm::smoothstep(0.1f, 0.9f, h);
-                    c->setHumidity(humidity);
-                    SetGrassland(c, x, z, finalHeight);
+                    c->setHumidity(columns.grassHumidity[column]);
+                    SetGrassland(builder.get(), x, z, finalHeight);
                 } else {
-                    SetDesert(c, x,z, finalHeight);
+                    SetDesert(builder.get(), x,z, finalHeight);
                 }
             } else {
                 if (humiditySLERP > .5){
-                    SetMountain(c, x,z, finalHeight);
+                    SetMountain(builder.get(), x,z, finalHeight);
                 } else {
-                    SetSnow(c, x,z, finalHeight);
+                    SetSnow(builder.get(), x,z, finalHeight);
                 }
             }
-            setBlockAt(c, x, 0, z, BEDROCK);
+            setBlockAt(builder.get(), x, 0, z, BEDROCK);
         }
     }
 
+    c->setBlocks(builder->blocks.data());
+
 }
 
 
@@ -1,10 +1,64 @@
 #pragma once
 #include "noise.h"
 #include "chunk.h"
+#include <vector>
+
+class ZoneNoiseCache;
 
 namespace Generation
 {
-void GenerateChunk(Chunk* c, int xChunk, int zChunk);
+// The noise fields of a 64 x 64 terrain zone that vary too slowly to be
+// worth sampling at every column, sampled every step blocks from the
+// zone's corner up to its far edge. Columns in between are bilinearly
+// interpolated.
+struct ZoneNoise {
+    int zoneX, zoneZ;
+    int step;
+    // Samples along each axis, 64 / step + 1
+    int size;
+    // Indexed by i + size * j for the sample at (zoneX + i * step, zoneZ + j * step)
+    std::vector<float> terrainBase, grassMountainBase, desertBase, temperature, humidity, grassHumidity;
+};
+
+// step has to divide 64
+void SampleZoneNoise(int zoneX, int zoneZ, int step, ZoneNoise &out);
+
+// The terrain height and biome blend of the 16 x 16 columns of a Chunk,
+// indexed by (x - minX) + 16 * (z - minZ)
+struct ColumnHeights {
+    std::array<float, 256> height;
+    // Blend weights from 0 to 1 between the biomes
+    std::array<float, 256> temperature, humidity;
+    // The humidity noise itself, and that of grasslands
+    std::array<float, 256> humidityBiome, grassHumidity;
+};
+
+// Interpolates the slowly varying noise of the Chunk's columns from the
+// zone's, and samples the rest of its noise with Noise::genPerlinNormalGrid
+void ComputeColumnHeights(int minX, int minZ, const ZoneNoise &zone, ColumnHeights &out);
+// Samples the noise one column at a time with Noise::genPerlinNormal, as
+// GenerateChunk used to. Kept to check ComputeColumnHeights() against.
+void ComputeColumnHeightsReference(int minX, int minZ, ColumnHeights &out);
+
+// Whether each block of a Chunk from y = 0 up to TOP is carved out by a
+// cave, indexed by (x - minX) + 16 * (z - minZ) + 256 * y
+struct CaveMask {
+    static constexpr int TOP = 128;
+    // Blocks between samples of the cave noise along x and z, and along y
+    static constexpr int STEP_XZ = 4;
+    static constexpr int STEP_Y = 4;
+    std::array<bool, 256 * (TOP + 1)> cave;
+};
+
+// Interpolates the cave noise from samples every stepXZ and stepY blocks
+void SampleCaves(int minX, int minZ, int stepXZ, int stepY, CaveMask &out);
+// Samples the cave noise at every block, as GenerateChunk used to.
+// Kept to check SampleCaves() against.
+void SampleCavesReference(int minX, int minZ, CaveMask &out);
+
+// Takes the ZoneNoise of the Chunk's zone from the cache, or samples it
+// for this Chunk alone without one
+void GenerateChunk(Chunk* c, int xChunk, int zChunk, ZoneNoiseCache *cache = nullptr);
 
 bool CanPlaceTree(Chunk *c, int x, int y, int z);
 
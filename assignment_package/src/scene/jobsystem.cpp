@@ -0,0 +1,170 @@
+#include "jobsystem.h"
+#include <algorithm>
+
+Job::Job()
+    : m_cancelled(false), m_freeList(nullptr), m_ticket(0)
+{}
+
+bool Job::cancelled() const {
+    return m_cancelled.load(std::memory_order_acquire);
+}
+
+void Job::cancel() {
+    m_cancelled.store(true, std::memory_order_release);
+}
+
+uint64_t Job::ticket() const {
+    return m_ticket;
+}
+
+void Job::cancel(uint64_t ticket) {
+    // Only this thread acquires jobs, so the ticket cannot change between
+    // the comparison and the cancel
+    if (m_ticket == ticket) {
+        cancel();
+    }
+}
+
+void Job::finished() {
+    if (m_freeList != nullptr) {
+        m_freeList->push(this);
+    } else {
+        delete this;
+    }
+}
+
+JobSystem::Worker::Worker(JobSystem *system, int index)
+    : mp_system(system), m_index(index)
+{}
+
+void JobSystem::Worker::run() {
+    mp_system->work(m_index);
+}
+
+JobSystem::JobSystem(int workers)
+    : m_deques(), m_workers(), m_idleLock(), m_jobAdded(), m_allDone(), m_stopping(false),
+      m_queued(0), m_unfinished(0), m_nextDeque(0), m_stolenCount(0)
+{
+    startWorkers(workers);
+}
+
+JobSystem::~JobSystem() {
+    stopWorkers();
+}
+
+int JobSystem::defaultWorkerCount() {
+    return std::max(1, QThread::idealThreadCount() - 1);
+}
+
+void JobSystem::startWorkers(int workers) {
+    if (workers <= 0) {
+        workers = defaultWorkerCount();
+    }
+    m_stopping = false;
+    for (int i = 0; i < workers; i++) {
+        m_deques.push_back(mkU<Deque>());
+    }
+    for (int i = 0; i < workers; i++) {
+        m_workers.push_back(mkU<Worker>(this, i));
+        m_workers.back()->start();
+    }
+}
+
+void JobSystem::stopWorkers() {
+    m_idleLock.lock();
+    m_stopping = true;
+    m_jobAdded.wakeAll();
+    m_idleLock.unlock();
+    for (uPtr<Worker> &w : m_workers) {
+        w->wait();
+    }
+    m_workers.clear();
+    m_deques.clear();
+}
+
+void JobSystem::submit(Job *job) {
+    m_unfinished++;
+    m_queued++;
+    Deque &d = *m_deques[m_nextDeque++ % m_deques.size()];
+    d.lock.lock();
+    d.jobs.push_back(job);
+    d.lock.unlock();
+
+    m_idleLock.lock();
+    m_jobAdded.wakeOne();
+    m_idleLock.unlock();
+}
+
+Job* JobSystem::take(int index) {
+    int count = static_cast<int>(m_deques.size());
+    for (int i = 0; i < count; i++) {
+        Deque &d = *m_deques[(index + i) % count];
+        d.lock.lock();
+        if (d.jobs.empty()) {
+            d.lock.unlock();
+            continue;
+        }
+        Job *job;
+        if (i == 0) {
+            job = d.jobs.front();
+            d.jobs.pop_front();
+        } else {
+            // The newest job of another worker, which it would start last
+            job = d.jobs.back();
+            d.jobs.pop_back();
+            m_stolenCount++;
+        }
+        d.lock.unlock();
+        m_queued--;
+        return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::work(int index) {
+    while (true) {
+        Job *job = take(index);
+        if (job == nullptr) {
+            m_idleLock.lock();
+            while (m_queued.load() == 0 && !m_stopping) {
+                m_jobAdded.wait(&m_idleLock);
+            }
+            bool stop = m_stopping && m_queued.load() == 0;
+            m_idleLock.unlock();
+            if (stop) {
+                return;
+            }
+            continue;
+        }
+
+        job->run();
+        job->finished();
+        if (--m_unfinished == 0) {
+            m_idleLock.lock();
+            m_allDone.wakeAll();
+            m_idleLock.unlock();
+        }
+    }
+}
+
+void JobSystem::waitForDone() {
+    m_idleLock.lock();
+    while (m_unfinished.load() > 0) {
+        m_allDone.wait(&m_idleLock);
+    }
+    m_idleLock.unlock();
+}
+
+void JobSystem::setWorkerCount(int workers) {
+    waitForDone();
+    stopWorkers();
+    startWorkers(workers);
+}
+
+int JobSystem::workerCount() const {
+    return static_cast<int>(m_workers.size());
+}
+
+int JobSystem::stolenCount() const {
+    return m_stolenCount.load();
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "completionqueue.h"
+#include "smartpointerhelp.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// One piece of work for the JobSystem. A job that runs in phases checks
+// cancelled() between them and stops early once it is set, handing its
+// Chunks back as cancelled instead of done.
+class Job {
+private:
+    std::atomic<bool> m_cancelled;
+    // The free list of the JobPool the job came from, null if it has none
+    CompletionQueue<Job *> *m_freeList;
+    // Counts the times the job was acquired from its JobPool
+    uint64_t m_ticket;
+
+    template <typename T> friend class JobPool;
+
+protected:
+    bool cancelled() const;
+
+public:
+    Job();
+    virtual ~Job() {}
+    Job(const Job&) = delete;
+    Job& operator=(const Job&) = delete;
+
+    virtual void run() = 0;
+
+    // From any thread, before or while the job runs
+    void cancel();
+    // Names this submission of the job. A job goes back to its JobPool
+    // as soon as it finishes and may be acquired for other work before
+    // its results are drained, so whoever keeps the job to cancel it
+    // later keeps its ticket too.
+    uint64_t ticket() const;
+    // cancel() only if the job was not acquired again since ticket()
+    // returned ticket. On the thread that acquires the job.
+    void cancel(uint64_t ticket);
+    // Called on the worker once run() returns. Hands the job back to its
+    // JobPool, or deletes it when it has none, like an autoDelete QRunnable.
+    void finished();
+};
+
+// Jobs of one kind, reused rather than allocated for every Chunk. Jobs
+// are taken on the thread that submits them and come back from the
+// workers through a CompletionQueue, so neither side takes a lock.
+template <typename T>
+class JobPool {
+private:
+    std::vector<uPtr<T>> m_jobs;
+    CompletionQueue<Job *> m_free;
+
+public:
+    // Holds at most about capacity jobs
+    explicit JobPool(size_t capacity);
+
+    // A job that is not cancelled, made with args if none is free. Null
+    // when every job the pool can hold is out. Only from one thread.
+    template <typename... Args>
+    T* acquire(Args&&... args);
+
+    size_t size() const;
+};
+
+// Runs Jobs on a fixed set of worker threads, leaving a core to the GUI
+// thread by default. Each worker has its own deque of jobs. Submitted
+// jobs are dealt out to the deques in turn, and each worker takes the
+// oldest job of its own deque, so that jobs submitted in priority order
+// start roughly in that order. A worker whose deque is empty steals the
+// newest job of another before going to sleep.
+class JobSystem {
+private:
+    class Worker : public QThread {
+    private:
+        JobSystem *mp_system;
+        int m_index;
+
+    protected:
+        void run() override;
+
+    public:
+        Worker(JobSystem *system, int index);
+    };
+
+    struct Deque {
+        QMutex lock;
+        std::deque<Job *> jobs;
+    };
+
+    std::vector<uPtr<Deque>> m_deques;
+    std::vector<uPtr<Worker>> m_workers;
+
+    // Guards m_stopping and sleeping on the wait conditions
+    QMutex m_idleLock;
+    QWaitCondition m_jobAdded;
+    QWaitCondition m_allDone;
+    bool m_stopping;
+    // Jobs in the deques, and jobs submitted that have not finished
+    std::atomic<int> m_queued;
+    std::atomic<int> m_unfinished;
+    std::atomic<unsigned int> m_nextDeque;
+    std::atomic<int> m_stolenCount;
+
+    void startWorkers(int workers);
+    // Lets the workers finish every queued job, then joins them
+    void stopWorkers();
+    // The next job for the worker, or null when every deque is empty
+    Job* take(int index);
+    void work(int index);
+
+public:
+    // Runs jobs on the given number of threads, or on defaultWorkerCount() when it is 0 or less
+    explicit JobSystem(int workers = 0);
+    ~JobSystem();
+
+    // One less than the cores, keeping one for the GUI thread, and at least one
+    static int defaultWorkerCount();
+
+    // Takes the job until it has finished
+    void submit(Job *job);
+    // Blocks until every submitted job has finished
+    void waitForDone();
+
+    // Waits for every submitted job, then runs later jobs on this many
+    // threads, or on defaultWorkerCount() when it is 0 or less
+    void setWorkerCount(int workers);
+    int workerCount() const;
+    // Jobs a worker took from another worker's deque so far
+    int stolenCount() const;
+};
+
+template <typename T>
+JobPool<T>::JobPool(size_t capacity)
+    : m_jobs(), m_free(capacity)
+{}
+
+template <typename T>
+template <typename... Args>
+T* JobPool<T>::acquire(Args&&... args) {
+    Job *job = nullptr;
+    if (!m_free.pop(job)) {
+        // A finished job pushes itself onto m_free, which has to have room for every job
+        if (m_jobs.size() >= m_free.capacity()) {
+            return nullptr;
+        }
+        m_jobs.push_back(mkU<T>(std::forward<Args>(args)...));
+        job = m_jobs.back().get();
+        job->m_freeList = &m_free;
+    }
+    job->m_cancelled.store(false, std::memory_order_relaxed);
+    job->m_ticket++;
+    return static_cast<T*>(job);
+}
+
+template <typename T>
+size_t JobPool<T>::size() const {
+    return m_jobs.size();
+}
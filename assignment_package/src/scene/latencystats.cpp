@@ -0,0 +1,72 @@
+#include "latencystats.h"
+#include <QMutexLocker>
+#include <sstream>
+
+LatencyStats::LatencyStats()
+    : m_lock(), m_count(0), m_totalMs(0), m_maxMs(0)
+{}
+
+void LatencyStats::add(double ms) {
+    QMutexLocker locker(&m_lock);
+    m_count++;
+    m_totalMs += ms;
+    if (ms > m_maxMs) {
+        m_maxMs = ms;
+    }
+}
+
+int LatencyStats::count() const {
+    QMutexLocker locker(&m_lock);
+    return m_count;
+}
+
+double LatencyStats::averageMs() const {
+    QMutexLocker locker(&m_lock);
+    return m_count == 0 ? 0 : m_totalMs / m_count;
+}
+
+double LatencyStats::maxMs() const {
+    QMutexLocker locker(&m_lock);
+    return m_maxMs;
+}
+
+LatencyHistogram::LatencyHistogram()
+    : m_stats(), m_lock(), m_buckets()
+{
+    m_buckets.fill(0);
+}
+
+void LatencyHistogram::add(double ms) {
+    m_stats.add(ms);
+    int i = 0;
+    while (i + 1 < BUCKETS && ms >= bucketLimitMs(i)) {
+        i++;
+    }
+    QMutexLocker locker(&m_lock);
+    m_buckets[i]++;
+}
+
+const LatencyStats &LatencyHistogram::stats() const {
+    return m_stats;
+}
+
+int LatencyHistogram::bucketCount(int i) const {
+    QMutexLocker locker(&m_lock);
+    return m_buckets[i];
+}
+
+double LatencyHistogram::bucketLimitMs(int i) {
+    return static_cast<double>(1 << i);
+}
+
+std::string LatencyHistogram::toString() const {
+    std::ostringstream out;
+    for (int i = 0; i < BUCKETS; i++) {
+        if (i + 1 < BUCKETS) {
+            out << "<" << bucketLimitMs(i) << ": " << bucketCount(i) << "  ";
+        } else {
+            out << ">=" << bucketLimitMs(i - 1) << ": " << bucketCount(i);
+        }
+    }
+    return out.str();
+}
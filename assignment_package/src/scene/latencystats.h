@@ -0,0 +1,49 @@
+#pragma once
+#include <QMutex>
+#include <array>
+#include <string>
+
+// Running count, average and maximum of a duration in milliseconds.
+// Workers on any thread may add samples while the GUI reads them.
+class LatencyStats {
+private:
+    mutable QMutex m_lock;
+    int m_count;
+    double m_totalMs;
+    double m_maxMs;
+
+public:
+    LatencyStats();
+
+    void add(double ms);
+
+    int count() const;
+    double averageMs() const;
+    double maxMs() const;
+};
+
+// A LatencyStats that also counts how many samples fall into each of a
+// few buckets, whose limits double from 1 ms up to about 128 ms, so that
+// the occasional slow sample shows up apart from the average
+class LatencyHistogram {
+public:
+    static constexpr int BUCKETS = 9;
+
+private:
+    LatencyStats m_stats;
+    mutable QMutex m_lock;
+    std::array<int, BUCKETS> m_buckets;
+
+public:
+    LatencyHistogram();
+
+    void add(double ms);
+
+    const LatencyStats &stats() const;
+    // Samples below bucketLimitMs(i) and at least bucketLimitMs(i - 1).
+    // The last bucket has no upper limit.
+    int bucketCount(int i) const;
+    static double bucketLimitMs(int i);
+    // The buckets as "<1: 0  <2: 3 ... >=128: 0"
+    std::string toString() const;
+};
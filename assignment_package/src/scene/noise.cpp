@@ -1,5 +1,66 @@
 #include "noise.h"
 #include <algorithm>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every ISA below provides the same operations on a group of floats,
+// so the grid kernel is written once
+#if defined(__AVX2__)
+struct Floats {
+    __m256 v;
+    static const int count = 8;
+    static Floats load(const float *p) { return {_mm256_loadu_ps(p)}; }
+    static Floats fill(float x) { return {_mm256_set1_ps(x)}; }
+    void store(float *p) const { _mm256_storeu_ps(p, v); }
+    Floats operator+(Floats o) const { return {_mm256_add_ps(v, o.v)}; }
+    Floats operator-(Floats o) const { return {_mm256_sub_ps(v, o.v)}; }
+    Floats operator*(Floats o) const { return {_mm256_mul_ps(v, o.v)}; }
+    Floats operator/(Floats o) const { return {_mm256_div_ps(v, o.v)}; }
+    Floats min(Floats o) const { return {_mm256_min_ps(v, o.v)}; }
+    Floats max(Floats o) const { return {_mm256_max_ps(v, o.v)}; }
+};
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Floats {
+    __m128 v;
+    static const int count = 4;
+    static Floats load(const float *p) { return {_mm_loadu_ps(p)}; }
+    static Floats fill(float x) { return {_mm_set1_ps(x)}; }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+    Floats operator+(Floats o) const { return {_mm_add_ps(v, o.v)}; }
+    Floats operator-(Floats o) const { return {_mm_sub_ps(v, o.v)}; }
+    Floats operator*(Floats o) const { return {_mm_mul_ps(v, o.v)}; }
+    Floats operator/(Floats o) const { return {_mm_div_ps(v, o.v)}; }
+    Floats min(Floats o) const { return {_mm_min_ps(v, o.v)}; }
+    Floats max(Floats o) const { return {_mm_max_ps(v, o.v)}; }
+};
+#else
+struct Floats {
+    float v;
+    static const int count = 1;
+    static Floats load(const float *p) { return {*p}; }
+    static Floats fill(float x) { return {x}; }
+    void store(float *p) const { *p = v; }
+    Floats operator+(Floats o) const { return {v + o.v}; }
+    Floats operator-(Floats o) const { return {v - o.v}; }
+    Floats operator*(Floats o) const { return {v * o.v}; }
+    Floats operator/(Floats o) const { return {v / o.v}; }
+    Floats min(Floats o) const { return {std::min(v, o.v)}; }
+    Floats max(Floats o) const { return {std::max(v, o.v)}; }
+};
+#endif
+
+// The quintic falloff 1 - 6d^5 + 15d^4 - 10d^3 of a surflet, evaluated
+// with multiplications instead of pow() so that the grid kernel computes
+// exactly the same value
+inline float fade(float d) {
+    return 1.f - d * d * d * (10.f + d * (6.f * d - 15.f));
+}
+
+}
 
 namespace Noise {
 
@@ -36,10 +97,8 @@ namespace Noise {
 
     float surflet(glm::vec2 P, glm::vec2 gridPoint) {
         // Compute falloff function by converting linear distance to a polynomial
-        float distX = abs(P.x - gridPoint.x);
-        float distY = abs(P.y - gridPoint.y);
-        float tX = 1 - 6 * pow(distX, 5.f) + 15 * pow(distX, 4.f) - 10 * pow(distX, 3.f);
-        float tY = 1 - 6 * pow(distY, 5.f) + 15 * pow(distY, 4.f) - 10 * pow(distY, 3.f);
+        float tX = fade(std::abs(P.x - gridPoint.x));
+        float tY = fade(std::abs(P.y - gridPoint.y));
         // Get the random vector for the grid point
         glm::vec2 gradient = random2(gridPoint);
         // Get the vector from the grid point to P
@@ -82,6 +141,57 @@ namespace Noise {
         return surfletSum;
     }
 
+    void perlinNoise3DLattice(float scale, glm::ivec3 min, glm::ivec3 size, int stepXZ, int stepY, float *out) {
+        // Samples along each axis, one past the end of the box when its
+        // size does not end on a sample
+        int nx = (size.x - 1) / stepXZ + 2, ny = (size.y - 1) / stepY + 2, nz = (size.z - 1) / stepXZ + 2;
+
+        // Interpolate along x first, into one row of size.x blocks for
+        // every sample of y and z. Blocks then only need the four rows
+        // around them, which line up with each other.
+        std::vector<float> samples(nx);
+        std::vector<float> rows(size.x * ny * nz);
+        for (int j = 0; j < ny; j++) {
+            for (int k = 0; k < nz; k++) {
+                for (int i = 0; i < nx; i++) {
+                    samples[i] = perlinNoise3D(scale * glm::vec3(min.x + i * stepXZ, min.y + j * stepY, min.z + k * stepXZ));
+                }
+                float *row = &rows[size.x * (k + nz * j)];
+                for (int x = 0; x < size.x; x++) {
+                    float a = samples[x / stepXZ], b = samples[x / stepXZ + 1];
+                    row[x] = a + (b - a) * (static_cast<float>(x % stepXZ) / stepXZ);
+                }
+            }
+        }
+
+        for (int y = 0; y < size.y; y++) {
+            int j = y / stepY;
+            float ty = static_cast<float>(y % stepY) / stepY;
+            for (int z = 0; z < size.z; z++) {
+                int k = z / stepXZ;
+                float tz = static_cast<float>(z % stepXZ) / stepXZ;
+                const float *r00 = &rows[size.x * (k + nz * j)];
+                const float *r01 = r00 + size.x;
+                const float *r10 = r00 + size.x * nz;
+                const float *r11 = r10 + size.x;
+                float *o = out + size.x * (z + size.z * y);
+
+                int x = 0;
+                Floats vy = Floats::fill(ty), vz = Floats::fill(tz);
+                for (; x + Floats::count <= size.x; x += Floats::count) {
+                    Floats a = Floats::load(r00 + x), b = Floats::load(r01 + x);
+                    Floats c = Floats::load(r10 + x), d = Floats::load(r11 + x);
+                    Floats low = a + (b - a) * vz, high = c + (d - c) * vz;
+                    (low + (high - low) * vy).store(o + x);
+                }
+                for (; x < size.x; x++) {
+                    float low = r00[x] + (r01[x] - r00[x]) * tz, high = r10[x] + (r11[x] - r10[x]) * tz;
+                    o[x] = low + (high - low) * ty;
+                }
+            }
+        }
+    }
+
     float perlinNoise3D(glm::vec3 p) {
         float surfletSum = 0.f;
         // Iterate over the four integer corners surrounding uv
@@ -100,6 +210,110 @@ namespace Noise {
         return (std::clamp((perlinNoise2D(uv) / 0.34f), -1.f, 1.f) + 1.0f)/2.0f;
     }
 
+    // Along one axis of a grid: each sample's coordinate, the lattice cell
+    // it is in relative to the grid's first one, its offsets from the two
+    // lattice lines around it, and their falloffs
+    struct GridAxis {
+        float first;
+        int cells;
+        std::vector<int> cell;
+        std::vector<float> d0, d1, t0, t1;
+
+        GridAxis(double offset, double scale, int min, int size)
+            : first(0.f), cells(0), cell(size), d0(size), d1(size), t0(size), t1(size)
+        {
+            std::vector<float> coords(size);
+            float lowest = 0.f, highest = 0.f;
+            for (int i = 0; i < size; i++) {
+                coords[i] = static_cast<float>(offset + (min + i) * scale);
+                lowest = i == 0 ? coords[i] : std::min(lowest, coords[i]);
+                highest = i == 0 ? coords[i] : std::max(highest, coords[i]);
+            }
+            first = glm::floor(lowest);
+            cells = static_cast<int>(glm::floor(highest) - first) + 1;
+            for (int i = 0; i < size; i++) {
+                float line = glm::floor(coords[i]);
+                cell[i] = static_cast<int>(line - first);
+                d0[i] = coords[i] - line;
+                d1[i] = coords[i] - (line + 1.f);
+                t0[i] = fade(std::abs(d0[i]));
+                t1[i] = fade(std::abs(d1[i]));
+            }
+        }
+    };
+
+    void perlinNoise2DGrid(double offset, double scale, int minX, int minZ, int size, float *out) {
+        GridAxis u(offset, scale, minX, size), v(offset, scale, minZ, size);
+
+        // The gradient of every lattice point the grid touches, hashed once
+        int width = u.cells + 1;
+        std::vector<float> gradX(width * (v.cells + 1)), gradY(width * (v.cells + 1));
+        for (int j = 0; j <= v.cells; j++) {
+            for (int i = 0; i < width; i++) {
+                glm::vec2 g = random2(glm::vec2(u.first, v.first) + glm::vec2(i, j));
+                gradX[i + width * j] = g.x;
+                gradY[i + width * j] = g.y;
+            }
+        }
+
+        // The gradients of the four corners of each sample of a row
+        std::vector<float> corners(8 * size);
+        float *g00x = &corners[0], *g00y = &corners[size], *g01x = &corners[2 * size], *g01y = &corners[3 * size];
+        float *g10x = &corners[4 * size], *g10y = &corners[5 * size], *g11x = &corners[6 * size], *g11y = &corners[7 * size];
+        for (int j = 0; j < size; j++) {
+            int row = width * v.cell[j];
+            for (int i = 0; i < size; i++) {
+                int g = row + u.cell[i];
+                g00x[i] = gradX[g];
+                g00y[i] = gradY[g];
+                g01x[i] = gradX[g + width];
+                g01y[i] = gradY[g + width];
+                g10x[i] = gradX[g + 1];
+                g10y[i] = gradY[g + 1];
+                g11x[i] = gradX[g + width + 1];
+                g11y[i] = gradY[g + width + 1];
+            }
+
+            // The sum of the surflets of the four corners, in the same
+            // order and with the same operations as perlinNoise2D
+            auto surflets = [&](auto du0, auto du1, auto tu0, auto tu1, auto dv0, auto dv1, auto tv0, auto tv1,
+                                auto a, auto b, auto c, auto d, auto e, auto f, auto g, auto h) {
+                auto sum = (du0 * a + dv0 * b) * tu0 * tv0;
+                sum = sum + (du0 * c + dv1 * d) * tu0 * tv1;
+                sum = sum + (du1 * e + dv0 * f) * tu1 * tv0;
+                return sum + (du1 * g + dv1 * h) * tu1 * tv1;
+            };
+            Floats dv0 = Floats::fill(v.d0[j]), dv1 = Floats::fill(v.d1[j]);
+            Floats tv0 = Floats::fill(v.t0[j]), tv1 = Floats::fill(v.t1[j]);
+            int i = 0;
+            for (; i + Floats::count <= size; i += Floats::count) {
+                surflets(Floats::load(&u.d0[i]), Floats::load(&u.d1[i]), Floats::load(&u.t0[i]), Floats::load(&u.t1[i]),
+                         dv0, dv1, tv0, tv1,
+                         Floats::load(g00x + i), Floats::load(g00y + i), Floats::load(g01x + i), Floats::load(g01y + i),
+                         Floats::load(g10x + i), Floats::load(g10y + i), Floats::load(g11x + i), Floats::load(g11y + i))
+                        .store(out + i + size * j);
+            }
+            for (; i < size; i++) {
+                out[i + size * j] = surflets(u.d0[i], u.d1[i], u.t0[i], u.t1[i],
+                                             v.d0[j], v.d1[j], v.t0[j], v.t1[j],
+                                             g00x[i], g00y[i], g01x[i], g01y[i], g10x[i], g10y[i], g11x[i], g11y[i]);
+            }
+        }
+    }
+
+    void genPerlinNormalGrid(double offset, double scale, int minX, int minZ, int size, float *out) {
+        perlinNoise2DGrid(offset, scale, minX, minZ, size, out);
+        int count = size * size;
+        int i = 0;
+        for (; i + Floats::count <= count; i += Floats::count) {
+            Floats n = (Floats::load(out + i) / Floats::fill(0.34f)).max(Floats::fill(-1.f)).min(Floats::fill(1.f));
+            ((n + Floats::fill(1.f)) / Floats::fill(2.f)).store(out + i);
+        }
+        for (; i < count; i++) {
+            out[i] = (std::clamp(out[i] / 0.34f, -1.f, 1.f) + 1.f) / 2.f;
+        }
+    }
+
 
     float noise2D(glm::vec2 point){
         return glm::normalize(glm::fract(glm::sin(glm::dot(point, glm::vec2(127.1, 311.7)))) * 43758.5453f);
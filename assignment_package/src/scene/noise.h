@@ -6,8 +6,29 @@ namespace Noise {
 
     float perlinNoise3D(glm::vec3 p);
 
+    // perlinNoise3D(scale * (x, y, z)) for every block (x, y, z) of the box
+    // of size blocks whose lowest corner is min, into
+    // out[(x - min.x) + size.x * ((z - min.z) + size.z * (y - min.y))].
+    // Only samples the noise every stepXZ blocks along x and z and every
+    // stepY blocks along y, from min on, and trilinearly interpolates the
+    // blocks in between, several at a time with SIMD. Exact at the samples.
+    void perlinNoise3DLattice(float scale, glm::ivec3 min, glm::ivec3 size, int stepXZ, int stepY, float *out);
+
     float genPerlinNormal(glm::vec2 uv);
 
+    // perlinNoise2D at the points (offset + x * scale, offset + z * scale)
+    // of every integer x in [minX, minX + size) and z in [minZ, minZ + size),
+    // into out[(x - minX) + size * (z - minZ)]. Like the biome functions,
+    // the coordinates are computed in double before being rounded to float.
+    // The lattice gradients are hashed once per grid instead of once per
+    // sample, and the samples are evaluated several at a time with SIMD.
+    // Matches perlinNoise2D exactly unless the compiler fuses multiply-adds
+    // differently in the two, and to within 1e-6 when it does.
+    void perlinNoise2DGrid(double offset, double scale, int minX, int minZ, int size, float *out);
+
+    // genPerlinNormal over the same grid as perlinNoise2DGrid
+    void genPerlinNormalGrid(double offset, double scale, int minX, int minZ, int size, float *out);
+
     float fbm2D(float x, float y);
 
     float fbm1D(float x);
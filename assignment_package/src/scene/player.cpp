@@ -15,7 +15,7 @@ Player::Player(glm::vec3 pos, const Terrain &terrain)
     : Entity(pos), m_velocity(0, 0, 0), m_acceleration(0.f, 0.f, 0.f),
       m_camera(pos + glm::vec3(0, 1.5f, 0)), mcr_terrain(terrain),
       m_flyMode(true), m_isGrounded(false), m_inLiquid(false),
-      mcr_camera(m_camera)
+      mcr_camera(m_camera), mcr_velocity(m_velocity)
 {}
 
 Player::~Player()
@@ -197,7 +197,7 @@ void Player::updateLiquid(const Terrain &terrain) {
     for (glm::vec3 &pos : rayOrigins) {
         try {
             BlockType type = terrain.getBlockAt(glm::floor(pos[0]), glm::floor(pos[1]), glm::floor(pos[2]));
-            if (type == LAVA || type == WATER) {
+            if (isLiquid(type)) {
                 m_inLiquid = true;
                 return;
             }
@@ -17,6 +17,8 @@ public:
     // Readonly public reference to our camera
     // for easy access from MyGL
     const Camera& mcr_camera;
+    // In world space, for predicting where the Player is headed
+    const glm::vec3& mcr_velocity;
 
     Player(glm::vec3 pos, const Terrain &terrain);
     virtual ~Player() override;
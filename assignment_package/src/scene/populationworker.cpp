@@ -2,17 +2,24 @@
 #include "scene/generation.h"
 #include "scene/noise.h"
 
-populationworker::populationworker(Chunk * m_chunkToPopulate, std::unordered_set<Chunk *> * m_populatedChunks, QMutex * m_chunkPopulationLock)
-    : m_chunk(m_chunkToPopulate), m_populatedChunks(m_populatedChunks), m_chunkPopulationLock(m_chunkPopulationLock)
+populationworker::populationworker(CompletionQueue<Chunk *> * m_populatedChunks)
+    : m_chunk(nullptr), m_populatedChunks(m_populatedChunks)
 {}
 
+void populationworker::setChunk(Chunk * m_chunkToPopulate) {
+    m_chunk = m_chunkToPopulate;
+}
+
+// Only the sections that can show or hide a face of the block are remeshed
 void setNeighbor(Chunk *c, int x, int y, int z, BlockType t, bool override){
     if (override){
         c->setBlockAt(x,y,z,t);
-        c->VBOdirty = true;
-    } else if (c->getBlockAt(x,y,z) == EMPTY){
+        c->markDirty(Chunk::sectionsAround(y));
+        c->saveDirty = true;
+    } else if (!isSolid(c->getBlockAt(x,y,z))){
         c->setBlockAt(x,y,z,t);
-        c->VBOdirty = true;
+        c->markDirty(Chunk::sectionsAround(y));
+        c->saveDirty = true;
     }
 }
 
@@ -40,7 +47,7 @@ void placeAcrossChunks(Chunk *c, int x, int y, int z, BlockType t, bool override
     } else{
         if (override){
             c->setBlockAt(x,y,z,t);
-        } else if (c->getBlockAt(x,y,z) == EMPTY){
+        } else if (!isSolid(c->getBlockAt(x,y,z))){
             c->setBlockAt(x,y,z,t);
         }
 
@@ -185,6 +192,8 @@ bool checkNeighborType(Chunk *c, Biome b){
 }
 
 void populationworker::run(){
+    // Trees are written into and read from neighbors other workers mesh
+    ChunkSection::ReadGuard guard;
     std::unordered_map<Biome, float> probtable = {
         {GRASSLAND, .975},
         {DESERT, .985},
@@ -233,7 +242,5 @@ void populationworker::run(){
             }
         }
     }
-    m_chunkPopulationLock->lock();
-    m_populatedChunks->insert(m_chunk);
-    m_chunkPopulationLock->unlock();
+    m_populatedChunks->push(m_chunk);
 }
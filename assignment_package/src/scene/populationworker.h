@@ -1,15 +1,17 @@
 #pragma once
 #include "chunk.h"
-#include <QRunnable>
-#include <QMutex>
+#include "completionqueue.h"
+#include "jobsystem.h"
 
 
-class populationworker : public QRunnable
+// Places trees and other structures on a Chunk, writing into its eight
+// neighbors too. A Chunk left half populated could not be told apart from
+// a finished one, so this job runs to the end even when cancelled.
+class populationworker : public Job
 {
 private:
     Chunk * m_chunk;
-    std::unordered_set<Chunk *>* m_populatedChunks;
-    QMutex * m_chunkPopulationLock;
+    CompletionQueue<Chunk *>* m_populatedChunks;
     //bool spawnLocation[64] = {false};
 
     //bool checkNeighbors(int x, int z);
@@ -18,7 +20,10 @@ private:
 
     void placeSnowTree(int x, int y, int z);
 public:
-    populationworker(Chunk * m_chunkToPopulate, std::unordered_set<Chunk *> * m_populatedChunks, QMutex * m_chunkPopulationLock);
+    populationworker(CompletionQueue<Chunk *> * m_populatedChunks);
+
+    // The Chunk the next run() populates
+    void setChunk(Chunk * m_chunkToPopulate);
 
     void run() override;
 };
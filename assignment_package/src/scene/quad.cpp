@@ -37,3 +37,8 @@ void Quad::createVBOdata()
     mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
     mp_context->glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec2), vert_UV, GL_STATIC_DRAW);
 }
+
+int Quad::uvComponents()
+{
+    return 2;
+}
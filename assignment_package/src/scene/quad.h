@@ -11,4 +11,8 @@ class Quad : public Drawable
 public:
     Quad(OpenGLContext* context);
     virtual void createVBOdata();
+
+protected:
+    // The UVs are vec2s
+    int uvComponents() override;
 };
@@ -0,0 +1,223 @@
+#include "regionfile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#define REGION_CHUNKS 32
+#define HEADER_BYTES (2 * 1024 * 4)
+#define RECORD_VERSION 1
+// version, biome, humidity, blocks
+#define RECORD_BYTES (1 + 1 + 4 + 65536)
+
+static void putUint32(char *out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+    }
+}
+
+static uint32_t getUint32(const char *in) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return v;
+}
+
+RegionFile::RegionFile(const QString &path)
+    : m_file(path), m_open(false), m_header(), m_free()
+{
+    m_header.fill(0);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+    if (m_file.size() < HEADER_BYTES) {
+        // New file: every Chunk is absent
+        std::array<char, HEADER_BYTES> zeros;
+        zeros.fill(0);
+        m_file.seek(0);
+        m_open = m_file.write(zeros.data(), HEADER_BYTES) == HEADER_BYTES;
+        return;
+    }
+    std::array<char, HEADER_BYTES> header;
+    m_file.seek(0);
+    if (m_file.read(header.data(), HEADER_BYTES) != HEADER_BYTES) {
+        return;
+    }
+    for (size_t i = 0; i < m_header.size(); i++) {
+        m_header[i] = getUint32(header.data() + 4 * i);
+    }
+    findFreeRanges();
+    m_open = true;
+}
+
+RegionFile::~RegionFile() {
+    m_file.close();
+}
+
+bool RegionFile::isOpen() const {
+    return m_open;
+}
+
+void RegionFile::writeHeaderEntry(int index) {
+    char entry[8];
+    putUint32(entry, m_header[2 * index]);
+    putUint32(entry + 4, m_header[2 * index + 1]);
+    m_file.seek(8 * index);
+    m_file.write(entry, 8);
+}
+
+void RegionFile::findFreeRanges() {
+    std::vector<std::pair<uint32_t, uint32_t>> records;
+    for (int i = 0; i < 1024; i++) {
+        if (m_header[2 * i] != 0) {
+            records.push_back(std::make_pair(m_header[2 * i], m_header[2 * i + 1]));
+        }
+    }
+    std::sort(records.begin(), records.end());
+    uint32_t end = HEADER_BYTES;
+    for (const auto &record : records) {
+        if (record.first > end) {
+            m_free[end] = record.first - end;
+        }
+        end = std::max(end, record.first + record.second);
+    }
+    // Bytes past the last record were freed by a rewrite that did
+    // not get to shrink the file
+    if (static_cast<uint32_t>(m_file.size()) > end) {
+        m_file.resize(end);
+    }
+}
+
+uint32_t RegionFile::allocate(uint32_t length) {
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second >= length) {
+            uint32_t offset = it->first;
+            uint32_t rest = it->second - length;
+            m_free.erase(it);
+            if (rest > 0) {
+                m_free[offset + length] = rest;
+            }
+            return offset;
+        }
+    }
+    return static_cast<uint32_t>(m_file.size());
+}
+
+void RegionFile::release(uint32_t offset, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    auto next = m_free.find(offset + length);
+    if (next != m_free.end()) {
+        length += next->second;
+        m_free.erase(next);
+    }
+    auto prev = m_free.lower_bound(offset);
+    if (prev != m_free.begin()) {
+        --prev;
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            length += prev->second;
+            m_free.erase(prev);
+        }
+    }
+    if (offset + length >= static_cast<uint32_t>(m_file.size())) {
+        m_file.resize(offset);
+    } else {
+        m_free[offset] = length;
+    }
+}
+
+uint64_t RegionFile::freeBytes() const {
+    uint64_t bytes = 0;
+    for (const auto &range : m_free) {
+        bytes += range.second;
+    }
+    return bytes;
+}
+
+QByteArray RegionFile::read(int index) {
+    uint32_t offset = m_header[2 * index];
+    uint32_t length = m_header[2 * index + 1];
+    if (!m_open || offset == 0 || !m_file.seek(offset)) {
+        return QByteArray();
+    }
+    QByteArray record = m_file.read(length);
+    if (record.size() != static_cast<int>(length)) {
+        return QByteArray();
+    }
+    return record;
+}
+
+bool RegionFile::write(int index, const QByteArray &record) {
+    if (!m_open) {
+        return false;
+    }
+    uint32_t oldOffset = m_header[2 * index];
+    uint32_t oldLength = m_header[2 * index + 1];
+    uint32_t length = static_cast<uint32_t>(record.size());
+    bool inPlace = oldOffset != 0 && length <= oldLength;
+    uint32_t offset = inPlace ? oldOffset : allocate(length);
+    // A moved record is written before the header points at it, so a
+    // crash in between leaves the previous record in place
+    if (!m_file.seek(offset) || m_file.write(record) != record.size()) {
+        if (!inPlace) {
+            release(offset, length);
+        }
+        return false;
+    }
+    m_header[2 * index] = offset;
+    m_header[2 * index + 1] = length;
+    writeHeaderEntry(index);
+    bool flushed = m_file.flush();
+    // Only freed once nothing points at them any more
+    if (inPlace) {
+        release(offset + length, oldLength - length);
+    } else if (oldOffset != 0) {
+        release(oldOffset, oldLength);
+    }
+    return flushed;
+}
+
+int RegionFile::regionCoord(int chunkMin) {
+    return static_cast<int>(std::floor(chunkMin / (16.f * REGION_CHUNKS)));
+}
+
+int RegionFile::indexOf(int minX, int minZ) {
+    int x = (minX / 16) - regionCoord(minX) * REGION_CHUNKS;
+    int z = (minZ / 16) - regionCoord(minZ) * REGION_CHUNKS;
+    return x + REGION_CHUNKS * z;
+}
+
+QString RegionFile::fileName(int regionX, int regionZ) {
+    return "r." + QString::number(regionX) + "." + QString::number(regionZ) + ".region";
+}
+
+QByteArray RegionFile::encodeChunk(const Chunk *c) {
+    QByteArray record;
+    record.resize(RECORD_BYTES);
+    char *out = record.data();
+    out[0] = RECORD_VERSION;
+    out[1] = static_cast<char>(c->biome);
+    float h = c->humidity.load();
+    uint32_t humidity;
+    std::memcpy(&humidity, &h, 4);
+    putUint32(out + 2, humidity);
+    c->getBlocks(reinterpret_cast<BlockType*>(out + 6));
+    return record;
+}
+
+bool RegionFile::decodeChunk(const QByteArray &record, Chunk *c) {
+    if (record.size() != RECORD_BYTES || record.constData()[0] != RECORD_VERSION) {
+        return false;
+    }
+    const char *in = record.constData();
+    c->biome = static_cast<Biome>(in[1]);
+    uint32_t humidity = getUint32(in + 2);
+    float h;
+    std::memcpy(&h, &humidity, 4);
+    c->humidity.store(h);
+    c->setBlocks(reinterpret_cast<const BlockType*>(in + 6));
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "chunk.h"
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <array>
+#include <cstdint>
+#include <map>
+
+// One region file stores a 32 x 32 square of Chunks on disk.
+// The file starts with a header of 1024 (offset, length) pairs of
+// little-endian uint32, one pair per Chunk, followed by the Chunk
+// records in no particular order. Each record is the qCompress'd
+// output of encodeChunk(). An offset of 0 means the Chunk was never saved.
+// Bytes no header entry points at are free and get reused by later records.
+class RegionFile {
+private:
+    QFile m_file;
+    bool m_open;
+    // Offset and length of every record, in header order
+    std::array<uint32_t, 2 * 1024> m_header;
+    // Length of every free range between records by its offset.
+    // Adjacent ranges are always merged.
+    std::map<uint32_t, uint32_t> m_free;
+
+    void writeHeaderEntry(int index);
+    // Rebuilds m_free from the gaps between the records of m_header
+    void findFreeRanges();
+    // Returns the offset of a free range of at least length bytes, or
+    // the end of the file, and takes the bytes out of m_free
+    uint32_t allocate(uint32_t length);
+    // Gives the range back to m_free. A range at the end of the file
+    // shrinks the file instead.
+    void release(uint32_t offset, uint32_t length);
+
+public:
+    RegionFile(const QString &path);
+    ~RegionFile();
+    RegionFile(const RegionFile&) = delete;
+    RegionFile& operator=(const RegionFile&) = delete;
+
+    bool isOpen() const;
+    // Returns the compressed record of the Chunk at the given header
+    // index, or an empty array if it was never saved
+    QByteArray read(int index);
+    // Stores a compressed record. It overwrites the old record when it
+    // fits in its place, and otherwise goes into the first free range it
+    // fits in, or at the end of the file, and frees the old record's bytes.
+    bool write(int index, const QByteArray &record);
+    // Bytes not used by the header or any record
+    uint64_t freeBytes() const;
+
+    // The region that contains the Chunk with this minX or minZ
+    static int regionCoord(int chunkMin);
+    // Header index of the Chunk with these minX and minZ inside its region
+    static int indexOf(int minX, int minZ);
+    static QString fileName(int regionX, int regionZ);
+
+    // The uncompressed record of a Chunk: a format version, the biome,
+    // the humidity and all 65536 blocks
+    static QByteArray encodeChunk(const Chunk *c);
+    // Restores a record made by encodeChunk() into c.
+    // Returns false and leaves c untouched if the record is malformed.
+    static bool decodeChunk(const QByteArray &record, Chunk *c);
+};
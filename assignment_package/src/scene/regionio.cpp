@@ -0,0 +1,119 @@
+#include "regionio.h"
+#include "terrain.h"
+#include <QDir>
+#include <QElapsedTimer>
+
+// Region files kept open at once
+#define MAX_OPEN_REGIONS 16
+
+RegionIO::RegionIO(const QString &directory, std::unordered_set<Chunk *>* loadedChunks,
+                   std::unordered_set<Chunk *>* missingChunks, QMutex * loadCompletedLock,
+                   LatencyStats * loadLatency)
+    : m_directory(directory), m_requests(), m_requestLock(), m_requestAdded(), m_stopping(false),
+      m_regions(), m_loadedChunks(loadedChunks), m_missingChunks(missingChunks),
+      m_loadCompletedLock(loadCompletedLock), m_loadLatency(loadLatency)
+{
+    QDir().mkpath(m_directory);
+}
+
+RegionIO::~RegionIO() {
+    stop();
+}
+
+void RegionIO::requestLoad(Chunk *c) {
+    m_requestLock.lock();
+    m_requests.push_back(Request{false, c->minX, c->minZ, c, nullptr});
+    m_requestLock.unlock();
+    m_requestAdded.wakeOne();
+}
+
+void RegionIO::requestSave(uPtr<Chunk> c) {
+    int minX = c->minX;
+    int minZ = c->minZ;
+    m_requestLock.lock();
+    m_requests.push_back(Request{true, minX, minZ, nullptr, std::move(c)});
+    m_requestLock.unlock();
+    m_requestAdded.wakeOne();
+}
+
+void RegionIO::stop() {
+    m_requestLock.lock();
+    m_stopping = true;
+    m_requestLock.unlock();
+    m_requestAdded.wakeOne();
+    wait();
+}
+
+int RegionIO::pendingRequests() const {
+    m_requestLock.lock();
+    int pending = static_cast<int>(m_requests.size());
+    m_requestLock.unlock();
+    return pending;
+}
+
+void RegionIO::run() {
+    while (true) {
+        m_requestLock.lock();
+        while (m_requests.empty() && !m_stopping) {
+            m_requestAdded.wait(&m_requestLock);
+        }
+        if (m_requests.empty()) {
+            m_requestLock.unlock();
+            break;
+        }
+        Request r = std::move(m_requests.front());
+        m_requests.pop_front();
+        m_requestLock.unlock();
+
+        if (r.save) {
+            save(r);
+        } else {
+            load(r);
+        }
+    }
+    m_regions.clear();
+}
+
+RegionFile* RegionIO::regionAt(int minX, int minZ) {
+    int regionX = RegionFile::regionCoord(minX);
+    int regionZ = RegionFile::regionCoord(minZ);
+    int64_t key = toKey(regionX, regionZ);
+    auto it = m_regions.find(key);
+    if (it != m_regions.end()) {
+        return it->second.get();
+    }
+    if (m_regions.size() >= MAX_OPEN_REGIONS) {
+        m_regions.clear();
+    }
+    QString path = QDir(m_directory).filePath(RegionFile::fileName(regionX, regionZ));
+    uPtr<RegionFile> region = mkU<RegionFile>(path);
+    RegionFile *regionPtr = region.get();
+    m_regions[key] = std::move(region);
+    return regionPtr;
+}
+
+void RegionIO::load(const Request &r) {
+    QElapsedTimer timer;
+    timer.start();
+    RegionFile *region = regionAt(r.minX, r.minZ);
+    QByteArray compressed = region->read(RegionFile::indexOf(r.minX, r.minZ));
+    bool loaded = !compressed.isEmpty()
+            && RegionFile::decodeChunk(qUncompress(compressed), r.chunk);
+    if (loaded) {
+        m_loadLatency->add(timer.nsecsElapsed() * 1e-6);
+    }
+
+    m_loadCompletedLock->lock();
+    if (loaded) {
+        m_loadedChunks->insert(r.chunk);
+    } else {
+        m_missingChunks->insert(r.chunk);
+    }
+    m_loadCompletedLock->unlock();
+}
+
+void RegionIO::save(const Request &r) {
+    RegionFile *region = regionAt(r.minX, r.minZ);
+    QByteArray record = qCompress(RegionFile::encodeChunk(r.saved.get()));
+    region->write(RegionFile::indexOf(r.minX, r.minZ), record);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "chunk.h"
+#include "regionfile.h"
+#include "latencystats.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+// The thread that does every region file read and write, so that
+// the game loop never waits on the disk. Requests are handled one
+// at a time in the order they were made, so a load that follows a
+// save of the same Chunk always sees the saved blocks.
+class RegionIO : public QThread
+{
+private:
+    struct Request {
+        bool save;
+        int minX, minZ;
+        // The Chunk to load into
+        Chunk *chunk;
+        // The Chunk to save, deleted once it is written
+        uPtr<Chunk> saved;
+    };
+
+    QString m_directory;
+
+    std::deque<Request> m_requests;
+    mutable QMutex m_requestLock;
+    QWaitCondition m_requestAdded;
+    bool m_stopping;
+
+    // Open region files by toKey(regionX, regionZ). Only touched by this thread.
+    std::unordered_map<int64_t, uPtr<RegionFile>> m_regions;
+
+    std::unordered_set<Chunk *>* m_loadedChunks;
+    std::unordered_set<Chunk *>* m_missingChunks;
+    QMutex * m_loadCompletedLock;
+    LatencyStats * m_loadLatency;
+
+    RegionFile* regionAt(int minX, int minZ);
+    void load(const Request &r);
+    void save(const Request &r);
+
+protected:
+    void run() override;
+
+public:
+    // Loaded Chunks are added to loadedChunks, and Chunks that have no
+    // record to missingChunks, both under loadCompletedLock
+    RegionIO(const QString &directory, std::unordered_set<Chunk *>* loadedChunks,
+             std::unordered_set<Chunk *>* missingChunks, QMutex * loadCompletedLock,
+             LatencyStats * loadLatency);
+    ~RegionIO();
+
+    // Read the Chunk's blocks from disk. The Chunk must not be
+    // used by anything else until it is handed back.
+    void requestLoad(Chunk *c);
+    // Encode, compress and write the Chunk, then delete it. Nothing
+    // else may point at the Chunk any more.
+    void requestSave(uPtr<Chunk> c);
+    // Finish every queued request, then end the thread
+    void stop();
+
+    int pendingRequests() const;
+};
@@ -0,0 +1,48 @@
+#include "sortworker.h"
+#include <algorithm>
+
+SortWorker::SortWorker(std::vector<SortedMesh> *sortedMeshes, QMutex *sortCompletedLock)
+    : m_mesh(), m_eye(0.f), m_sortedMeshes(sortedMeshes), m_sortCompletedLock(sortCompletedLock)
+{}
+
+void SortWorker::setMesh(SortedMesh mesh, glm::vec3 eye) {
+    m_mesh = std::move(mesh);
+    m_eye = eye;
+}
+
+void SortWorker::run() {
+    if (!cancelled()) {
+        sortBackToFront(m_mesh.vertices, m_eye);
+    }
+    // Terrain cancels the job before it forgets the Chunk's results under
+    // the same lock, so a cancelled result never shows up afterwards
+    m_sortCompletedLock->lock();
+    if (!cancelled()) {
+        m_sortedMeshes->push_back(std::move(m_mesh));
+    }
+    m_sortCompletedLock->unlock();
+    m_mesh.vertices = std::vector<Vertex>();
+}
+
+void SortWorker::sortBackToFront(std::vector<Vertex> &vertices, glm::vec3 eye) {
+    size_t quads = vertices.size() / 4;
+    // Squared distance from the eye to each quad's center, all scaled by
+    // four so that the corners only have to be summed
+    std::vector<std::pair<float, unsigned int>> order(quads);
+    for (size_t q = 0; q < quads; q++) {
+        glm::ivec3 sum = vertices[4 * q].position() + vertices[4 * q + 1].position()
+                + vertices[4 * q + 2].position() + vertices[4 * q + 3].position();
+        glm::vec3 d = glm::vec3(sum) - 4.f * eye;
+        order[q] = std::make_pair(glm::dot(d, d), static_cast<unsigned int>(q));
+    }
+    std::sort(order.begin(), order.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) {
+        return a.first > b.first;
+    });
+
+    std::vector<Vertex> sorted;
+    sorted.reserve(vertices.size());
+    for (const auto &o : order) {
+        sorted.insert(sorted.end(), vertices.begin() + 4 * o.second, vertices.begin() + 4 * o.second + 4);
+    }
+    vertices.swap(sorted);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <QMutex>
+#include "chunk.h"
+#include "jobsystem.h"
+#include <vector>
+
+// The transparent quads of a Chunk's section in back to front order for one camera cell
+struct SortedMesh {
+    int64_t chunkKey;
+    int section;
+    int version;        // SectionMesh::transparentVersion of the mesh that was sorted
+    glm::ivec3 cell;    // The block the camera was in
+    std::vector<Vertex> vertices;
+};
+
+// Sorts a copy of a section's transparent mesh, so that the Chunk may be
+// remeshed or evicted while the worker runs. Terrain looks the Chunk up
+// again by its key and drops the result if the mesh has changed since.
+// A job cancelled before it hands its result in drops it.
+class SortWorker : public Job
+{
+private:
+    SortedMesh m_mesh;
+    glm::vec3 m_eye;
+    std::vector<SortedMesh> *m_sortedMeshes;
+    QMutex *m_sortCompletedLock;
+public:
+    // Sections whose nearest point is this close to the camera are sorted
+    // again whenever the camera enters another block. Farther ones are
+    // only sorted once per mesh, as the order of their faces rarely changes.
+    static constexpr float RESORT_DISTANCE = 48.f;
+
+    SortWorker(std::vector<SortedMesh> *sortedMeshes, QMutex *sortCompletedLock);
+
+    // The mesh the next run() sorts. eye is the camera position
+    // relative to the Chunk's origin.
+    void setMesh(SortedMesh mesh, glm::vec3 eye);
+
+    void run() override;
+
+    // Reorder the quads of vertices from the farthest from eye to the nearest
+    static void sortBackToFront(std::vector<Vertex> &vertices, glm::vec3 eye);
+};
@@ -3,21 +3,89 @@
 #include <stdexcept>
 #include <iostream>
 #include "noise.h"
-#include "blocktypeworker.h"
-#include "scene/populationworker.h"
-#include "scene/vboworker.h"
-#include <QThreadPool>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
 
 
-#define RENDERSIZE 3
-#define GENSIZE (RENDERSIZE+1)
+#define DEFAULT_RENDER_DISTANCE 3
+// Zones this far past the generation ring are kept as well, so that
+// walking back and forth over a zone border does not thrash
+#define EVICT_MARGIN 1
+// GenerateNew() calls between two eviction passes
+#define EVICT_INTERVAL 30
+#define DEFAULT_MEMORY_BUDGET (512 * 1024 * 1024)
+// Jobs per pool thread that may be queued or running at once
+#define JOBS_PER_THREAD 2
+// Sort jobs that may be out at once for each job slot of a worker
+#define SORT_JOBS_PER_THREAD 16
+#define DEFAULT_UPLOAD_BUDGET_MS 2.0
+// How far ahead the player's path is predicted, the zones past the
+// generation ring generated for it at most, and the slowest horizontal
+// speed in blocks per second that is worth predicting
+#define PREFETCH_SECONDS 6.f
+#define PREFETCH_ZONES 12
+#define PREFETCH_MIN_SPEED 4.f
+
+namespace {
+// Jobs in flight with a worker on every core, which the completion queues are sized for
+size_t maxQueuedCompletions() {
+    return JOBS_PER_THREAD * std::max(QThread::idealThreadCount(), 1);
+}
+
+enum JobKind : unsigned char {
+    JOB_TERRAIN, JOB_POPULATION, JOB_MESHING
+};
+
+struct ChunkJob {
+    float priority;
+    JobKind kind;
+    Chunk *chunk;
+
+    bool operator<(const ChunkJob &o) const {
+        return priority < o.priority;
+    }
+};
+}
 
 Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context)
-{}
+    : m_chunks(), m_generatedTerrain(), m_zoneLastUsed(), m_evictedTerrain(), m_generationTick(0),
+      m_meshingMode(MESH_GREEDY), m_memoryBudget(DEFAULT_MEMORY_BUDGET), m_memoryUsage(0), m_gpuMemoryUsage(0), m_meshMemoryUsage(0), m_evictedChunkCount(0), m_reloadedChunkCount(0),
+      m_worldDirectory(), m_regionIO(nullptr), m_loadedChunks(), m_missingChunks(),
+      m_uploadQueue(), m_uploadBudgetMs(DEFAULT_UPLOAD_BUDGET_MS), m_lastUploadCount(0), m_lastUploadMs(0),
+      m_indexBytesSaved(0), m_quadIndices(context), m_vertexArena(context, m_quadIndices),
+      m_drawMeshes(), m_drawBatches(), m_multiDrawCalls(0), m_drawnSections(0), m_transparentOrder(),
+      m_sortedMeshes(), m_SortCompletedLock(), m_sortCell(0), m_sortPending(false), m_sortedMeshCount(0),
+      m_maxJobsInFlight(JOBS_PER_THREAD * JobSystem::defaultWorkerCount()),
+      m_generatedChunks(maxQueuedCompletions()), m_populatedChunks(maxQueuedCompletions()), m_VBOChunks(maxQueuedCompletions()),
+      m_cancelledChunks(maxQueuedCompletions()), m_cancellableJobs(), m_cancelledJobCount(0), m_sorting(),
+      m_zoneNoise(), m_generationJobs(2 * maxQueuedCompletions()), m_populationJobs(2 * maxQueuedCompletions()),
+      m_meshingJobs(2 * maxQueuedCompletions()), m_sortJobs(SORT_JOBS_PER_THREAD * maxQueuedCompletions()), m_jobs(JobSystem::defaultWorkerCount()), m_priority(), m_jobsInFlight(0), m_enteredView(), m_clock(),
+      m_prefetchedZones(), m_prefetchedZoneCount(0), m_droppedZoneCount(0), m_viewRayFrames(0), m_viewRayMisses(0),
+      m_pendingEdits(), m_drawnEdits(), m_editLatency(), m_editRemeshCount(0), m_editDeferCount(0),
+      m_viewFrustum(), m_cullFrustum(), m_frustumFrozen(false), m_drawnBeforeCulling{0, 0, 0}, m_drawnAfterCulling{0, 0, 0},
+      m_renderDistance(DEFAULT_RENDER_DISTANCE), m_renderList(), m_renderListIndex(), m_renderCorner(0, 0), m_renderListValid(false),
+      m_visibleChunks(), mp_context(context), playerCoords(0.f)
+{
+    m_clock.start();
+}
 
 Terrain::~Terrain() {
-
+    // Workers write into Chunks, so they have to finish before the
+    // Chunks are saved and deleted
+    m_jobs.waitForDone();
+    // No worker reads sections any more, so every retired Storage can go
+    ChunkSection::reclaimRetired();
+    ChunkSection::reclaimRetired();
+    if (m_regionIO != nullptr) {
+        for (auto &kv : m_chunks) {
+            saveChunk(std::move(kv.second));
+        }
+        m_regionIO->stop();
+    }
+    m_quadIndices.destroy();
+    m_vertexArena.destroy();
 }
 
 // Combine two 32-bit ints into one 64-bit int
@@ -130,36 +198,251 @@ Chunk* Terrain::instantiateChunkAt(int x, int z) {
     return cPtr;
 }
 
-// TODO: When you make Chunk inherit from Drawable, change this code so
-// it draws each Chunk with the given ShaderProgram, remembering to set the
-// model matrix to the proper X and Z translation!
-void Terrain::draw(ShaderProgram *shaderProgram) {
-    int xCorner = static_cast<int>(glm::floor(playerCoords[0] / 64.f)) *64;
-    int zCorner = static_cast<int>(glm::floor(playerCoords[2] / 64.f)) *64;
+// Draws a mesh of this many indices takes, at most MAX_QUADS quads each
+static int drawCount(int indices) {
+    int quads = indices / 6;
+    return (quads + QuadIndexBuffer::MAX_QUADS - 1) / QuadIndexBuffer::MAX_QUADS;
+}
 
-    for (int x = xCorner - RENDERSIZE *64; x <= xCorner + (RENDERSIZE+1) *64; x+=16){
-        for (int z = zCorner - RENDERSIZE *64; z <= zCorner + (RENDERSIZE+1) *64; z+=16){
-            if (hasChunkAt(x,z)){
-                Chunk * c = getChunkAt(x,z).get();
-                if (c->VBOready){
-                    shaderProgram->drawInterleaved(*c, 0, false);
-                }
+const std::vector<Chunk *> &Terrain::cullChunks(const glm::mat4 &viewProj) {
+    m_viewFrustum = Frustum(viewProj);
+    if (!m_frustumFrozen) {
+        m_cullFrustum = m_viewFrustum;
+    }
+
+    glm::ivec2 corner = 64 * glm::ivec2(glm::floor(glm::vec2(playerCoords[0], playerCoords[2]) / 64.f));
+    if (!m_renderListValid || corner != m_renderCorner) {
+        m_renderCorner = corner;
+        rebuildRenderList();
+    }
+
+    m_drawnBeforeCulling = {0, 0, 0};
+    m_drawnAfterCulling = {0, 0, 0};
+    m_visibleChunks.clear();
+    for (const RenderEntry &e : m_renderList) {
+        m_drawnBeforeCulling.chunks++;
+        m_drawnBeforeCulling.draws += e.draws;
+        m_drawnBeforeCulling.triangles += e.triangles;
+        if (m_cullFrustum.intersects(e.min, e.max)){
+            m_visibleChunks.push_back(e.chunk);
+            m_drawnAfterCulling.chunks++;
+            m_drawnAfterCulling.draws += e.draws;
+            m_drawnAfterCulling.triangles += e.triangles;
+        }
+    }
+    return m_visibleChunks;
+}
+
+void Terrain::draw(ShaderProgram *shaderProgram, const glm::mat4 &viewProj, glm::vec3 eye) {
+    meshEdits();
+    const std::vector<Chunk *> &visible = cullChunks(viewProj);
+    updateTransparentSort(eye);
+    m_multiDrawCalls = 0;
+    m_drawnSections = 0;
+
+    // All opaque meshes of the sections in view first, in any order.
+    // The transparent ones are blended over them, farthest section first.
+    // The quads within each mesh are kept in back to front order by
+    // updateTransparentSort().
+    m_drawMeshes.clear();
+    m_transparentOrder.clear();
+    for (Chunk *c : visible) {
+        for (const SectionMesh &m : c->sectionMeshes) {
+            if (m.minY > m.maxY
+                    || !m_cullFrustum.intersects(glm::vec3(c->minX, m.minY, c->minZ), glm::vec3(c->minX + 16, m.maxY, c->minZ + 16))) {
+                continue;
+            }
+            m_drawnSections++;
+            m_drawMeshes.push_back(m.opaque);
+            if (m.transparent != VertexArena::NO_MESH) {
+                glm::vec3 d = glm::vec3(c->minX + 8, (m.minY + m.maxY) * 0.5f, c->minZ + 8) - eye;
+                m_transparentOrder.push_back(std::make_pair(glm::dot(d, d), m.transparent));
             }
         }
     }
+    m_vertexArena.batches(m_drawMeshes, m_drawBatches);
+    for (const VertexArena::Batch &b : m_drawBatches) {
+        m_multiDrawCalls += !b.counts.empty();
+    }
+    shaderProgram->drawArena(m_drawBatches, 0, 1);
 
-    for (int x = xCorner - RENDERSIZE *64; x <= xCorner + (RENDERSIZE+1) *64; x+=16){
-        for (int z = zCorner - RENDERSIZE *64; z <= zCorner + (RENDERSIZE+1) *64; z+=16){
-            if (hasChunkAt(x,z)){
-                Chunk * c = getChunkAt(x,z).get();
-                if (c->VBOready){
-                    shaderProgram->drawInterleaved(*c, 0, true);
-                }
+    std::sort(m_transparentOrder.begin(), m_transparentOrder.end(),
+              [](const std::pair<float, VertexArena::Handle> &a, const std::pair<float, VertexArena::Handle> &b) {
+        return a.first > b.first;
+    });
+    m_drawMeshes.clear();
+    for (const auto &pm : m_transparentOrder) {
+        m_drawMeshes.push_back(pm.second);
+    }
+    m_vertexArena.batches(m_drawMeshes, m_drawBatches, true);
+    for (const VertexArena::Batch &b : m_drawBatches) {
+        m_multiDrawCalls += !b.counts.empty();
+    }
+    shaderProgram->drawArena(m_drawBatches, 0, 1);
+}
+
+void Terrain::updateTransparentSort(glm::vec3 eye) {
+    m_SortCompletedLock.lock();
+    std::vector<SortedMesh> sorted;
+    sorted.swap(m_sortedMeshes);
+    m_SortCompletedLock.unlock();
+
+    // The Chunk may have been remeshed or evicted while its quads were sorted
+    for (SortedMesh &m : sorted) {
+        m_sorting.erase(std::make_pair(m.chunkKey, m.section));
+        auto it = m_chunks.find(m.chunkKey);
+        if (it == m_chunks.end()) {
+            continue;
+        }
+        Chunk *c = it->second.get();
+        SectionMesh &mesh = c->sectionMeshes[m.section];
+        // A Chunk created under the key of an evicted one counts its
+        // versions from 0 again, so the size is checked as well
+        if (!c->VBOready || mesh.transparentVersion != m.version || mesh.transparent == VertexArena::NO_MESH
+                || static_cast<int>(m.vertices.size()) != m_vertexArena.vertexCount(mesh.transparent)) {
+            continue;
+        }
+        m_vertexArena.update(mesh.transparent, m.vertices);
+        mesh.transparentVertices = std::move(m.vertices);
+        mesh.sortedVersion = m.version;
+        mesh.sortedCell = m.cell;
+        m_sortedMeshCount++;
+    }
+    m_sortPending |= !sorted.empty();
+
+    glm::ivec3 cell = glm::ivec3(glm::floor(eye));
+    if (cell == m_sortCell && !m_sortPending) {
+        return;
+    }
+    m_sortCell = cell;
+    m_sortPending = false;
+    for (const RenderEntry &e : m_renderList) {
+        if (!e.transparent) {
+            continue;
+        }
+        Chunk *c = e.chunk;
+        int64_t key = toKey(c->minX, c->minZ);
+        for (int s = 0; s < 16; s++) {
+            const SectionMesh &m = c->sectionMeshes[s];
+            if (m.transparent == VertexArena::NO_MESH) {
+                continue;
+            }
+            glm::vec3 nearest = glm::clamp(eye, glm::vec3(c->minX, m.minY, c->minZ), glm::vec3(c->minX + 16, m.maxY, c->minZ + 16));
+            bool near = glm::distance(eye, nearest) <= SortWorker::RESORT_DISTANCE;
+            if (m.sortedVersion == m.transparentVersion && (!near || m.sortedCell == cell)) {
+                continue;
+            }
+            // A mesh already being sorted is looked at again once its result is in
+            if (m_sorting.count(std::make_pair(key, s)) > 0) {
+                continue;
+            }
+            SortWorker *worker = m_sortJobs.acquire(&m_sortedMeshes, &m_SortCompletedLock);
+            if (worker == nullptr) {
+                m_sortPending = true;
+                return;
+            }
+            worker->setMesh({key, s, m.transparentVersion, cell, m.transparentVertices}, eye - glm::vec3(c->minX, 0, c->minZ));
+            m_sorting[std::make_pair(key, s)] = Submission{worker, worker->ticket()};
+            m_jobs.submit(worker);
+        }
+    }
+}
+
+void Terrain::forgetSorts(const std::vector<int64_t> &chunkKeys) {
+    if (chunkKeys.empty()) {
+        return;
+    }
+    auto removed = [&chunkKeys](int64_t key) {
+        return std::find(chunkKeys.begin(), chunkKeys.end(), key) != chunkKeys.end();
+    };
+    for (auto it = m_sorting.begin(); it != m_sorting.end(); ) {
+        if (removed(it->first.first)) {
+            // A no-op once the job finished and was reused
+            it->second.job->cancel(it->second.ticket);
+            it = m_sorting.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    m_SortCompletedLock.lock();
+    m_sortedMeshes.erase(std::remove_if(m_sortedMeshes.begin(), m_sortedMeshes.end(), [&removed](const SortedMesh &m) {
+        return removed(m.chunkKey);
+    }), m_sortedMeshes.end());
+    m_SortCompletedLock.unlock();
+}
+
+bool Terrain::inRenderRange(const Chunk *c) const {
+    return c->minX >= m_renderCorner.x - m_renderDistance * 64 && c->minX <= m_renderCorner.x + (m_renderDistance + 1) * 64
+            && c->minZ >= m_renderCorner.y - m_renderDistance * 64 && c->minZ <= m_renderCorner.y + (m_renderDistance + 1) * 64;
+}
+
+void Terrain::addToRenderList(Chunk *c) {
+    if (!m_renderListValid || !inRenderRange(c)) {
+        return;
+    }
+    // A Chunk whose mesh is empty has nothing to draw
+    if (c->meshMinY > c->meshMaxY) {
+        removeFromRenderList(c);
+        return;
+    }
+    // Every section mesh is drawn on its own
+    int draws = 0;
+    bool transparent = false;
+    for (const SectionMesh &m : c->sectionMeshes) {
+        draws += drawCount(m.opaqueVertices / 4 * 6) + drawCount(static_cast<int>(m.transparentVertices.size()) / 4 * 6);
+        transparent |= m.transparent != VertexArena::NO_MESH;
+    }
+    RenderEntry e = {c, glm::vec3(c->minX, c->meshMinY, c->minZ), glm::vec3(c->minX + 16, c->meshMaxY, c->minZ + 16),
+                     draws, (c->elemCountOpaque() + c->elemCountTransparrent()) / 3, transparent};
+    // A new mesh has its transparent quads in meshing order
+    m_sortPending |= e.transparent;
+    auto it = m_renderListIndex.find(c);
+    if (it != m_renderListIndex.end()) {
+        m_renderList[it->second] = e;
+    } else {
+        m_renderListIndex[c] = m_renderList.size();
+        m_renderList.push_back(e);
+    }
+}
+
+void Terrain::removeFromRenderList(Chunk *c) {
+    auto it = m_renderListIndex.find(c);
+    if (it == m_renderListIndex.end()) {
+        return;
+    }
+    // Move the last entry into the hole
+    size_t i = it->second;
+    m_renderListIndex.erase(it);
+    if (i + 1 != m_renderList.size()) {
+        m_renderList[i] = m_renderList.back();
+        m_renderListIndex[m_renderList[i].chunk] = i;
+    }
+    m_renderList.pop_back();
+}
+
+void Terrain::rebuildRenderList() {
+    m_renderList.clear();
+    m_renderListIndex.clear();
+    m_renderListValid = true;
+    m_sortPending = true;
+    for (int x = m_renderCorner.x - m_renderDistance * 64; x <= m_renderCorner.x + (m_renderDistance + 1) * 64; x += 16) {
+        for (int z = m_renderCorner.y - m_renderDistance * 64; z <= m_renderCorner.y + (m_renderDistance + 1) * 64; z += 16) {
+            auto it = m_chunks.find(toKey(x, z));
+            if (it != m_chunks.end() && it->second->VBOready) {
+                addToRenderList(it->second.get());
             }
         }
     }
 }
 
+void Terrain::setFrustumFrozen(bool frozen) {
+    m_frustumFrozen = frozen;
+}
+
+bool Terrain::frustumFrozen() const {
+    return m_frustumFrozen;
+}
+
 void Terrain::checkVBOState(Chunk *c ){
     if (c->VBOdirty == true && c->VBOState != VBO_RUNNING){
         m_VBOGenerationQueue.insert(c);
@@ -171,37 +454,56 @@ void Terrain::checkVBOState(Chunk *c ){
 }
 
 void Terrain::updateGenerationThreads(){
-    m_TerrainGenLock.lock();
+    // Chunks read from disk were saved fully populated
+    m_LoadCompletedLock.lock();
+    for (auto it = m_loadedChunks.begin(); it != m_loadedChunks.end(); ) {
+        (*it)->genState = GEN_COMPLETE;
+        it = m_loadedChunks.erase(it);
+    }
+    for (auto it = m_missingChunks.begin(); it != m_missingChunks.end(); ) {
+        (*it)->genState = UNGENERATED;
+        m_TerrainQueue.insert(*it);
+        it = m_missingChunks.erase(it);
+    }
+    m_LoadCompletedLock.unlock();
 
-    for (auto it = m_generatedChunks.begin(); it != m_generatedChunks.end(); ) {
-        Chunk *c = (*it);
+    Chunk *c;
+    while (m_generatedChunks.pop(c)) {
         c->genState = TERRAIN_DONE;
-        it = m_generatedChunks.erase(it);
         m_PopulatonQueue.insert(c);
+        m_cancellableJobs.erase(c);
+        m_jobsInFlight--;
     }
-    m_TerrainGenLock.unlock();
 
-    for(auto it = m_PopulatonQueue.begin(); it != m_PopulatonQueue.end(); ) {
-        Chunk *c = (*it);
-        if (checkNeighborStatusPopulation(c)){
-            spanwnPopulationWorker(c);
-            it = m_PopulatonQueue.erase(it);
-        } else{
-            it++;
+    while (m_cancelledChunks.pop(c)) {
+        m_cancellableJobs.erase(c);
+        m_cancelledJobCount++;
+        m_jobsInFlight--;
+        if (c->genState == TERRAIN_RUNNING) {
+            // Generated once its zone is back in the generation ring
+            c->genState = UNGENERATED;
+            m_TerrainQueue.insert(c);
+        } else {
+            // A Chunk in m_VBODeletionQueue is let go of like one that was
+            // never handed to a worker. One that came back into view after
+            // its job was cancelled is meshed again.
+            c->markDirty(c->VBOdata.sections);
+            c->VBOState = VBO_WAITING;
+            if (m_VBODeletionQueue.count(c) == 0) {
+                m_VBOGenerationQueue.insert(c);
+            }
         }
     }
 
-    m_PopulationGenLock.lock();
-    for (auto it = m_populatedChunks.begin(); it != m_populatedChunks.end(); ) {
-        Chunk *c = (*it);
+    while (m_populatedChunks.pop(c)) {
         c->genState = GEN_COMPLETE;
-        it = m_populatedChunks.erase(it);
+        c->saveDirty = true;
+        m_jobsInFlight--;
     }
-    m_PopulationGenLock.unlock();
 
 }
 
-void Terrain::setBlockAt(int x, int y, int z, BlockType t)
+void Terrain::setBlockAt(int x, int y, int z, BlockType t, std::vector<Chunk *> *dirtied)
 {
     if(hasChunkAt(x, z)) {
         uPtr<Chunk> &c = getChunkAt(x, z);
@@ -210,20 +512,34 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
                       static_cast<unsigned int>(y),
                       static_cast<unsigned int>(z - chunkOrigin.y),
                       t);
-        c->VBOdirty = true;
+        // Only the block's own section, and the one above or below if the
+        // block is on its edge, show or hide different faces
+        c->markDirty(Chunk::sectionsAround(y));
+        c->saveDirty = true;
+        if (dirtied != nullptr) {
+            dirtied->push_back(c.get());
+        }
 
-        // if x, y is at the boundary of a chunk, redraw the neighboring chunk as well
+        // if x, y is at the boundary of a chunk, redraw the section of the neighboring chunk next to it as well
+        uint16_t section = 1 << (y / 16);
+        auto markNeighbor = [&](int dx, int dz) {
+            Chunk *n = getChunkAt(chunkOrigin[0] + dx, chunkOrigin[1] + dz).get();
+            n->markDirty(section);
+            if (dirtied != nullptr) {
+                dirtied->push_back(n);
+            }
+        };
         if (x % 16 == 0 && hasChunkAt(x - 1, z) && getBlockAt(x - 1, y, z) != EMPTY) {
-            getChunkAt(chunkOrigin[0] - 16, chunkOrigin[1])->VBOdirty = true;
+            markNeighbor(-16, 0);
         }
         if ((x+1) % 16 == 0  && hasChunkAt(x + 1, z) && getBlockAt(x + 1, y, z) != EMPTY) {
-            getChunkAt(chunkOrigin[0] + 16, chunkOrigin[1])->VBOdirty = true;
+            markNeighbor(16, 0);
         }
         if (z % 16 == 0  && hasChunkAt(x, z - 1) && getBlockAt(x, y, z - 1) != EMPTY) {
-            getChunkAt(chunkOrigin[0], chunkOrigin[1] - 16)->VBOdirty = true;
+            markNeighbor(0, -16);
         }
         if ((z + 1) % 16 == 0  && hasChunkAt(x, z + 1) && getBlockAt(x, y, z + 1) != EMPTY) {
-            getChunkAt(chunkOrigin[0], chunkOrigin[1] + 16)->VBOdirty = true;
+            markNeighbor(0, 16);
         }
     }
     else {
@@ -233,47 +549,178 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t)
     }
 }
 
+void Terrain::editBlockAt(int x, int y, int z, BlockType t) {
+    BlockEdit edit = {m_clock.nsecsElapsed(), {}};
+    setBlockAt(x, y, z, t, &edit.chunks);
+    m_pendingEdits.push_back(edit);
+}
+
+void Terrain::meshEdits() {
+    if (m_pendingEdits.empty()) {
+        return;
+    }
+    // Chunks of several edits are meshed once
+    std::unordered_map<Chunk *, bool> meshed;
+    for (BlockEdit &edit : m_pendingEdits) {
+        for (auto it = edit.chunks.begin(); it != edit.chunks.end(); ) {
+            auto m = meshed.find(*it);
+            bool done = m != meshed.end() ? m->second : (meshed[*it] = remeshNow(*it));
+            it = done ? edit.chunks.erase(it) : it + 1;
+        }
+    }
+    for (const auto &m : meshed) {
+        m_editDeferCount += !m.second;
+    }
+    for (auto it = m_pendingEdits.begin(); it != m_pendingEdits.end(); ) {
+        if (it->chunks.empty()) {
+            m_drawnEdits.push_back(it->time);
+            it = m_pendingEdits.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool Terrain::remeshNow(Chunk *c) {
+    // A Chunk without a mesh is not drawn, so there is nothing to show
+    // until the meshing workers mesh it whole
+    if (!c->VBOready) {
+        return true;
+    }
+    // A worker may be meshing the Chunk, or populating a neighbor and
+    // writing into it. The edit waits for the worker to finish.
+    if (c->VBOState == VBO_RUNNING || !checkNeighborStatus(c, GEN_COMPLETE)) {
+        return false;
+    }
+    if (c->dirtySections != 0) {
+        c->meshingMode = m_meshingMode;
+        c->VBOdirty = false;
+        c->VBOdata.sections = c->dirtySections.exchange(0);
+        c->createVBOdata();
+        c->SendVBOdata(m_vertexArena);
+        m_VBOGenerationQueue.erase(c);
+        addToRenderList(c);
+        m_editRemeshCount++;
+    }
+    return true;
+}
+
+void Terrain::framePresented() {
+    qint64 now = m_clock.nsecsElapsed();
+    for (qint64 time : m_drawnEdits) {
+        m_editLatency.add((now - time) * 1e-6);
+    }
+    m_drawnEdits.clear();
+}
+
 void Terrain::spanwGenerationWorker(int64_t terrainGenZone){
     m_generatedTerrain.insert(terrainGenZone);
-    std::vector<Chunk *> chunksToGen;
+    if (m_evictedTerrain.erase(terrainGenZone) > 0) {
+        m_reloadedChunkCount += 16;
+    }
+    std::vector<std::pair<float, Chunk *>> chunksToGen;
     glm::ivec2 coords = toCoords(terrainGenZone);
     for(int x = coords.x; x< coords.x +64; x += 16){
         for(int z = coords.y; z< coords.y +64; z += 16){
             Chunk * c = instantiateChunkAt(x, z);
-            c->genState = TERRAIN_RUNNING;
-            chunksToGen.push_back(c);
+            chunksToGen.push_back(std::make_pair(m_priority.priority(x, z), c));
         }
     }
+    std::sort(chunksToGen.begin(), chunksToGen.end());
 
-    BlockTypeWorker * worker = new BlockTypeWorker(coords.x, coords.y, chunksToGen,
-                                                   &m_generatedChunks, &m_TerrainGenLock);
-    QThreadPool::globalInstance()->start(worker);
+    // Chunks that were saved before are loaded instead of generated.
+    // The ones the region file does not have come back through m_missingChunks.
+    for (const auto &pc : chunksToGen) {
+        Chunk *c = pc.second;
+        if (m_regionIO != nullptr) {
+            c->genState = LOAD_RUNNING;
+            m_regionIO->requestLoad(c);
+        } else {
+            m_TerrainQueue.insert(c);
+        }
+    }
+}
 
+bool Terrain::spawnBlockTypeWorker(Chunk *chunk){
+    BlockTypeWorker * worker = m_generationJobs.acquire(&m_generatedChunks, &m_cancelledChunks, &m_generationLatency, &m_zoneNoise);
+    if (worker == nullptr) {
+        return false;
+    }
+    chunk->genState = TERRAIN_RUNNING;
+    worker->setChunks({chunk});
+    m_cancellableJobs[chunk] = {worker, worker->ticket()};
+    m_jobs.submit(worker);
+    m_jobsInFlight++;
+    return true;
 }
 
-void Terrain::spanwnPopulationWorker(Chunk * chunk){
+void Terrain::saveChunk(uPtr<Chunk> c){
+    if (c->genState == GEN_COMPLETE && c->saveDirty) {
+        m_regionIO->requestSave(std::move(c));
+    }
+}
 
-    populationworker * worker = new populationworker(chunk,&m_populatedChunks, &m_PopulationGenLock);
-    chunk->genState = POPULATION_RUNNING;
-    QThreadPool::globalInstance()->start(worker);
+bool Terrain::spanwnPopulationWorker(Chunk * chunk){
 
+    populationworker * worker = m_populationJobs.acquire(&m_populatedChunks);
+    if (worker == nullptr) {
+        return false;
+    }
+    worker->setChunk(chunk);
+    chunk->genState = POPULATION_RUNNING;
+    m_jobs.submit(worker);
+    m_jobsInFlight++;
+    return true;
 }
 
-void Terrain::spawnVBOWorker(Chunk * chunk){
-    VBOWorker * worker = new VBOWorker(chunk, &m_VBOChunks, &m_VBOCompletedLock);
+bool Terrain::spawnVBOWorker(Chunk * chunk){
+    VBOWorker * worker = m_meshingJobs.acquire(&m_VBOChunks, &m_cancelledChunks);
+    if (worker == nullptr) {
+        return false;
+    }
+    worker->setChunk(chunk);
     chunk->VBOState = VBO_RUNNING;
-    QThreadPool::globalInstance()->start(worker);
+    chunk->meshingMode = m_meshingMode;
+    // A Chunk without meshes is meshed whole, otherwise only the sections
+    // edited since they were last handed to a worker
+    uint16_t dirty = chunk->dirtySections.exchange(0);
+    chunk->VBOdata.sections = chunk->VBOready ? dirty : ALL_SECTIONS;
+    m_cancellableJobs[chunk] = {worker, worker->ticket()};
+    m_jobs.submit(worker);
+    m_jobsInFlight++;
+    return true;
 }
 
 void Terrain::updateVBOThreads(){
-    m_VBOCompletedLock.lock();
-
-    for (auto it = m_VBOChunks.begin(); it != m_VBOChunks.end(); ) {
-        (*it)->SendVBOdata();
-        it = m_VBOChunks.erase(it);
+    size_t firstMeshed = m_uploadQueue.size();
+    m_jobsInFlight -= static_cast<int>(m_VBOChunks.popAll(m_uploadQueue));
+    for (size_t i = firstMeshed; i < m_uploadQueue.size(); i++) {
+        m_cancellableJobs.erase(m_uploadQueue[i]);
     }
-    m_VBOCompletedLock.unlock();
 
+    // Highest priority last, so uploads pop from the back
+    std::sort(m_uploadQueue.begin(), m_uploadQueue.end(), [this](const Chunk *a, const Chunk *b) {
+        return m_priority.priority(a->minX, a->minZ) > m_priority.priority(b->minX, b->minZ);
+    });
+
+    // Stop before an upload of average length would overrun the budget
+    double averageMs = m_uploadLatency.averageMs();
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+    m_lastUploadCount = 0;
+    while (!m_uploadQueue.empty()
+           && (m_lastUploadCount == 0 || tickTimer.nsecsElapsed() * 1e-6 + averageMs <= m_uploadBudgetMs)) {
+        Chunk *c = m_uploadQueue.back();
+        m_uploadQueue.pop_back();
+        m_indexBytesSaved += c->meshedVertexCount() / 4 * 6 * sizeof(GLuint);
+        QElapsedTimer timer;
+        timer.start();
+        c->SendVBOdata(m_vertexArena);
+        m_uploadLatency.add(timer.nsecsElapsed() * 1e-6);
+        addToRenderList(c);
+        m_lastUploadCount++;
+    }
+    m_lastUploadMs = tickTimer.nsecsElapsed() * 1e-6;
 }
 
 bool Terrain::checkNeighborStatus(Chunk * c, GenState status){
@@ -302,13 +749,15 @@ void Terrain::updateVBOGenQueue(){
     for(auto it = m_VBODeletionQueue.begin(); it != m_VBODeletionQueue.end(); ) {
         Chunk *c = (*it);
         if (c->VBOState == VBO_DONE){
-            c->deleteVBOdata();
+            removeFromRenderList(c);
+            c->deleteVBOdata(m_vertexArena);
             it = m_VBODeletionQueue.erase(it);
         } else if(c->VBOState == VBO_WAITING){
             m_VBOGenerationQueue.erase(c);
             c->VBOState = VBO_NONE;
             if (c->VBOready){
-                c->deleteVBOdata();
+                removeFromRenderList(c);
+                c->deleteVBOdata(m_vertexArena);
             }
             it = m_VBODeletionQueue.erase(it);
         } else if (c->VBOState == VBO_RUNNING){
@@ -317,16 +766,108 @@ void Terrain::updateVBOGenQueue(){
             throw std::logic_error("continuty error in VBO deletion Queue");
         }
     }
+}
 
-    for(auto it = m_VBOGenerationQueue.begin(); it != m_VBOGenerationQueue.end(); ) {
-        Chunk *c = (*it);
-        if (checkNeighborStatus(c, GEN_COMPLETE) && c->VBOState != VBO_RUNNING){
-            spawnVBOWorker(c);
-            it = m_VBOGenerationQueue.erase(it);
-        } else {
-            ++it;
+void Terrain::dispatchJobs(){
+    int freeSlots = m_maxJobsInFlight - m_jobsInFlight;
+    if (freeSlots <= 0) {
+        return;
+    }
+
+    std::vector<ChunkJob> jobs;
+    for (Chunk *c : m_TerrainQueue) {
+        if (!inGenerationRing(c)) {
+            continue;
+        }
+        jobs.push_back({m_priority.priority(c->minX, c->minZ), JOB_TERRAIN, c});
+    }
+    for (Chunk *c : m_PopulatonQueue) {
+        if (checkNeighborStatusPopulation(c)) {
+            jobs.push_back({m_priority.priority(c->minX, c->minZ), JOB_POPULATION, c});
+        }
+    }
+    for (Chunk *c : m_VBOGenerationQueue) {
+        if (checkNeighborStatus(c, GEN_COMPLETE) && c->VBOState != VBO_RUNNING) {
+            jobs.push_back({m_priority.priority(c->minX, c->minZ), JOB_MESHING, c});
         }
     }
+    std::sort(jobs.begin(), jobs.end());
+
+    for (const ChunkJob &job : jobs) {
+        if (freeSlots == 0) {
+            break;
+        }
+        Chunk *c = job.chunk;
+        // Starting a job changes the state its neighbors' jobs wait on:
+        // a Chunk being populated writes into its neighbors, so they may
+        // be neither populated nor meshed at the same time
+        switch (job.kind) {
+        case JOB_TERRAIN:
+            if (!spawnBlockTypeWorker(c)) {
+                continue;
+            }
+            m_TerrainQueue.erase(c);
+            break;
+        case JOB_POPULATION:
+            if (!checkNeighborStatusPopulation(c) || !spanwnPopulationWorker(c)) {
+                continue;
+            }
+            m_PopulatonQueue.erase(c);
+            break;
+        case JOB_MESHING:
+            if (!checkNeighborStatus(c, GEN_COMPLETE) || !spawnVBOWorker(c)) {
+                continue;
+            }
+            m_VBOGenerationQueue.erase(c);
+            break;
+        }
+        freeSlots--;
+    }
+}
+
+bool Terrain::inGenerationRing(const Chunk *c) const {
+    int zoneX = static_cast<int>(glm::floor(c->minX / 64.f)) * 64;
+    int zoneZ = static_cast<int>(glm::floor(c->minZ / 64.f)) * 64;
+    auto it = m_zoneLastUsed.find(toKey(zoneX, zoneZ));
+    return it != m_zoneLastUsed.end() && it->second == m_generationTick;
+}
+
+void Terrain::cancelUnneededJobs() {
+    for (const auto &kv : m_cancellableJobs) {
+        Chunk *c = kv.first;
+        bool unneeded = c->genState == TERRAIN_RUNNING ? !inGenerationRing(c)
+                                                       : m_VBODeletionQueue.count(c) > 0;
+        if (unneeded) {
+            // A no-op once the job was reused for another Chunk
+            kv.second.job->cancel(kv.second.ticket);
+        }
+    }
+}
+
+void Terrain::updateTimeToVisible(){
+    int xCorner = static_cast<int>(glm::floor(playerCoords[0] / 64.f)) *64;
+    int zCorner = static_cast<int>(glm::floor(playerCoords[2] / 64.f)) *64;
+    qint64 now = m_clock.elapsed();
+
+    // Chunks that leave the view before they can be drawn are forgotten
+    std::unordered_map<int64_t, qint64> waiting;
+    for (int x = xCorner - m_renderDistance *64; x <= xCorner + (m_renderDistance+1) *64; x+=16){
+        for (int z = zCorner - m_renderDistance *64; z <= zCorner + (m_renderDistance+1) *64; z+=16){
+            if (!m_viewFrustum.intersects(glm::vec3(x, 0, z), glm::vec3(x + 16, 256, z + 16))) {
+                continue;
+            }
+            int64_t key = toKey(x, z);
+            auto it = m_enteredView.find(key);
+            if (hasChunkAt(x, z) && getChunkAt(x, z)->VBOready) {
+                if (it != m_enteredView.end()) {
+                    m_timeToVisible.add(static_cast<double>(now - it->second));
+                }
+            } else {
+                waiting[key] = it != m_enteredView.end() ? it->second : now;
+            }
+        }
+    }
+    m_enteredView = std::move(waiting);
 }
 
 glm::vec2 Terrain::IntertiaCenter(glm::vec3 playerPos){
@@ -337,21 +878,124 @@ glm::vec2 Terrain::IntertiaCenter(glm::vec3 playerPos){
     return m_playerInertia;
 }
 
-void Terrain::GenerateNew(glm::vec3 playerPos){
+std::vector<int64_t> Terrain::predictedZones(glm::vec3 playerPos, glm::vec3 velocity,
+                                             int xCorner, int zCorner, int genSize) const {
+    std::vector<int64_t> zones;
+    glm::vec2 v(velocity.x, velocity.z);
+    float speed = glm::length(v);
+    if (speed < PREFETCH_MIN_SPEED) {
+        return zones;
+    }
+    auto inRing = [genSize](int x, int z, int ringX, int ringZ) {
+        return x >= ringX - genSize * 64 && x <= ringX + (genSize + 1) * 64
+            && z >= ringZ - genSize * 64 && z <= ringZ + (genSize + 1) * 64;
+    };
+
+    // Step along the path a Chunk at a time. Each time it crosses into
+    // another zone, the zones its ring adds are needed next, the ones
+    // nearest the path first.
+    glm::vec2 pos(playerPos.x, playerPos.z);
+    glm::vec2 dir = v / speed;
+    float reach = speed * PREFETCH_SECONDS;
+    glm::ivec2 lastCorner(xCorner, zCorner);
+    for (float d = 16.f; d <= reach && zones.size() < PREFETCH_ZONES; d += 16.f) {
+        glm::vec2 p = pos + dir * d;
+        glm::ivec2 corner = 64 * glm::ivec2(glm::floor(p / 64.f));
+        if (corner == lastCorner) {
+            continue;
+        }
+        lastCorner = corner;
+
+        std::vector<std::pair<float, int64_t>> added;
+        for (int x = corner.x - genSize * 64; x <= corner.x + (genSize + 1) * 64; x += 64) {
+            for (int z = corner.y - genSize * 64; z <= corner.y + (genSize + 1) * 64; z += 64) {
+                int64_t key = toKey(x, z);
+                if (!inRing(x, z, xCorner, zCorner)
+                        && std::find(zones.begin(), zones.end(), key) == zones.end()) {
+                    added.push_back(std::make_pair(glm::distance2(glm::vec2(x + 32, z + 32), p), key));
+                }
+            }
+        }
+        std::sort(added.begin(), added.end());
+        for (const auto &zone : added) {
+            if (zones.size() == PREFETCH_ZONES) {
+                break;
+            }
+            zones.push_back(zone.second);
+        }
+    }
+    return zones;
+}
+
+void Terrain::updateViewRayMisses(glm::vec3 playerPos, glm::vec3 viewDir) {
+    m_viewRayFrames++;
+    glm::vec2 dir(viewDir.x, viewDir.z);
+    // Looking straight up or down, the ray stays over the player's Chunk
+    float length = glm::length(dir);
+    float reach = length > 0.01f ? m_renderDistance * 64.f : 0.f;
+    dir = length > 0.01f ? dir / length : glm::vec2(0.f);
+    for (float d = 0.f; d <= reach; d += 8.f) {
+        glm::vec2 p = glm::vec2(playerPos.x, playerPos.z) + dir * d;
+        int x = static_cast<int>(glm::floor(p.x / 16.f)) * 16;
+        int z = static_cast<int>(glm::floor(p.y / 16.f)) * 16;
+        if (!hasChunkAt(x, z) || !getChunkAt(x, z)->VBOready) {
+            m_viewRayMisses++;
+            return;
+        }
+    }
+}
+
+void Terrain::GenerateNew(glm::vec3 playerPos, glm::vec3 viewDir, glm::vec3 velocity){
+    if (m_regionIO == nullptr && !m_worldDirectory.isEmpty()) {
+        m_regionIO = mkU<RegionIO>(m_worldDirectory, &m_loadedChunks, &m_missingChunks,
+                                   &m_LoadCompletedLock, &m_loadLatency);
+        m_regionIO->start();
+    }
+
+    // Storage that workers replaced while this thread edited is freed
+    // once the jobs that could be reading it have finished
+    ChunkSection::reclaimRetired();
 
     playerCoords = playerPos;
+    m_priority.update(playerPos, viewDir);
     int xCorner = static_cast<int>(glm::floor(playerPos[0] / 64.f)) *64;
     int zCorner = static_cast<int>(glm::floor(playerPos[2] / 64.f)) *64;
 
-    for (int x = xCorner - GENSIZE * 64; x <= xCorner + (GENSIZE+1) *64; x+=64){
-        for (int z = zCorner - GENSIZE * 64; z <= zCorner + (GENSIZE+1) *64; z+=64){
+    int genSize = m_renderDistance + 1;
+    m_generationTick++;
+    std::vector<std::pair<float, int64_t>> newZones;
+    for (int x = xCorner - genSize * 64; x <= xCorner + (genSize+1) *64; x+=64){
+        for (int z = zCorner - genSize * 64; z <= zCorner + (genSize+1) *64; z+=64){
             int64_t key =  toKey(x, z);
+            m_zoneLastUsed[key] = m_generationTick;
+            m_prefetchedZones.erase(key);
             if(m_generatedTerrain.count(key) == 0){
-                spanwGenerationWorker(key);
-
+                newZones.push_back(std::make_pair(m_priority.priority(x, z, 64), key));
             }
         }
     }
+    // Zones ahead of the ring only stay in use while the prediction holds.
+    // Once the player turns, cancelUnneededJobs() drops their generation
+    // like that of any zone left behind, and dropAbandonedZones() the
+    // zones that got nowhere. No new zone is predicted while PREFETCH_ZONES
+    // of them are still waiting for the ring to reach them.
+    for (int64_t key : predictedZones(playerPos, velocity, xCorner, zCorner, genSize)) {
+        if (m_generatedTerrain.count(key) != 0) {
+            m_zoneLastUsed[key] = m_generationTick;
+        } else if (m_prefetchedZones.size() < PREFETCH_ZONES) {
+            m_zoneLastUsed[key] = m_generationTick;
+            m_prefetchedZones.insert(key);
+            glm::ivec2 coords = toCoords(key);
+            newZones.push_back(std::make_pair(m_priority.priority(coords.x, coords.y, 64), key));
+            m_prefetchedZoneCount++;
+        }
+    }
+    std::sort(newZones.begin(), newZones.end());
+    for (const auto &zone : newZones) {
+        spanwGenerationWorker(zone.second);
+    }
+    int playerZoneX = xCorner;
+    int playerZoneZ = zCorner;
 
     glm::vec2 intertiaCenter = IntertiaCenter(playerPos);
 
@@ -360,8 +1004,8 @@ void Terrain::GenerateNew(glm::vec3 playerPos){
     xCorner = static_cast<int>(glm::floor(intertiaCenter[0] / 16.f)) *16;
     zCorner = static_cast<int>(glm::floor(intertiaCenter[1] / 16.f)) *16;
 
-    for (int x = xCorner - GENSIZE * 64; x <= xCorner + (GENSIZE+1) *64; x+=16){
-        for (int z = zCorner - GENSIZE * 64; z <= zCorner + (GENSIZE+1) *64; z+=16){
+    for (int x = xCorner - genSize * 64; x <= xCorner + (genSize+1) *64; x+=16){
+        for (int z = zCorner - genSize * 64; z <= zCorner + (genSize+1) *64; z+=16){
             if (hasChunkAt(x,z)){
                 int64_t key =  toKey(x, z);
                 Chunk * c = getChunkAt(x,z).get();
@@ -383,8 +1027,303 @@ void Terrain::GenerateNew(glm::vec3 playerPos){
 
     m_chunksLastGen = currDrawChunks;
 
+    cancelUnneededJobs();
     updateGenerationThreads();
+    dropAbandonedZones();
     updateVBOThreads();
     updateVBOGenQueue();
+    dispatchJobs();
+    updateTimeToVisible();
+    updateViewRayMisses(playerPos, viewDir);
+
+    if (m_generationTick % EVICT_INTERVAL == 0) {
+        evictZones(playerZoneX, playerZoneZ);
+    }
+}
+
+bool Terrain::canEvictZone(int64_t terrainGenZone) const {
+    glm::ivec2 coords = toCoords(terrainGenZone);
+    // Population writes into all eight surrounding Chunks and meshing reads
+    // the four adjacent ones, so the ring of Chunks around the zone must
+    // be idle as well. Work that is already running cannot be cancelled,
+    // so a busy zone is simply skipped until a later pass.
+    for (int x = coords.x - 16; x <= coords.x + 64; x += 16) {
+        for (int z = coords.y - 16; z <= coords.y + 64; z += 16) {
+            if (!hasChunkAt(x, z)) {
+                continue;
+            }
+            const Chunk *c = getChunkAt(x, z).get();
+            bool inside = x >= coords.x && x < coords.x + 64 && z >= coords.y && z < coords.y + 64;
+            if (c->genState == POPULATION_RUNNING || c->VBOState == VBO_RUNNING
+                    || (inside && (c->genState == TERRAIN_RUNNING || c->genState == LOAD_RUNNING))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int Terrain::removeZone(int64_t terrainGenZone) {
+    glm::ivec2 coords = toCoords(terrainGenZone);
+    int removed = 0;
+    std::vector<int64_t> removedKeys;
+    for (int x = coords.x; x < coords.x + 64; x += 16) {
+        for (int z = coords.y; z < coords.y + 64; z += 16) {
+            int64_t key = toKey(x, z);
+            auto it = m_chunks.find(key);
+            if (it == m_chunks.end()) {
+                continue;
+            }
+            Chunk *c = it->second.get();
+            // Pending work that has not been handed to a worker yet
+            m_TerrainQueue.erase(c);
+            m_PopulatonQueue.erase(c);
+            m_VBOGenerationQueue.erase(c);
+            m_VBODeletionQueue.erase(c);
+            m_chunksLastGen.erase(key);
+            for (BlockEdit &edit : m_pendingEdits) {
+                edit.chunks.erase(std::remove(edit.chunks.begin(), edit.chunks.end(), c), edit.chunks.end());
+            }
 
+            c->unlinkNeighbors();
+            removeFromRenderList(c);
+            if (c->VBOready) {
+                c->deleteVBOdata(m_vertexArena);
+            }
+            if (m_regionIO != nullptr) {
+                saveChunk(std::move(it->second));
+            }
+            m_chunks.erase(it);
+            removedKeys.push_back(key);
+            removed++;
+        }
+    }
+    forgetSorts(removedKeys);
+    m_generatedTerrain.erase(terrainGenZone);
+    m_zoneLastUsed.erase(terrainGenZone);
+    m_prefetchedZones.erase(terrainGenZone);
+    return removed;
+}
+
+void Terrain::evictZone(int64_t terrainGenZone) {
+    m_evictedChunkCount += removeZone(terrainGenZone);
+    m_evictedTerrain.insert(terrainGenZone);
+}
+
+void Terrain::dropAbandonedZones() {
+    std::vector<int64_t> dropped;
+    for (auto it = m_prefetchedZones.begin(); it != m_prefetchedZones.end(); ) {
+        int64_t zone = *it;
+        if (m_zoneLastUsed[zone] == m_generationTick) {
+            ++it;
+            continue;
+        }
+        // Chunks still generating were cancelled and come back as
+        // UNGENERATED, so the zone is looked at again next tick. Once
+        // any Chunk got further, the zone is kept and left to eviction.
+        bool pending = false;
+        bool started = false;
+        glm::ivec2 coords = toCoords(zone);
+        for (int x = coords.x; x < coords.x + 64; x += 16) {
+            for (int z = coords.y; z < coords.y + 64; z += 16) {
+                if (!hasChunkAt(x, z)) {
+                    continue;
+                }
+                GenState state = getChunkAt(x, z)->genState;
+                pending |= state == TERRAIN_RUNNING || state == LOAD_RUNNING;
+                started |= state != UNGENERATED && state != TERRAIN_RUNNING && state != LOAD_RUNNING;
+            }
+        }
+        if (started) {
+            it = m_prefetchedZones.erase(it);
+        } else {
+            if (!pending && canEvictZone(zone)) {
+                dropped.push_back(zone);
+            }
+            ++it;
+        }
+    }
+    for (int64_t zone : dropped) {
+        removeZone(zone);
+        m_droppedZoneCount++;
+    }
+}
+
+void Terrain::evictZones(int xCorner, int zCorner) {
+    m_memoryUsage = 0;
+    m_gpuMemoryUsage = 0;
+    m_meshMemoryUsage = 0;
+    for (const auto &kv : m_chunks) {
+        m_memoryUsage += sizeof(Chunk) + kv.second->blockMemoryUsage();
+        m_gpuMemoryUsage += kv.second->gpuMemoryUsage();
+        m_meshMemoryUsage += kv.second->meshMemoryUsage();
+    }
+    m_memoryUsage += m_gpuMemoryUsage + m_meshMemoryUsage + ChunkSection::retiredMemoryUsage();
+    if (m_memoryUsage <= m_memoryBudget) {
+        return;
+    }
+
+    // Zones outside of the kept ring, least recently used first
+    int keep = (m_renderDistance + 1 + EVICT_MARGIN) * 64;
+    std::vector<std::pair<uint64_t, int64_t>> candidates;
+    for (int64_t zone : m_generatedTerrain) {
+        glm::ivec2 coords = toCoords(zone);
+        if (coords.x >= xCorner - keep && coords.x <= xCorner + keep + 64
+                && coords.y >= zCorner - keep && coords.y <= zCorner + keep + 64) {
+            continue;
+        }
+        candidates.push_back(std::make_pair(m_zoneLastUsed[zone], zone));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &candidate : candidates) {
+        if (m_memoryUsage <= m_memoryBudget) {
+            break;
+        }
+        if (!canEvictZone(candidate.second)) {
+            continue;
+        }
+        glm::ivec2 coords = toCoords(candidate.second);
+        for (int x = coords.x; x < coords.x + 64; x += 16) {
+            for (int z = coords.y; z < coords.y + 64; z += 16) {
+                if (hasChunkAt(x, z)) {
+                    const uPtr<Chunk> &c = getChunkAt(x, z);
+                    size_t bytes = sizeof(Chunk) + c->blockMemoryUsage() + c->gpuMemoryUsage() + c->meshMemoryUsage();
+                    m_memoryUsage -= std::min(bytes, m_memoryUsage);
+                    m_gpuMemoryUsage -= std::min(c->gpuMemoryUsage(), m_gpuMemoryUsage);
+                    m_meshMemoryUsage -= std::min(c->meshMemoryUsage(), m_meshMemoryUsage);
+                }
+            }
+        }
+        evictZone(candidate.second);
+    }
+}
+
+void Terrain::setMeshingMode(MeshingMode mode) {
+    m_meshingMode = mode;
+    for (auto &kv : m_chunks) {
+        kv.second->markDirty();
+    }
+}
+
+MeshingMode Terrain::meshingMode() const {
+    return m_meshingMode;
+}
+
+void Terrain::setWorldDirectory(const QString &path) {
+    m_worldDirectory = path;
+}
+
+void Terrain::setRenderDistance(int zones) {
+    m_renderDistance = std::max(zones, 1);
+    m_renderListValid = false;
+}
+
+int Terrain::renderDistance() const {
+    return m_renderDistance;
+}
+
+void Terrain::setMemoryBudget(size_t bytes) {
+    m_memoryBudget = bytes;
+}
+
+size_t Terrain::memoryBudget() const {
+    return m_memoryBudget;
+}
+
+size_t Terrain::memoryUsage() const {
+    return m_memoryUsage;
+}
+
+void Terrain::setUploadBudget(double ms) {
+    m_uploadBudgetMs = ms;
+}
+
+double Terrain::uploadBudget() const {
+    return m_uploadBudgetMs;
+}
+
+void Terrain::setWorkerCount(int workers) {
+    int cores = std::max(QThread::idealThreadCount(), 1);
+    workers = workers <= 0 ? JobSystem::defaultWorkerCount() : std::min(workers, cores);
+    m_jobs.setWorkerCount(workers);
+    m_maxJobsInFlight = JOBS_PER_THREAD * workers;
+}
+
+int Terrain::workerCount() const {
+    return m_jobs.workerCount();
+}
+
+int Terrain::residentChunkCount() const {
+    return static_cast<int>(m_chunks.size());
+}
+
+int Terrain::evictedChunkCount() const {
+    return m_evictedChunkCount;
+}
+
+int Terrain::reloadedChunkCount() const {
+    return m_reloadedChunkCount;
+}
+
+int Terrain::cancelledJobCount() const {
+    return m_cancelledJobCount;
+}
+
+std::string Terrain::statsAsString() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Chunks resident: " << residentChunkCount()
+        << "  evicted: " << evictedChunkCount()
+        << "  reloaded: " << reloadedChunkCount() << "\n";
+    out << "Meshing: " << (m_meshingMode == MESH_GREEDY ? "greedy" : "per face") << " (G to switch)\n";
+    out << "Memory: " << m_memoryUsage / (1024.0 * 1024.0) << " / "
+        << m_memoryBudget / (1024.0 * 1024.0) << " MB, of which GPU vertices "
+        << m_gpuMemoryUsage / (1024.0 * 1024.0) << " MB, CPU copies of transparent meshes "
+        << m_meshMemoryUsage / (1024.0 * 1024.0) << " MB\n";
+    out << std::setprecision(2);
+    out << "Chunk load: " << m_loadLatency.averageMs() << " ms avg, "
+        << m_loadLatency.maxMs() << " max (" << m_loadLatency.count() << ")\n";
+    out << "Chunk generation: " << m_generationLatency.averageMs() << " ms avg, "
+        << m_generationLatency.maxMs() << " max (" << m_generationLatency.count() << "), zone noise "
+        << m_zoneNoise.hits() << " hits, " << m_zoneNoise.misses() << " misses\n";
+    out << "Chunk upload: " << m_uploadLatency.averageMs() << " ms avg, "
+        << m_uploadLatency.maxMs() << " max (" << m_uploadLatency.count() << ")\n";
+    out << "Upload queue: " << m_uploadQueue.size() << "  last tick: " << m_lastUploadCount
+        << " in " << m_lastUploadMs << " / " << m_uploadBudgetMs << " ms\n";
+    out << "Edit to photon: " << m_editLatency.stats().averageMs() << " ms avg, "
+        << m_editLatency.stats().maxMs() << " max (" << m_editLatency.stats().count() << "), "
+        << m_editRemeshCount << " chunks remeshed in frame, " << m_editDeferCount << " waits\n";
+    out << "  ms " << m_editLatency.toString() << "\n";
+    out << std::setprecision(0);
+    out << "Time to visible: " << m_timeToVisible.averageMs() << " ms avg, "
+        << m_timeToVisible.maxMs() << " max (" << m_timeToVisible.count() << ")\n";
+    out << std::setprecision(1);
+    out << "View ray over a missing chunk: "
+        << (m_viewRayFrames > 0 ? 100.0 * m_viewRayMisses / m_viewRayFrames : 0.0) << "% of "
+        << m_viewRayFrames << " frames, " << m_prefetchedZoneCount << " zones prefetched, "
+        << m_droppedZoneCount << " dropped unused\n";
+    out << std::setprecision(0);
+    out << "Culling" << (m_frustumFrozen ? " (frozen, V to thaw)" : " (V to freeze)") << ": chunks "
+        << m_drawnBeforeCulling.chunks << " -> " << m_drawnAfterCulling.chunks << ", draws "
+        << m_drawnBeforeCulling.draws << " -> " << m_drawnAfterCulling.draws << ", triangles "
+        << m_drawnBeforeCulling.triangles << " -> " << m_drawnAfterCulling.triangles
+        << ", sections " << m_drawnSections << " in " << m_multiDrawCalls << " multi-draw calls\n";
+    out << "Transparent sort: " << m_sorting.size() << " running, " << m_sortedMeshCount << " uploaded\n";
+    out << "Vertex arena: " << m_vertexArena.pageCount() << " pages, "
+        << m_vertexArena.usedBytes() / (1024.0 * 1024.0) << " / " << m_vertexArena.gpuBytes() / (1024.0 * 1024.0)
+        << " MB used, " << m_vertexArena.compactions() << " compactions\n";
+    out << "Jobs in flight: " << m_jobsInFlight << "  queued: "
+        << m_TerrainQueue.size() + m_PopulatonQueue.size() + m_VBOGenerationQueue.size()
+        << "  cancelled: " << m_cancelledJobCount << "  stolen: " << m_jobs.stolenCount()
+        << " on " << m_jobs.workerCount() << " workers\n";
+    // Every Chunk binds one shared index buffer instead of uploading its own
+    out << std::setprecision(1);
+    out << "Index bytes saved: "
+        << (m_uploadLatency.count() > 0 ? m_indexBytesSaved / 1024.0 / m_uploadLatency.count() : 0.0)
+        << " KB/chunk, shared buffer " << m_quadIndices.gpuBytes() / 1024.0 << " KB";
+    if (m_regionIO != nullptr) {
+        out << "\nRegion I/O queue: " << m_regionIO->pendingRequests();
+    }
+    return out.str();
 }
@@ -6,8 +6,20 @@
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
+#include <map>
 #include "shaderprogram.h"
 #include "cube.h"
+#include "regionio.h"
+#include "latencystats.h"
+#include "chunkpriority.h"
+#include "frustum.h"
+#include "sortworker.h"
+#include "blocktypeworker.h"
+#include "populationworker.h"
+#include "vboworker.h"
+#include "completionqueue.h"
+#include "jobsystem.h"
+#include <QElapsedTimer>
 
 
 //using namespace std;
@@ -17,9 +29,9 @@ int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
 // The container class for all of the Chunks in the game.
-// Ultimately, while Terrain will always store all Chunks,
-// not all Chunks will be drawn at any given time as the world
-// expands.
+// Not all Chunks will be drawn at any given time as the world
+// expands, and Chunks far from the Player are deleted again
+// once the Terrain grows past its memory budget.
 class Terrain {
 private:
     // Stores every Chunk according to the location of its lower-left corner
@@ -42,16 +54,134 @@ private:
     // one 64 x 64 area with its lower-left corner at (0, 0).
     // When milestone 1 has been implemented, the Player can move around the
     // world to add more "terrain generation zone" IDs to this set.
-    // While only the 3 x 3 collection of terrain generation zones
-    // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // While only the zones near the Player are rendered, zones
+    // outside of the generation ring may be evicted when the Terrain
+    // uses more memory than m_memoryBudget allows, least recently used first.
     std::unordered_set<int64_t> m_generatedTerrain;
 
-    std::unordered_set<Chunk *> m_generatedChunks;
-
-    std::unordered_set<Chunk *> m_populatedChunks;
-
-    std::unordered_set<Chunk *> m_VBOChunks;
+    // The GenerateNew() call in which each generated zone was last
+    // inside the generation ring
+    std::unordered_map<int64_t, uint64_t> m_zoneLastUsed;
+    // Zones that were evicted and not generated again since
+    std::unordered_set<int64_t> m_evictedTerrain;
+    uint64_t m_generationTick;
+
+    MeshingMode m_meshingMode;
+
+    size_t m_memoryBudget;
+    // CPU and GPU bytes held by all Chunks as of the last eviction pass
+    size_t m_memoryUsage;
+    // The GPU part of m_memoryUsage, and the CPU copies of transparent meshes
+    size_t m_gpuMemoryUsage;
+    size_t m_meshMemoryUsage;
+    int m_evictedChunkCount;
+    int m_reloadedChunkCount;
+
+    // Where region files are read from and written to.
+    // Empty when the world is not saved.
+    QString m_worldDirectory;
+    uPtr<RegionIO> m_regionIO;
+
+    std::unordered_set<Chunk *> m_loadedChunks;
+
+    // Chunks with no region file record, which have to be generated
+    std::unordered_set<Chunk *> m_missingChunks;
+
+    LatencyStats m_loadLatency;
+
+    LatencyStats m_generationLatency;
+
+    // Time spent in Chunk::SendVBOdata()
+    LatencyStats m_uploadLatency;
+    // Meshed Chunks waiting for SendVBOdata(). Each tick uploads the
+    // highest priority ones until m_uploadBudgetMs is used up and leaves
+    // the rest for later ticks, so that a zone finishing its meshes at
+    // once does not stall a frame.
+    std::vector<Chunk *> m_uploadQueue;
+    double m_uploadBudgetMs;
+    // Uploads and their time in the last tick
+    int m_lastUploadCount;
+    double m_lastUploadMs;
+    // Bytes of 32-bit quad indices the uploads so far would have sent
+    // before Chunks shared m_quadIndices
+    size_t m_indexBytesSaved;
+
+    // The index buffer every Chunk is drawn with
+    QuadIndexBuffer m_quadIndices;
+
+    // Holds the meshes of every Chunk
+    VertexArena m_vertexArena;
+    // The meshes and batches of the pass draw() is drawing, kept to reuse their storage
+    std::vector<VertexArena::Handle> m_drawMeshes;
+    std::vector<VertexArena::Batch> m_drawBatches;
+    // glMultiDrawElementsBaseVertex calls made by the last draw()
+    int m_multiDrawCalls;
+    // Section meshes the last draw() drew, after culling each section
+    int m_drawnSections;
+    // The transparent meshes of the visible sections and their squared
+    // distance to the camera, sorted farthest first
+    std::vector<std::pair<float, VertexArena::Handle>> m_transparentOrder;
+
+    // Transparent meshes whose quads SortWorkers put in back to front
+    // order, waiting to be uploaded
+    std::vector<SortedMesh> m_sortedMeshes;
+    QMutex m_SortCompletedLock;
+    // The block the camera was in when sorts were last handed out
+    glm::ivec3 m_sortCell;
+    // Set when meshes were uploaded or sorted since sorts were last handed
+    // out, so that the render list is looked through again
+    bool m_sortPending;
+    // Sorted meshes uploaded so far
+    int m_sortedMeshCount;
+
+    // Jobs that may be queued or running at once, a few per worker
+    int m_maxJobsInFlight;
+
+    // Chunks the workers have finished generating, populating and meshing,
+    // drained every tick. Each has room for every job that may be in
+    // flight with the most workers setWorkerCount() allows, so a worker
+    // never waits to hand its Chunk back.
+    CompletionQueue<Chunk *> m_generatedChunks;
+
+    CompletionQueue<Chunk *> m_populatedChunks;
+
+    CompletionQueue<Chunk *> m_VBOChunks;
+
+    // Chunks whose generation or meshing job was cancelled before it ran
+    CompletionQueue<Chunk *> m_cancelledChunks;
+
+    // The generation and meshing jobs in flight, by Chunk, to cancel
+    // once the player leaves the Chunk behind. An entry outlives its job
+    // until the Chunk is drained, so it keeps the job's ticket as well.
+    struct Submission {
+        Job *job;
+        uint64_t ticket;
+    };
+    std::unordered_map<Chunk *, Submission> m_cancellableJobs;
+    int m_cancelledJobCount;
+    // The SortWorkers running, by Chunk key and section of their mesh,
+    // to cancel once the Chunk is removed
+    std::map<std::pair<int64_t, int>, Submission> m_sorting;
+
+    // The slowly varying noise of recently generated zones, which the
+    // generation jobs of their Chunks share
+    ZoneNoiseCache m_zoneNoise;
+
+    // Reused job objects. A job is only handed back to its pool after its
+    // Chunk, so each pool holds twice the jobs that may be in flight.
+    JobPool<BlockTypeWorker> m_generationJobs;
+    JobPool<populationworker> m_populationJobs;
+    JobPool<VBOWorker> m_meshingJobs;
+    // SortWorkers go back as soon as they finish. When all are out,
+    // the sorts left wait for a later frame.
+    JobPool<SortWorker> m_sortJobs;
+
+    // Runs every worker job. Declared after everything the jobs use, so
+    // that its threads stop first.
+    JobSystem m_jobs;
+
+    // Chunks waiting for a BlockTypeWorker
+    std::unordered_set<Chunk *> m_TerrainQueue;
 
     std::unordered_set<Chunk *> m_PopulatonQueue;
 
@@ -59,15 +189,104 @@ private:
 
     std::unordered_set<Chunk *> m_VBODeletionQueue;
 
+    // Orders the work in m_TerrainQueue, m_PopulatonQueue and
+    // m_VBOGenerationQueue, and the zones GenerateNew() creates
+    ChunkPriority m_priority;
+
+    // Jobs handed to m_jobs whose Chunks have not been collected from
+    // m_generatedChunks, m_populatedChunks, m_VBOChunks or m_cancelledChunks yet.
+    // Only a few jobs per thread are queued at a time so that the rest
+    // can still be reordered.
+    int m_jobsInFlight;
+
+    // Chunks in view that cannot be drawn yet, and the m_clock time at
+    // which each came into view
+    std::unordered_map<int64_t, qint64> m_enteredView;
+    QElapsedTimer m_clock;
+    // Time from a Chunk coming into view until it can be drawn
+    LatencyStats m_timeToVisible;
+
+    // Zones generated ahead of the generation ring because the player
+    // was predicted to reach them, that the ring has not reached yet
+    // and none of whose Chunks got past generation
+    std::unordered_set<int64_t> m_prefetchedZones;
+    // Zones prefetched, and those dropped again because the prediction
+    // changed before any of their Chunks was generated
+    int m_prefetchedZoneCount;
+    int m_droppedZoneCount;
+    // GenerateNew() calls, and those in which a Chunk along the view ray
+    // within the draw distance could not be drawn yet
+    int m_viewRayFrames;
+    int m_viewRayMisses;
+
+    // A player edit, the m_clock time it was made in nanoseconds, and
+    // the Chunks it dirtied that have not been remeshed yet
+    struct BlockEdit {
+        qint64 time;
+        std::vector<Chunk *> chunks;
+    };
+    // Edits draw() remeshes the Chunks of before drawing
+    std::vector<BlockEdit> m_pendingEdits;
+    // Times of the edits the frame being drawn is the first to show
+    std::vector<qint64> m_drawnEdits;
+    // Time from a player edit until the first frame showing it is swapped
+    LatencyHistogram m_editLatency;
+    // Chunks remeshed by draw() for edits, and the times one had to wait
+    // for a frame because a worker was busy with it or its neighbors
+    int m_editRemeshCount;
+    int m_editDeferCount;
+
+    // The camera's view volume as of the last draw(), and the one Chunks
+    // are culled against, which stays put while the culling is frozen
+    Frustum m_viewFrustum;
+    Frustum m_cullFrustum;
+    bool m_frustumFrozen;
+
+    // draws counts the draws within the multi-draw calls
+    struct DrawCounts {
+        int chunks, draws, triangles;
+    };
+    // What the last draw() would have drawn without culling, and what it drew
+    DrawCounts m_drawnBeforeCulling;
+    DrawCounts m_drawnAfterCulling;
+
+    // Zones drawn on each side of the player's zone. Terrain is
+    // generated one zone further out, so that drawn Chunks have neighbors.
+    int m_renderDistance;
+
+    // A drawable Chunk with a copy of what culling needs to know about it,
+    // so that culling reads the list without touching the Chunks
+    struct RenderEntry {
+        Chunk *chunk;
+        glm::vec3 min, max;
+        int draws, triangles;
+        bool transparent;
+    };
+    // Every Chunk with VBOready inside the render distance of the zone
+    // at m_renderCorner, in no particular order, so that draw() does not
+    // have to look up each Chunk of the render distance every frame.
+    // Chunks are added and removed as their meshes are uploaded and
+    // deleted, and the list is rebuilt when the player enters another zone.
+    std::vector<RenderEntry> m_renderList;
+    // Position of each Chunk in m_renderList
+    std::unordered_map<Chunk *, size_t> m_renderListIndex;
+    glm::ivec2 m_renderCorner;
+    bool m_renderListValid;
+    // The Chunks of m_renderList that passed the last culling
+    std::vector<Chunk *> m_visibleChunks;
+
+    bool inRenderRange(const Chunk *c) const;
+    // Adds the Chunk if it is in range, or updates its entry after a new mesh
+    void addToRenderList(Chunk *c);
+    void removeFromRenderList(Chunk *c);
+    // Looks up every Chunk inside the render distance of the player again
+    void rebuildRenderList();
+
     glm::vec2 m_playerInertia;
 
     glm::vec2 IntertiaCenter(glm::vec3 playerPos);
 
-    QMutex m_TerrainGenLock;
-
-    QMutex m_PopulationGenLock;
-
-    QMutex m_VBOCompletedLock;
+    QMutex m_LoadCompletedLock;
 
     OpenGLContext* mp_context;
 
@@ -77,11 +296,61 @@ private:
 
     void updateVBOGenQueue();
 
+    // Hands the highest priority queued jobs whose Chunks are ready
+    // to m_jobs, keeping at most a few jobs per worker in flight.
+    // Chunks of zones outside the generation ring wait in m_TerrainQueue.
+    void dispatchJobs();
+
+    // True when the zone of the Chunk is in the generation ring
+    bool inGenerationRing(const Chunk *c) const;
+
+    // Cancels the generation of Chunks whose zone left the generation
+    // ring, and the meshing of Chunks that left the draw distance. Jobs
+    // that already started run to the end.
+    void cancelUnneededJobs();
+
+    // Records m_timeToVisible for Chunks in view that became drawable
+    void updateTimeToVisible();
+
+    // Zones outside the generation ring around the zone at (xCorner, zCorner)
+    // that the rings along the path velocity leads to will take in, soonest
+    // first and at most PREFETCH_ZONES of them
+    std::vector<int64_t> predictedZones(glm::vec3 playerPos, glm::vec3 velocity,
+                                        int xCorner, int zCorner, int genSize) const;
+
+    // Counts the frame in m_viewRayMisses if a Chunk the view ray passes
+    // over within the draw distance cannot be drawn yet
+    void updateViewRayMisses(glm::vec3 playerPos, glm::vec3 viewDir);
+
+    // Remesh and upload the dirty sections of the Chunks of m_pendingEdits
+    // right away, instead of leaving them to the meshing workers
+    void meshEdits();
+    // Returns false when the Chunk cannot be meshed on this thread yet
+    bool remeshNow(Chunk *c);
+
+    // Uploads the meshes SortWorkers finished, and sorts the transparent
+    // quads of the sections in the render list that were never sorted, or
+    // that are near and were sorted for another camera cell
+    void updateTransparentSort(glm::vec3 eye);
+    // Drops the sorts of the removed Chunks with these keys, running
+    // or finished, so that none is applied to a Chunk created under
+    // the same key later
+    void forgetSorts(const std::vector<int64_t> &chunkKeys);
+
     void spanwGenerationWorker(int64_t terrainGenZone);
 
-    void spanwnPopulationWorker(Chunk * chunk);
+    // The spawn functions return false, leaving the Chunk as it was, when
+    // every job of the kind is still out
+    bool spawnBlockTypeWorker(Chunk *chunk);
+
+    // Hands the Chunk to m_regionIO to be written to its region file if
+    // it is fully generated and changed since it was last saved, and
+    // deletes it otherwise. The Chunk must be unlinked from every queue.
+    void saveChunk(uPtr<Chunk> c);
+
+    bool spanwnPopulationWorker(Chunk * chunk);
 
-    void spawnVBOWorker(Chunk * chunk);
+    bool spawnVBOWorker(Chunk * chunk);
 
     void checkVBOState(Chunk *c );
 
@@ -89,6 +358,24 @@ private:
 
     bool checkNeighborStatusPopulation(Chunk * c);
 
+    // True if no worker is using, or may write into, any Chunk of the zone
+    bool canEvictZone(int64_t terrainGenZone) const;
+
+    // Removes the zone's Chunks from every queue, unlinks them from
+    // their neighbors and frees their block and GPU data. Returns the
+    // number of Chunks removed.
+    int removeZone(int64_t terrainGenZone);
+    // Removes the zone and remembers it was evicted
+    void evictZone(int64_t terrainGenZone);
+
+    // Removes the predicted zones that are no longer predicted and
+    // whose Chunks were never generated
+    void dropAbandonedZones();
+
+    // Evicts least recently used zones outside of the generation ring
+    // around (xCorner, zCorner) until memory use fits the budget
+    void evictZones(int xCorner, int zCorner);
+
     glm::vec3 playerCoords;
 
 public:
@@ -114,16 +401,77 @@ public:
     BlockType getBlockAt(glm::vec3 p) const;
     // Given a world-space coordinate (which may have negative
     // values) set the block at that point in space to the
-    // given type.
-
-    void setBlockAt(int x, int y, int z, BlockType t);
-
-    // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(ShaderProgram *shaderProgram);
-
-    // generate new chunks surrounding the player if they don't exist yet
-    void GenerateNew(glm::vec3 playerPos);
+    // given type. The Chunks whose meshes the change dirtied, its own
+    // and any neighbor whose face against the block it shows or hides,
+    // are appended to dirtied.
+    void setBlockAt(int x, int y, int z, BlockType t, std::vector<Chunk *> *dirtied = nullptr);
+    // setBlockAt() for blocks the player places or removes. The next
+    // draw() remeshes the Chunks the edit touched before drawing them.
+    void editBlockAt(int x, int y, int z, BlockType t);
+    // To be called once the frame of the last draw() has been swapped
+    // to the screen, to record how long the edits it shows took
+    void framePresented();
+
+    // Draws every Chunk within the render distance of the player that
+    // the camera at eye with the given view-projection matrix can see,
+    // using the provided ShaderProgram. Transparent meshes are drawn
+    // after the opaque ones, from the farthest Chunk to the nearest.
+    void draw(ShaderProgram *shaderProgram, const glm::mat4 &viewProj, glm::vec3 eye);
+
+    // The Chunks draw() draws for this view-projection matrix, without
+    // making any GL calls. Also updates the culling counters.
+    const std::vector<Chunk *> &cullChunks(const glm::mat4 &viewProj);
+
+    // While frozen, draw() keeps culling against the view volume the
+    // camera had when it was frozen, to see what culling leaves out
+    void setFrustumFrozen(bool frozen);
+    bool frustumFrozen() const;
+
+    // generate new chunks surrounding the player if they don't exist yet,
+    // starting with the ones nearest to the player and in the direction
+    // viewDir the camera looks. The zones the player is about to reach
+    // at its velocity are generated ahead of time.
+    void GenerateNew(glm::vec3 playerPos, glm::vec3 viewDir, glm::vec3 velocity = glm::vec3(0.f));
+
+    // Switches how Chunk meshes are built and remeshes every Chunk
+    void setMeshingMode(MeshingMode mode);
+    MeshingMode meshingMode() const;
+
+    // Directory the world is saved in. Only takes effect before the
+    // first call to GenerateNew(). Saving is off until a directory is given,
+    // and an empty path turns it off again.
+    void setWorldDirectory(const QString &path);
+
+    // Zones drawn on each side of the zone the player is in
+    void setRenderDistance(int zones);
+    int renderDistance() const;
+
+    // Maximum bytes of block and GPU data the Terrain tries to stay under.
+    // The zones in the generation ring are never evicted, so this is a soft limit.
+    void setMemoryBudget(size_t bytes);
+    size_t memoryBudget() const;
+    size_t memoryUsage() const;
+
+    // Milliseconds per tick spent uploading Chunk meshes to the GPU.
+    // At least one mesh is uploaded per tick however small the budget.
+    void setUploadBudget(double ms);
+    double uploadBudget() const;
+
+    // Worker threads that generate, populate and mesh Chunks, at most one
+    // per core. 0 or less leaves one core free for the GUI thread.
+    // Waits for every running job.
+    void setWorkerCount(int workers);
+    int workerCount() const;
+
+    int residentChunkCount() const;
+    // Chunks deleted by eviction so far
+    int evictedChunkCount() const;
+    // Chunks generated again after having been evicted
+    int reloadedChunkCount() const;
+    // Generation and meshing jobs cancelled so far
+    int cancelledJobCount() const;
+
+    // Multi-line summary of the counters above for the debug window
+    std::string statsAsString() const;
 
 };
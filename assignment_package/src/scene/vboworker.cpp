@@ -1,13 +1,23 @@
 #include "vboworker.h"
 
-VBOWorker::VBOWorker(Chunk * c, std::unordered_set<Chunk *> * m_VBOChunks, QMutex * m_VBOCompletedLock):
-    m_VBOChunks(m_VBOChunks), m_VBOCompletedLock(m_VBOCompletedLock), c(c)
+VBOWorker::VBOWorker(CompletionQueue<Chunk *> * m_VBOChunks, CompletionQueue<Chunk *> * m_cancelledChunks):
+    m_VBOChunks(m_VBOChunks), m_cancelledChunks(m_cancelledChunks), c(nullptr)
 {
 
 }
+
+void VBOWorker::setChunk(Chunk *chunk) {
+    c = chunk;
+}
+
 void VBOWorker::run() {
+    if (cancelled()) {
+        m_cancelledChunks->push(c);
+        return;
+    }
+    // The GUI thread and population workers edit the Chunk and its
+    // neighbors while they are read here
+    ChunkSection::ReadGuard guard;
     c->createVBOdata();
-    m_VBOCompletedLock->lock();
-    m_VBOChunks->insert(c);
-    m_VBOCompletedLock->unlock();
+    m_VBOChunks->push(c);
 }
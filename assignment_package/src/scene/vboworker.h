@@ -1,17 +1,21 @@
 #pragma once
-#include <QRunnable>
-#include <QMutex>
 #include "chunk.h"
+#include "completionqueue.h"
+#include "jobsystem.h"
 
-class VBOWorker : public QRunnable
+// Meshes the sections of a Chunk that VBOdata.sections names. When it is
+// cancelled before it starts, the Chunk goes to m_cancelledChunks unmeshed.
+class VBOWorker : public Job
 {
 private:
-    std::unordered_set<Chunk *> * m_VBOChunks;
-    QMutex * m_VBOCompletedLock;
+    CompletionQueue<Chunk *> * m_VBOChunks;
+    CompletionQueue<Chunk *> * m_cancelledChunks;
     Chunk * c;
 public:
-    VBOWorker(Chunk * c, std::unordered_set<Chunk *> * m_VBOChunks, QMutex * m_VBOCompletedLock);
+    VBOWorker(CompletionQueue<Chunk *> * m_VBOChunks, CompletionQueue<Chunk *> * m_cancelledChunks);
+
+    // The Chunk the next run() meshes
+    void setChunk(Chunk *chunk);
 
     void run() override;
 };
-
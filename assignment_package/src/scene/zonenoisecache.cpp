@@ -0,0 +1,52 @@
+#include "zonenoisecache.h"
+#include <QMutexLocker>
+
+ZoneNoiseCache::ZoneNoiseCache(int step, int capacity)
+    : m_lock(), m_zones(), m_useCount(0), m_step(step), m_capacity(capacity), m_hits(0), m_misses(0)
+{}
+
+sPtr<const Generation::ZoneNoise> ZoneNoiseCache::get(int zoneX, int zoneZ) {
+    int64_t key = (static_cast<int64_t>(zoneX) << 32) | static_cast<uint32_t>(zoneZ);
+    {
+        QMutexLocker locker(&m_lock);
+        auto it = m_zones.find(key);
+        if (it != m_zones.end()) {
+            it->second.lastUsed = ++m_useCount;
+            m_hits++;
+            return it->second.noise;
+        }
+        m_misses++;
+    }
+
+    // Sampled outside the lock. Two workers may sample the same zone at
+    // once; the second one simply replaces the first one's.
+    sPtr<Generation::ZoneNoise> noise = mkS<Generation::ZoneNoise>();
+    Generation::SampleZoneNoise(zoneX, zoneZ, m_step, *noise);
+
+    QMutexLocker locker(&m_lock);
+    m_zones[key] = {noise, ++m_useCount};
+    if (static_cast<int>(m_zones.size()) > m_capacity) {
+        auto oldest = m_zones.begin();
+        for (auto it = m_zones.begin(); it != m_zones.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) {
+                oldest = it;
+            }
+        }
+        m_zones.erase(oldest);
+    }
+    return noise;
+}
+
+int ZoneNoiseCache::step() const {
+    return m_step;
+}
+
+int ZoneNoiseCache::hits() const {
+    QMutexLocker locker(&m_lock);
+    return m_hits;
+}
+
+int ZoneNoiseCache::misses() const {
+    QMutexLocker locker(&m_lock);
+    return m_misses;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "generation.h"
+#include "smartpointerhelp.h"
+#include <QMutex>
+#include <unordered_map>
+#include <cstdint>
+
+// The ZoneNoise of the zones generated most recently, shared by the
+// workers generating their Chunks so that each zone is only sampled once.
+// Workers on any thread may look zones up.
+class ZoneNoiseCache {
+public:
+    // Blocks between samples. Heights interpolated from it stay within
+    // Generation::ComputeColumnHeightsReference() by the error the "zonenoise"
+    // benchmark checks.
+    static constexpr int DEFAULT_STEP = 4;
+    // Zones kept, about 7 KB each at DEFAULT_STEP
+    static constexpr int DEFAULT_CAPACITY = 256;
+
+private:
+    struct Entry {
+        sPtr<const Generation::ZoneNoise> noise;
+        uint64_t lastUsed;
+    };
+
+    mutable QMutex m_lock;
+    std::unordered_map<int64_t, Entry> m_zones;
+    uint64_t m_useCount;
+    int m_step;
+    int m_capacity;
+    int m_hits;
+    int m_misses;
+
+public:
+    explicit ZoneNoiseCache(int step = DEFAULT_STEP, int capacity = DEFAULT_CAPACITY);
+
+    // The noise of the zone whose corner is (zoneX, zoneZ), sampled on
+    // this thread if it is not cached. Drops the least recently used zone
+    // once there are more than the capacity.
+    sPtr<const Generation::ZoneNoise> get(int zoneX, int zoneZ);
+
+    int step() const;
+    int hits() const;
+    int misses() const;
+};
@@ -5,13 +5,15 @@
 #include <QDebug>
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
-      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1),
+      attrPos(-1), attrNor(-1), attrCol(-1), attrUV(-1), attrPacked(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifCamPos(-1),
       unifColor(-1), unifSampler2D(-1), unifTime(-1), unifDimensions(-1),
+      unifChunkOrigins(-1), unifPackedVertex(-1),
       context(context)
 {}
 
@@ -51,6 +53,15 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     // Tell prog that it manages these particular vertex and fragment shaders
     context->glAttachShader(prog, vertShader);
     context->glAttachShader(prog, fragShader);
+    // Give the inputs the same locations in every program, where the
+    // Drawables' VAOs point their buffers
+    context->glBindAttribLocation(prog, ATTR_POS, "vs_Pos");
+    context->glBindAttribLocation(prog, ATTR_NOR, "vs_Nor");
+    context->glBindAttribLocation(prog, ATTR_COL, "vs_Col");
+    context->glBindAttribLocation(prog, ATTR_COL, "vs_ColInstanced");
+    context->glBindAttribLocation(prog, ATTR_UV, "vs_UV");
+    context->glBindAttribLocation(prog, ATTR_POS_OFFSET, "vs_OffsetInstanced");
+    context->glBindAttribLocation(prog, ATTR_PACKED, "vs_Packed");
     context->glLinkProgram(prog);
 
     // Check for linking success
@@ -67,6 +78,7 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     attrNor = context->glGetAttribLocation(prog, "vs_Nor");
     attrCol = context->glGetAttribLocation(prog, "vs_Col");
     attrUV  = context->glGetAttribLocation(prog, "vs_UV");
+    attrPacked = context->glGetAttribLocation(prog, "vs_Packed");
     
     if(attrCol == -1) attrCol = context->glGetAttribLocation(prog, "vs_ColInstanced");
     attrPosOffset = context->glGetAttribLocation(prog, "vs_OffsetInstanced");
@@ -79,6 +91,8 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifSampler2D  = context->glGetUniformLocation(prog, "u_Texture");
     unifTime       = context->glGetUniformLocation(prog, "u_Time");
     unifDimensions = context->glGetUniformLocation(prog, "u_Dimensions");
+    unifChunkOrigins = context->glGetUniformLocation(prog, "u_ChunkOrigins");
+    unifPackedVertex = context->glGetUniformLocation(prog, "u_PackedVertex");
 }
 
 void ShaderProgram::useMe()
@@ -183,111 +197,58 @@ void ShaderProgram::draw(Drawable &d, int textureSlot = 0)
         context->glUniform1i(unifSampler2D, textureSlot);
     }
 
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-    // Remember, by calling bindPos(), we call
-    // glBindBuffer on the Drawable's VBO for vertex position,
-    // meaning that glVertexAttribPointer associates vs_Pos
-    // (referred to by attrPos) with that VBO
-    if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
-    }
-
-    if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
-    }
-
-    if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, NULL);
-    }
-
-    if (attrUV != -1 && d.bindUV()) {
-        context->glEnableVertexAttribArray(attrUV);
-        context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 0, NULL);
+    if (unifPackedVertex != -1)
+    {
+        context->glUniform1i(unifPackedVertex, 0);
     }
 
-    // Bind the index buffer and then draw shapes from it.
+    // The Drawable's VAO holds its vertex buffers, attribute formats and
+    // index buffer, so binding it is all the setup the draw needs.
     // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdxOpaque();
+    d.bindVAO();
     context->glDrawElements(d.drawMode(), d.elemCountOpaque(), GL_UNSIGNED_INT, 0);
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-
-    context->printGLErrorLog();
 }
 
-void ShaderProgram::drawInterleaved(Drawable &d, int textureSlot = 0, bool transparrent = false)
+void ShaderProgram::drawArena(const std::vector<VertexArena::Batch> &batches, int textureSlot, int originSlot)
 {
     useMe();
 
-    if(d.elemCountOpaque() < 0) {
-        throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCountOpaque()) + "!");
-    }
-
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-    // Remember, by calling bindPos(), we call
-    // glBindBuffer on the Drawable's VBO for vertex position,
-    // meaning that glVertexAttribPointer associates vs_Pos
-    // (referred to by attrPos) with that VBO
-
     if (unifSampler2D != -1)
     {
         context->glUniform1i(unifSampler2D, textureSlot);
     }
 
-
-    bool (Drawable::*bindVertPtr)(void) = (Drawable::bindVertOpaque);
-    bool (Drawable::*bindTdxPtr)(void) = (Drawable::bindIdxOpaque);
-    int (Drawable::*elemCountPtr)(void) = (Drawable::elemCountOpaque);
-    if(transparrent) {
-        bindVertPtr = (Drawable::bindVertTransparent);
-        bindTdxPtr = (Drawable::bindIdxTransparrent);
-        elemCountPtr = (Drawable::elemCountTransparrent);
+    if (unifChunkOrigins != -1)
+    {
+        context->glUniform1i(unifChunkOrigins, originSlot);
     }
 
-    if((d.*bindVertPtr)()) {
-        if (attrPos != -1) {
-            context->glEnableVertexAttribArray(attrPos);
-            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 3*sizeof(glm::vec4), (void*)0);
-
-        }
-
-        if (attrNor != -1) {
-            context->glEnableVertexAttribArray(attrNor);
-            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 3*sizeof(glm::vec4), (void*)(sizeof(glm::vec4)));
-        }
+    // Chunk vertices are packed into two unsigned ints that the vertex
+    // shader decodes itself
+    if (unifPackedVertex != -1)
+    {
+        context->glUniform1i(unifPackedVertex, 1);
+    }
 
-        if (attrUV != -1) {
-            context->glEnableVertexAttribArray(attrUV);
-            context->glVertexAttribPointer(attrUV, 4, GL_FLOAT, false, 3*sizeof(glm::vec4), (void*)(2*sizeof(glm::vec4)));
+    if (attrPacked == -1) {
+        return;
+    }
+    context->glActiveTexture(GL_TEXTURE0 + originSlot);
+
+    // Every mesh of a page is drawn from the page's first vertex, with its
+    // base vertex pointing at the mesh and the 16 bit indices of the shared
+    // index buffer, bound in the page's VAO, counting from there
+    for (const VertexArena::Batch &b : batches) {
+        if (b.counts.empty()) {
+            continue;
         }
+        context->glBindVertexArray(b.vertexArray);
+        context->glBindTexture(GL_TEXTURE_BUFFER, b.originTexture);
+        context->glMultiDrawElementsBaseVertex(GL_TRIANGLES, b.counts.data(), GL_UNSIGNED_SHORT, b.indices.data(),
+                                               static_cast<GLsizei>(b.counts.size()), b.baseVertices.data());
     }
 
-    // Bind the index buffer and then draw shapes from it.
-    // This invokes the shader program, which accesses the vertex buffers.
-
-    (d.*bindTdxPtr)();
-
-    context->glDrawElements(d.drawMode(), (d.*elemCountPtr)(), GL_UNSIGNED_INT, 0);
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrUV != -1) context->glDisableVertexAttribArray(attrUV);
-
-    context->printGLErrorLog();
+    context->glActiveTexture(GL_TEXTURE0 + textureSlot);
 }
 
 void ShaderProgram::drawInstanced(InstancedDrawable &d)
@@ -298,50 +259,9 @@ void ShaderProgram::drawInstanced(InstancedDrawable &d)
         throw std::out_of_range("Attempting to draw a drawable with m_count of " + std::to_string(d.elemCountOpaque()) + "!");
     }
 
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-    // Remember, by calling bindPos(), we call
-    // glBindBuffer on the Drawable's VBO for vertex position,
-    // meaning that glVertexAttribPointer associates vs_Pos
-    // (referred to by attrPos) with that VBO
-    if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, NULL);
-        context->glVertexAttribDivisor(attrPos, 0);
-    }
-
-    if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, NULL);
-        context->glVertexAttribDivisor(attrNor, 0);
-    }
-
-    if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 3, GL_FLOAT, false, 0, NULL);
-        context->glVertexAttribDivisor(attrCol, 1);
-    }
-
-    if (attrPosOffset != -1 && d.bindOffsetBuf()) {
-        context->glEnableVertexAttribArray(attrPosOffset);
-        context->glVertexAttribPointer(attrPosOffset, 3, GL_FLOAT, false, 0, NULL);
-        context->glVertexAttribDivisor(attrPosOffset, 1);
-    }
-
-    // Bind the index buffer and then draw shapes from it.
-    // This invokes the shader program, which accesses the vertex buffers.
-    d.bindIdxOpaque();
+    // The VAO of an InstancedDrawable reads colors and offsets per instance
+    d.bindVAO();
     context->glDrawElementsInstanced(d.drawMode(), d.elemCountOpaque(), GL_UNSIGNED_INT, 0, d.instanceCount());
-    context->printGLErrorLog();
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrPosOffset != -1) context->glDisableVertexAttribArray(attrPosOffset);
-
 }
 
 char* ShaderProgram::textFileRead(const char* fileName) {
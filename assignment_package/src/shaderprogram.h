@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "drawable.h"
+#include "vertexarena.h"
 
 class ShaderProgram
 {
@@ -19,6 +20,7 @@ public:
     int attrCol; // A handle for the "in" vec4 representing vertex color in the vertex shader
     int attrPosOffset; // A handle for a vec3 used only in the instanced rendering shader
     int attrUV;
+    int attrPacked; // A handle for the "in" uvec2 holding a packed terrain Vertex
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
@@ -28,6 +30,8 @@ public:
     int unifSampler2D;
     int unifTime;
     int unifDimensions;
+    int unifChunkOrigins; // A handle for the "uniform" isamplerBuffer of Chunk origins in a VertexArena page
+    int unifPackedVertex; // A handle for the "uniform" bool telling the vertex shader to read vs_Packed
 
 
 
@@ -59,7 +63,11 @@ public:
     // Utility function that prints any shader linking errors to the console
     void printLinkInfoLog(int prog);
 
-    void drawInterleaved(Drawable &d, int textureSlot, bool transparrent);
+    // Draw Chunk meshes held in a VertexArena, whose pages hold packed
+    // terrain Vertex data indexed by the shared quad index buffer.
+    // One glMultiDrawElementsBaseVertex call per Batch that has draws.
+    // The page's origin texture is bound to texture unit originSlot.
+    void drawArena(const std::vector<VertexArena::Batch> &batches, int textureSlot, int originSlot);
 
     void setTime(int t);
 
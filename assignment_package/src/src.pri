@@ -8,6 +8,7 @@ SOURCES += \
     $$PWD/mainwindow.cpp \
     $$PWD/mygl.cpp \
     $$PWD/postprocessshader.cpp \
+    $$PWD/quadindexbuffer.cpp \
     $$PWD/scene/creeper.cpp \
     $$PWD/scene/generation.cpp \
     $$PWD/scene/node.cpp \
@@ -27,7 +28,19 @@ SOURCES += \
     $$PWD/scene/camera.cpp \
     $$PWD/playerinfo.cpp \
     $$PWD/scene/chunk.cpp \
-    $$PWD/utils.cpp
+    $$PWD/scene/chunkpriority.cpp \
+    $$PWD/scene/chunksection.cpp \
+    $$PWD/scene/facemask.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/latencystats.cpp \
+    $$PWD/scene/regionfile.cpp \
+    $$PWD/scene/regionio.cpp \
+    $$PWD/scene/sortworker.cpp \
+    $$PWD/scene/jobsystem.cpp \
+    $$PWD/scene/zonenoisecache.cpp \
+    $$PWD/benchmark.cpp \
+    $$PWD/utils.cpp \
+    $$PWD/vertexarena.cpp
 
 HEADERS += \
     $$PWD/framebuffer.h \
@@ -35,6 +48,7 @@ HEADERS += \
     $$PWD/mainwindow.h \
     $$PWD/mygl.h \
     $$PWD/postprocessshader.h \
+    $$PWD/quadindexbuffer.h \
     $$PWD/scene/chunkhelper.h \
     $$PWD/scene/creeper.h \
     $$PWD/scene/generation.h \
@@ -57,4 +71,17 @@ HEADERS += \
     $$PWD/scene/camera.h \
     $$PWD/playerinfo.h \
     $$PWD/scene/chunk.h \
-    $$PWD/utils.h
+    $$PWD/scene/chunkpriority.h \
+    $$PWD/scene/chunksection.h \
+    $$PWD/scene/completionqueue.h \
+    $$PWD/scene/jobsystem.h \
+    $$PWD/scene/zonenoisecache.h \
+    $$PWD/scene/facemask.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/latencystats.h \
+    $$PWD/scene/regionfile.h \
+    $$PWD/scene/regionio.h \
+    $$PWD/scene/sortworker.h \
+    $$PWD/benchmark.h \
+    $$PWD/utils.h \
+    $$PWD/vertexarena.h
@@ -47,7 +47,7 @@ bool Utils::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain
             return false;
         }
 
-        if(cellType != EMPTY) {
+        if(isSolid(cellType)) {
             *out_blockHit = currCell;
             *out_dist = glm::min(maxLen, curr_t);
             return true;
@@ -57,11 +57,6 @@ bool Utils::gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain
     return false;
 }
 
-bool Utils::isSolidBlock(BlockType type) {
-    // TODO: add more as we increase the blocks that we are allowed to pass through
-    return type != LAVA && type != WATER && type != EMPTY;
-}
-
 bool Utils::gridMarchIgnoreNonSolidBlocks(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit) {
     float maxLen = glm::length(rayDirection); // Farthest we search
     glm::ivec3 currCell = glm::ivec3(glm::floor(rayOrigin));
@@ -105,7 +100,7 @@ bool Utils::gridMarchIgnoreNonSolidBlocks(glm::vec3 rayOrigin, glm::vec3 rayDire
             return false;
         }
 
-        if(isSolidBlock(cellType)) {
+        if(hasCollision(cellType)) {
             *out_blockHit = currCell;
             *out_dist = glm::min(maxLen, curr_t);
             return true;
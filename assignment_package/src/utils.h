@@ -9,10 +9,8 @@ namespace Utils {
     // Passes out the distance traveled along the ray and the location of the block hit using pointers
     bool gridMarch(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit);
 
-    // same as regular grid march except we ignore nonsolid blocks like water and lava
+    // same as regular grid march except we ignore blocks without collision like water and lava
     bool gridMarchIgnoreNonSolidBlocks(glm::vec3 rayOrigin, glm::vec3 rayDirection, const Terrain &terrain, float *out_dist, glm::ivec3 *out_blockHit);
-
-    bool isSolidBlock(BlockType type);
 }
 
 #endif // UTILS_H
@@ -0,0 +1,306 @@
+#include "vertexarena.h"
+#include "quadindexbuffer.h"
+#include "scene/chunk.h"
+#include "drawable.h"
+#include <algorithm>
+#include <stdexcept>
+
+VertexArena::VertexArena(OpenGLContext *context, QuadIndexBuffer &quads)
+    : mp_context(context), m_quads(quads), m_pages(), m_allocations(), m_unusedHandles(), m_compactions(0)
+{}
+
+int VertexArena::createPage() {
+    Page page;
+    mp_context->glGenBuffers(1, &page.vertexBuffer);
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(PAGE_GRANULES) * GRANULE * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+
+    // Meshes of up to MAX_QUADS quads are drawn in one piece, so the VAO
+    // gets an index buffer that holds them all
+    mp_context->glGenVertexArrays(1, &page.vertexArray);
+    mp_context->glBindVertexArray(page.vertexArray);
+    m_quads.bind(QuadIndexBuffer::MAX_QUADS);
+    configureVertexArray(page);
+
+    mp_context->glGenBuffers(1, &page.originBuffer);
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, page.originBuffer);
+    mp_context->glBufferData(GL_TEXTURE_BUFFER, PAGE_GRANULES * sizeof(glm::ivec2), nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glGenTextures(1, &page.originTexture);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, page.originTexture);
+    mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, page.originBuffer);
+
+    page.freeRanges[0] = PAGE_GRANULES;
+    page.freeGranules = PAGE_GRANULES;
+
+    // Reuse the slot of a released page
+    for (size_t i = 0; i < m_pages.size(); i++) {
+        if (m_pages[i].vertexBuffer == 0) {
+            m_pages[i] = page;
+            return static_cast<int>(i);
+        }
+    }
+    m_pages.push_back(page);
+    return static_cast<int>(m_pages.size()) - 1;
+}
+
+void VertexArena::configureVertexArray(const Page &page) {
+    mp_context->glBindVertexArray(page.vertexArray);
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, page.vertexBuffer);
+    // Each Vertex is two unsigned ints the vertex shader unpacks
+    mp_context->glEnableVertexAttribArray(ATTR_PACKED);
+    mp_context->glVertexAttribIPointer(ATTR_PACKED, 2, GL_UNSIGNED_INT, sizeof(Vertex), nullptr);
+}
+
+void VertexArena::destroyPage(Page &page) {
+    mp_context->glDeleteVertexArrays(1, &page.vertexArray);
+    mp_context->glDeleteBuffers(1, &page.vertexBuffer);
+    mp_context->glDeleteBuffers(1, &page.originBuffer);
+    mp_context->glDeleteTextures(1, &page.originTexture);
+    page.vertexBuffer = 0;
+    page.freeRanges.clear();
+    page.freeGranules = 0;
+}
+
+int VertexArena::takeRange(Page &page, int granules) {
+    for (auto it = page.freeRanges.begin(); it != page.freeRanges.end(); ++it) {
+        if (it->second >= granules) {
+            int first = it->first;
+            int rest = it->second - granules;
+            page.freeRanges.erase(it);
+            if (rest > 0) {
+                page.freeRanges[first + granules] = rest;
+            }
+            page.freeGranules -= granules;
+            return first;
+        }
+    }
+    return -1;
+}
+
+void VertexArena::freeRange(Page &page, int first, int granules) {
+    page.freeGranules += granules;
+    auto it = page.freeRanges.emplace(first, granules).first;
+    // Merge with the free ranges right after and right before
+    auto next = std::next(it);
+    if (next != page.freeRanges.end() && next->first == first + granules) {
+        it->second += next->second;
+        page.freeRanges.erase(next);
+    }
+    if (it != page.freeRanges.begin()) {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == first) {
+            prev->second += it->second;
+            page.freeRanges.erase(it);
+        }
+    }
+}
+
+void VertexArena::writeOrigins(const Allocation &a) {
+    std::vector<glm::ivec2> origins(a.granules, a.origin);
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, m_pages[a.page].originBuffer);
+    mp_context->glBufferSubData(GL_TEXTURE_BUFFER, a.first * sizeof(glm::ivec2), origins.size() * sizeof(glm::ivec2), origins.data());
+}
+
+void VertexArena::compact(int p) {
+    Page &page = m_pages[p];
+    std::vector<Handle> live;
+    for (size_t h = 0; h < m_allocations.size(); h++) {
+        if (m_allocations[h].first != -1 && m_allocations[h].page == p) {
+            live.push_back(static_cast<Handle>(h));
+        }
+    }
+    std::sort(live.begin(), live.end(), [this](Handle a, Handle b) {
+        return m_allocations[a].first < m_allocations[b].first;
+    });
+
+    // Meshes may overlap their old place, so they are copied into a new buffer
+    GLuint buffer;
+    mp_context->glGenBuffers(1, &buffer);
+    mp_context->glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(PAGE_GRANULES) * GRANULE * sizeof(Vertex), nullptr, GL_DYNAMIC_DRAW);
+    mp_context->glBindBuffer(GL_COPY_READ_BUFFER, page.vertexBuffer);
+
+    std::vector<glm::ivec2> origins;
+    int next = 0;
+    for (Handle h : live) {
+        Allocation &a = m_allocations[h];
+        mp_context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                        static_cast<GLintptr>(a.first) * GRANULE * sizeof(Vertex),
+                                        static_cast<GLintptr>(next) * GRANULE * sizeof(Vertex),
+                                        a.vertices * sizeof(Vertex));
+        a.first = next;
+        next += a.granules;
+        origins.insert(origins.end(), a.granules, a.origin);
+    }
+    mp_context->glDeleteBuffers(1, &page.vertexBuffer);
+    page.vertexBuffer = buffer;
+    configureVertexArray(page);
+
+    page.freeRanges.clear();
+    if (next < PAGE_GRANULES) {
+        page.freeRanges[next] = PAGE_GRANULES - next;
+    }
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, page.originBuffer);
+    mp_context->glBufferSubData(GL_TEXTURE_BUFFER, 0, origins.size() * sizeof(glm::ivec2), origins.data());
+    m_compactions++;
+}
+
+VertexArena::Handle VertexArena::allocate(const std::vector<Vertex> &vertices, glm::ivec2 origin) {
+    if (vertices.empty() || mp_context == nullptr) {
+        return NO_MESH;
+    }
+    int granules = static_cast<int>((vertices.size() + GRANULE - 1) / GRANULE);
+    if (granules > PAGE_GRANULES) {
+        throw std::length_error("Mesh of " + std::to_string(vertices.size()) + " vertices does not fit in a VertexArena page");
+    }
+
+    int page = -1, first = -1;
+    for (size_t i = 0; i < m_pages.size() && first == -1; i++) {
+        if (m_pages[i].vertexBuffer != 0) {
+            page = static_cast<int>(i);
+            first = takeRange(m_pages[i], granules);
+        }
+    }
+    // Rather than start a new page, compact one that has the room in pieces
+    for (size_t i = 0; i < m_pages.size() && first == -1; i++) {
+        if (m_pages[i].vertexBuffer != 0 && m_pages[i].freeGranules >= granules) {
+            page = static_cast<int>(i);
+            compact(page);
+            first = takeRange(m_pages[i], granules);
+        }
+    }
+    if (first == -1) {
+        page = createPage();
+        first = takeRange(m_pages[page], granules);
+    }
+
+    Handle mesh;
+    if (!m_unusedHandles.empty()) {
+        mesh = m_unusedHandles.back();
+        m_unusedHandles.pop_back();
+    } else {
+        mesh = static_cast<Handle>(m_allocations.size());
+        m_allocations.emplace_back();
+    }
+    Allocation &a = m_allocations[mesh];
+    a = {page, first, granules, static_cast<int>(vertices.size()), origin};
+
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_pages[page].vertexBuffer);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(first) * GRANULE * sizeof(Vertex),
+                                vertices.size() * sizeof(Vertex), vertices.data());
+    writeOrigins(a);
+    return mesh;
+}
+
+void VertexArena::release(Handle mesh) {
+    if (mesh == NO_MESH) {
+        return;
+    }
+    Allocation &a = m_allocations[mesh];
+    Page &page = m_pages[a.page];
+    freeRange(page, a.first, a.granules);
+    a.first = -1;
+    m_unusedHandles.push_back(mesh);
+
+    // Keep one page around for the next meshes, and give back the others once empty
+    if (page.freeGranules == PAGE_GRANULES && pageCount() > 1) {
+        destroyPage(page);
+    }
+}
+
+void VertexArena::update(Handle mesh, const std::vector<Vertex> &vertices) {
+    const Allocation &a = m_allocations[mesh];
+    if (static_cast<int>(vertices.size()) != a.vertices) {
+        throw std::invalid_argument("Updating a mesh of " + std::to_string(a.vertices) + " vertices with "
+                                    + std::to_string(vertices.size()));
+    }
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_pages[a.page].vertexBuffer);
+    mp_context->glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(a.first) * GRANULE * sizeof(Vertex),
+                                vertices.size() * sizeof(Vertex), vertices.data());
+}
+
+int VertexArena::vertexCount(Handle mesh) const {
+    return m_allocations[mesh].vertices;
+}
+
+void VertexArena::batches(const std::vector<Handle> &meshes, std::vector<Batch> &out, bool keepOrder) const {
+    size_t used = keepOrder ? 0 : m_pages.size();
+    out.resize(std::max(out.size(), used));
+    auto startBatch = [this, &out](size_t i, int page) {
+        if (i == out.size()) {
+            out.emplace_back();
+        }
+        Batch &b = out[i];
+        b.vertexArray = m_pages[page].vertexArray;
+        b.originTexture = m_pages[page].originTexture;
+        b.counts.clear();
+        b.indices.clear();
+        b.baseVertices.clear();
+    };
+    for (size_t i = 0; i < used; i++) {
+        startBatch(i, static_cast<int>(i));
+    }
+    int lastPage = -1;
+    for (Handle mesh : meshes) {
+        if (mesh == NO_MESH) {
+            continue;
+        }
+        const Allocation &a = m_allocations[mesh];
+        if (keepOrder && a.page != lastPage) {
+            startBatch(used++, a.page);
+            lastPage = a.page;
+        }
+        Batch &b = out[keepOrder ? used - 1 : a.page];
+        // The quad indices are 16 bit, so long meshes take several draws
+        int quads = a.vertices / 4;
+        for (int q = 0; q < quads; q += QuadIndexBuffer::MAX_QUADS) {
+            int count = std::min(quads - q, QuadIndexBuffer::MAX_QUADS);
+            b.counts.push_back(6 * count);
+            b.indices.push_back(nullptr);
+            b.baseVertices.push_back(a.first * GRANULE + 4 * q);
+        }
+    }
+    // Batches left from an earlier call keep their storage but draw nothing
+    for (size_t i = used; i < out.size(); i++) {
+        out[i].counts.clear();
+        out[i].indices.clear();
+        out[i].baseVertices.clear();
+    }
+}
+
+void VertexArena::destroy() {
+    for (Page &page : m_pages) {
+        if (page.vertexBuffer != 0) {
+            destroyPage(page);
+        }
+    }
+    m_pages.clear();
+    m_allocations.clear();
+    m_unusedHandles.clear();
+}
+
+int VertexArena::pageCount() const {
+    int count = 0;
+    for (const Page &page : m_pages) {
+        count += page.vertexBuffer != 0;
+    }
+    return count;
+}
+
+size_t VertexArena::gpuBytes() const {
+    return pageCount() * (static_cast<size_t>(PAGE_GRANULES) * GRANULE * sizeof(Vertex) + PAGE_GRANULES * sizeof(glm::ivec2));
+}
+
+size_t VertexArena::usedBytes() const {
+    size_t granules = 0;
+    for (const Page &page : m_pages) {
+        if (page.vertexBuffer != 0) {
+            granules += PAGE_GRANULES - page.freeGranules;
+        }
+    }
+    return granules * GRANULE * sizeof(Vertex);
+}
+
+int VertexArena::compactions() const {
+    return m_compactions;
+}
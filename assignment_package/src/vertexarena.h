@@ -0,0 +1,112 @@
+#pragma once
+#include "openglcontext.h"
+#include "quadindexbuffer.h"
+#include "glm_includes.h"
+#include <map>
+#include <vector>
+#include <cstddef>
+
+// Defined in chunkhelper.h, which includes chunk.h, which holds VertexArena handles
+struct Vertex;
+
+// The packed terrain Vertex data of every Chunk, suballocated from a few
+// large vertex buffers ("pages") instead of a pair of buffers per Chunk, so
+// that streaming Chunks in and out creates no GL buffers and a pass over
+// the Terrain is one glMultiDrawElementsBaseVertex call per page.
+//
+// Pages are handed out in granules of GRANULE vertices from a first-fit
+// free list. Meshes do not store where their Chunk is: each page has a
+// buffer texture holding the world (x, z) origin of the Chunk that owns
+// each granule, which the vertex shader looks up from gl_VertexID.
+// A page whose free space is too scattered to fit a new mesh is compacted
+// by copying its meshes to the front of a fresh buffer.
+// Each page has a VAO set up once with its vertex buffer and the shared
+// QuadIndexBuffer, so drawing a page only binds the VAO.
+class VertexArena {
+public:
+    static constexpr int GRANULE = 64;
+    // 4M vertices, 32 MB
+    static constexpr int PAGE_GRANULES = 1 << 16;
+
+    // Identifies one mesh in the arena
+    typedef int Handle;
+    static constexpr Handle NO_MESH = -1;
+
+    // The draws of one page, in the form glMultiDrawElementsBaseVertex takes
+    struct Batch {
+        GLuint vertexArray;
+        GLuint originTexture;
+        std::vector<GLsizei> counts;
+        std::vector<const void *> indices;
+        std::vector<GLint> baseVertices;
+    };
+
+private:
+    struct Allocation {
+        int page;
+        int first;      // First granule, -1 when the Handle is unused
+        int granules;
+        int vertices;
+        glm::ivec2 origin;
+    };
+
+    struct Page {
+        GLuint vertexBuffer;    // 0 when the page was released
+        GLuint vertexArray;
+        GLuint originBuffer;
+        GLuint originTexture;
+        // First granule and length of every free range
+        std::map<int, int> freeRanges;
+        int freeGranules;
+    };
+
+    OpenGLContext *mp_context;
+    QuadIndexBuffer &m_quads;
+    std::vector<Page> m_pages;
+    std::vector<Allocation> m_allocations;
+    std::vector<Handle> m_unusedHandles;
+    int m_compactions;
+
+    // Returns the index of a new empty page
+    int createPage();
+    void destroyPage(Page &page);
+    // Point the page's VAO at its vertex buffer
+    void configureVertexArray(const Page &page);
+    // Takes the first free range of the page long enough for the granules.
+    // Returns its first granule, or -1 if there is none.
+    int takeRange(Page &page, int granules);
+    void freeRange(Page &page, int first, int granules);
+    void writeOrigins(const Allocation &a);
+    // Moves every mesh of the page to its front, leaving one free range
+    void compact(int page);
+
+public:
+    // Every page draws with the indices of quads
+    VertexArena(OpenGLContext *context, QuadIndexBuffer &quads);
+
+    // Copy the vertices of the Chunk at origin into the arena.
+    // Returns NO_MESH when there are no vertices, or when there is no
+    // GL context, as for a Terrain run by a benchmark.
+    Handle allocate(const std::vector<Vertex> &vertices, glm::ivec2 origin);
+    void release(Handle mesh);
+    // Overwrite a mesh with as many vertices, such as its quads reordered
+    void update(Handle mesh, const std::vector<Vertex> &vertices);
+    // Vertices the mesh was allocated with
+    int vertexCount(Handle mesh) const;
+
+    // The draws of the meshes, one Batch per page. Batches of pages that
+    // hold none of the meshes, and any left over in out, have no counts.
+    // Reuses the Batches' storage.
+    // With keepOrder, the meshes are drawn in the order given instead,
+    // starting a new Batch wherever the next mesh is on another page.
+    void batches(const std::vector<Handle> &meshes, std::vector<Batch> &out, bool keepOrder = false) const;
+
+    // Deallocate every page
+    void destroy();
+
+    int pageCount() const;
+    // Bytes of all pages, and of the granules in use
+    size_t gpuBytes() const;
+    size_t usedBytes() const;
+    int compactions() const;
+};